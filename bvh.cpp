@@ -0,0 +1,439 @@
+#include <math.h>
+#include <algorithm>
+
+#include "bvh.h"
+
+// Test four boxes per plane with SSE where the target guarantees it
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BVH_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace game {
+
+// Result of testing a box against a frustum
+enum { OUTSIDE, INTERSECTING, INSIDE };
+
+// Surface area of a box, the cost metric for building the tree
+static float Area(const glm::vec3 &min, const glm::vec3 &max){
+
+    glm::vec3 d = max - min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+
+// Classify a box against all planes of a frustum
+static int Classify(const Frustum &frustum, const glm::vec3 &min, const glm::vec3 &max){
+
+    glm::vec3 center = (min + max) * 0.5f;
+    glm::vec3 extent = (max - min) * 0.5f;
+    int result = INSIDE;
+    for (int i = 0; i < 6; i++){
+        const glm::vec4 &p = frustum.plane[i];
+        // Signed distance of the center and projected radius of the box
+        float d = p.x * center.x + p.y * center.y + p.z * center.z + p.w;
+        float r = fabs(p.x) * extent.x + fabs(p.y) * extent.y + fabs(p.z) * extent.z;
+        if (d + r < 0.0f){
+            return OUTSIDE;
+        }
+        if (d - r < 0.0f){
+            result = INTERSECTING;
+        }
+    }
+    return result;
+}
+
+
+void Frustum::SetFromMatrix(const glm::mat4 &m){
+
+    // Rows of the matrix combine into the clip planes -w <= x, y, z <= w
+    for (int i = 0; i < 3; i++){
+        glm::vec4 row(m[0][i], m[1][i], m[2][i], m[3][i]);
+        glm::vec4 w(m[0][3], m[1][3], m[2][3], m[3][3]);
+        plane[2*i] = w + row;
+        plane[2*i + 1] = w - row;
+    }
+
+    // Normalize so plane distances are in world units
+    for (int i = 0; i < 6; i++){
+        float length = glm::length(glm::vec3(plane[i]));
+        plane[i] /= length;
+    }
+}
+
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy(float margin){
+
+    root_ = NO_PROXY;
+    leaf_count_ = 0;
+    margin_ = margin;
+}
+
+
+BoundingVolumeHierarchy::~BoundingVolumeHierarchy(){
+}
+
+
+int BoundingVolumeHierarchy::Insert(const glm::vec3 &min, const glm::vec3 &max, int data){
+
+    int leaf = Allocate();
+    glm::vec3 margin(margin_, margin_, margin_);
+    node_[leaf].min = min - margin;
+    node_[leaf].max = max + margin;
+    node_[leaf].tight_min = min;
+    node_[leaf].tight_max = max;
+    node_[leaf].data = data;
+    InsertLeaf(leaf);
+    leaf_count_++;
+
+    return leaf;
+}
+
+
+void BoundingVolumeHierarchy::Remove(int proxy){
+
+    RemoveLeaf(proxy);
+    Release(proxy);
+    leaf_count_--;
+}
+
+
+bool BoundingVolumeHierarchy::Move(int proxy, const glm::vec3 &min, const glm::vec3 &max){
+
+    Node &leaf = node_[proxy];
+    leaf.tight_min = min;
+    leaf.tight_max = max;
+
+    // Still inside the fat box: the tree is unchanged
+    if (glm::all(glm::lessThanEqual(leaf.min, min)) && glm::all(glm::lessThanEqual(max, leaf.max))){
+        return false;
+    }
+
+    RemoveLeaf(proxy);
+    glm::vec3 margin(margin_, margin_, margin_);
+    node_[proxy].min = min - margin;
+    node_[proxy].max = max + margin;
+    InsertLeaf(proxy);
+
+    return true;
+}
+
+
+int BoundingVolumeHierarchy::GetData(int proxy) const {
+
+    return node_[proxy].data;
+}
+
+
+void BoundingVolumeHierarchy::SetData(int proxy, int data){
+
+    node_[proxy].data = data;
+}
+
+
+int BoundingVolumeHierarchy::GetLeafCount(void) const {
+
+    return leaf_count_;
+}
+
+
+void BoundingVolumeHierarchy::Query(const Frustum &frustum, std::vector<int> &visible){
+
+    if (root_ == NO_PROXY){
+        return;
+    }
+
+    // Walk the tree, accepting whole subtrees inside the frustum and
+    // deferring leaves whose parent straddles a plane
+    candidate_.clear();
+    stack_.clear();
+    stack_.push_back(root_);
+    while (stack_.size() > 0){
+        int index = stack_.back();
+        stack_.pop_back();
+
+        if (IsLeaf(index)){
+            candidate_.push_back(index);
+            continue;
+        }
+
+        int result = Classify(frustum, node_[index].min, node_[index].max);
+        if (result == INSIDE){
+            CollectLeaves(index, visible);
+        } else if (result == INTERSECTING){
+            stack_.push_back(node_[index].child[0]);
+            stack_.push_back(node_[index].child[1]);
+        }
+    }
+
+    // Test the tight boxes of the candidate leaves
+    int count = (int) candidate_.size();
+    int i = 0;
+#ifdef BVH_SSE
+    // Four boxes at a time: one SSE lane per box, one pass per plane
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 sign = _mm_set1_ps(-0.0f);
+    for (; i + 4 <= count; i += 4){
+        const Node &a = node_[candidate_[i]];
+        const Node &b = node_[candidate_[i + 1]];
+        const Node &c = node_[candidate_[i + 2]];
+        const Node &d = node_[candidate_[i + 3]];
+        __m128 min_x = _mm_set_ps(d.tight_min.x, c.tight_min.x, b.tight_min.x, a.tight_min.x);
+        __m128 min_y = _mm_set_ps(d.tight_min.y, c.tight_min.y, b.tight_min.y, a.tight_min.y);
+        __m128 min_z = _mm_set_ps(d.tight_min.z, c.tight_min.z, b.tight_min.z, a.tight_min.z);
+        __m128 max_x = _mm_set_ps(d.tight_max.x, c.tight_max.x, b.tight_max.x, a.tight_max.x);
+        __m128 max_y = _mm_set_ps(d.tight_max.y, c.tight_max.y, b.tight_max.y, a.tight_max.y);
+        __m128 max_z = _mm_set_ps(d.tight_max.z, c.tight_max.z, b.tight_max.z, a.tight_max.z);
+        __m128 cx = _mm_mul_ps(_mm_add_ps(min_x, max_x), half);
+        __m128 cy = _mm_mul_ps(_mm_add_ps(min_y, max_y), half);
+        __m128 cz = _mm_mul_ps(_mm_add_ps(min_z, max_z), half);
+        __m128 ex = _mm_mul_ps(_mm_sub_ps(max_x, min_x), half);
+        __m128 ey = _mm_mul_ps(_mm_sub_ps(max_y, min_y), half);
+        __m128 ez = _mm_mul_ps(_mm_sub_ps(max_z, min_z), half);
+
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++){
+            const glm::vec4 &plane = frustum.plane[p];
+            __m128 nx = _mm_set1_ps(plane.x);
+            __m128 ny = _mm_set1_ps(plane.y);
+            __m128 nz = _mm_set1_ps(plane.z);
+            // Distance of the centers plus projected radius of the boxes
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+                                     _mm_add_ps(_mm_mul_ps(nz, cz), _mm_set1_ps(plane.w)));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign, nx), ex),
+                                                  _mm_mul_ps(_mm_andnot_ps(sign, ny), ey)),
+                                       _mm_mul_ps(_mm_andnot_ps(sign, nz), ez));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, radius), _mm_setzero_ps()));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        for (int k = 0; k < 4; k++){
+            if (!(mask & (1 << k))){
+                visible.push_back(node_[candidate_[i + k]].data);
+            }
+        }
+    }
+#endif
+    for (; i < count; i++){
+        const Node &leaf = node_[candidate_[i]];
+        if (Classify(frustum, leaf.tight_min, leaf.tight_max) != OUTSIDE){
+            visible.push_back(leaf.data);
+        }
+    }
+}
+
+
+int BoundingVolumeHierarchy::Allocate(void){
+
+    int index;
+    if (free_.size() > 0){
+        index = free_.back();
+        free_.pop_back();
+    } else {
+        index = (int) node_.size();
+        node_.push_back(Node());
+    }
+
+    Node &node = node_[index];
+    node.parent = NO_PROXY;
+    node.child[0] = NO_PROXY;
+    node.child[1] = NO_PROXY;
+    node.height = 0;
+    node.data = 0;
+
+    return index;
+}
+
+
+void BoundingVolumeHierarchy::Release(int index){
+
+    free_.push_back(index);
+}
+
+
+bool BoundingVolumeHierarchy::IsLeaf(int index) const {
+
+    return node_[index].child[0] == NO_PROXY;
+}
+
+
+void BoundingVolumeHierarchy::InsertLeaf(int leaf){
+
+    if (root_ == NO_PROXY){
+        root_ = leaf;
+        node_[leaf].parent = NO_PROXY;
+        return;
+    }
+
+    glm::vec3 leaf_min = node_[leaf].min;
+    glm::vec3 leaf_max = node_[leaf].max;
+
+    // Descend towards the cheapest sibling: pairing with a node costs the
+    // area of the union, and every ancestor grows by the same amount
+    int index = root_;
+    while (!IsLeaf(index)){
+        const Node &node = node_[index];
+        float area = Area(node.min, node.max);
+        float combined = Area(glm::min(node.min, leaf_min), glm::max(node.max, leaf_max));
+
+        // Cost of making a new parent for this node and the leaf
+        float cost = 2.0f * combined;
+        // Minimum cost pushed down to the children
+        float inheritance = 2.0f * (combined - area);
+
+        float child_cost[2];
+        for (int k = 0; k < 2; k++){
+            const Node &child = node_[node.child[k]];
+            float grown = Area(glm::min(child.min, leaf_min), glm::max(child.max, leaf_max));
+            if (IsLeaf(node.child[k])){
+                child_cost[k] = grown + inheritance;
+            } else {
+                child_cost[k] = grown - Area(child.min, child.max) + inheritance;
+            }
+        }
+
+        if (cost < child_cost[0] && cost < child_cost[1]){
+            break;
+        }
+        index = (child_cost[0] < child_cost[1]) ? node.child[0] : node.child[1];
+    }
+
+    // Replace the sibling with a new parent of both
+    int sibling = index;
+    int old_parent = node_[sibling].parent;
+    int new_parent = Allocate();
+    node_[new_parent].parent = old_parent;
+    node_[new_parent].child[0] = sibling;
+    node_[new_parent].child[1] = leaf;
+    node_[sibling].parent = new_parent;
+    node_[leaf].parent = new_parent;
+
+    if (old_parent == NO_PROXY){
+        root_ = new_parent;
+    } else if (node_[old_parent].child[0] == sibling){
+        node_[old_parent].child[0] = new_parent;
+    } else {
+        node_[old_parent].child[1] = new_parent;
+    }
+
+    Refit(new_parent);
+}
+
+
+void BoundingVolumeHierarchy::RemoveLeaf(int leaf){
+
+    if (leaf == root_){
+        root_ = NO_PROXY;
+        return;
+    }
+
+    // The sibling takes the place of the parent
+    int parent = node_[leaf].parent;
+    int grand_parent = node_[parent].parent;
+    int sibling = (node_[parent].child[0] == leaf) ? node_[parent].child[1] : node_[parent].child[0];
+
+    if (grand_parent == NO_PROXY){
+        root_ = sibling;
+        node_[sibling].parent = NO_PROXY;
+    } else {
+        if (node_[grand_parent].child[0] == parent){
+            node_[grand_parent].child[0] = sibling;
+        } else {
+            node_[grand_parent].child[1] = sibling;
+        }
+        node_[sibling].parent = grand_parent;
+        Refit(grand_parent);
+    }
+
+    Release(parent);
+    node_[leaf].parent = NO_PROXY;
+}
+
+
+void BoundingVolumeHierarchy::Refit(int index){
+
+    while (index != NO_PROXY){
+        index = Balance(index);
+        Node &node = node_[index];
+        const Node &a = node_[node.child[0]];
+        const Node &b = node_[node.child[1]];
+        node.min = glm::min(a.min, b.min);
+        node.max = glm::max(a.max, b.max);
+        node.height = 1 + ((a.height > b.height) ? a.height : b.height);
+        index = node.parent;
+    }
+}
+
+
+int BoundingVolumeHierarchy::Balance(int index){
+
+    Node &a = node_[index];
+    if (IsLeaf(index)){
+        return index;
+    }
+
+    // The taller child b moves up; a keeps the shorter child and takes
+    // the shorter child of b, and b keeps its taller child
+    int taller = (node_[a.child[1]].height > node_[a.child[0]].height) ? 1 : 0;
+    int ib = a.child[taller];
+    int ic = a.child[1 - taller];
+    Node &b = node_[ib];
+    Node &c = node_[ic];
+    // The height of a is refreshed after balancing, so it may be stale
+    // here; the children are already up to date
+    a.height = 1 + b.height;
+    if (b.height - c.height < 2){
+        return index;
+    }
+    int id = b.child[0];
+    int ie = b.child[1];
+    if (node_[id].height < node_[ie].height){
+        std::swap(id, ie);
+    }
+
+    // b takes the place of a
+    b.parent = a.parent;
+    if (b.parent == NO_PROXY){
+        root_ = ib;
+    } else if (node_[b.parent].child[0] == index){
+        node_[b.parent].child[0] = ib;
+    } else {
+        node_[b.parent].child[1] = ib;
+    }
+    b.child[0] = index;
+    b.child[1] = id;
+    a.parent = ib;
+    a.child[taller] = ie;
+    node_[ie].parent = index;
+
+    const Node &d = node_[id];
+    const Node &e = node_[ie];
+    a.min = glm::min(c.min, e.min);
+    a.max = glm::max(c.max, e.max);
+    a.height = 1 + ((c.height > e.height) ? c.height : e.height);
+    b.min = glm::min(a.min, d.min);
+    b.max = glm::max(a.max, d.max);
+    b.height = 1 + ((a.height > d.height) ? a.height : d.height);
+
+    return ib;
+}
+
+
+void BoundingVolumeHierarchy::CollectLeaves(int index, std::vector<int> &visible){
+
+    // Uses the tail of the traversal stack, which is restored on return
+    size_t base = stack_.size();
+    stack_.push_back(index);
+    while (stack_.size() > base){
+        int current = stack_.back();
+        stack_.pop_back();
+        if (IsLeaf(current)){
+            visible.push_back(node_[current].data);
+        } else {
+            stack_.push_back(node_[current].child[0]);
+            stack_.push_back(node_[current].child[1]);
+        }
+    }
+}
+
+} // namespace game
@@ -0,0 +1,92 @@
+#ifndef BVH_H_
+#define BVH_H_
+
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace game {
+
+    // Proxy value that refers to no leaf
+    const int NO_PROXY = -1;
+
+    // Volume seen by a camera, bounded by six planes whose normals point
+    // inwards: a point p is inside a plane if dot(plane.xyz, p) + plane.w >= 0
+    struct Frustum {
+        glm::vec4 plane[6]; // Left, right, bottom, top, near, far
+
+        // Extract the planes from a projection * view matrix
+        void SetFromMatrix(const glm::mat4 &view_projection);
+    };
+
+    // Dynamic bounding volume hierarchy over axis-aligned boxes
+    //
+    // Leaves store a box enlarged by a margin, so objects that move a
+    // little only update their tight box and leave the tree untouched.
+    // Objects that never move cost nothing after insertion. Nodes whose
+    // subtrees differ in height by more than one are rotated on every
+    // refit, so the tree stays balanced however often objects move
+    class BoundingVolumeHierarchy {
+
+        public:
+            BoundingVolumeHierarchy(float margin = 2.0f);
+            ~BoundingVolumeHierarchy();
+
+            // Add a box carrying user data and return its proxy
+            int Insert(const glm::vec3 &min, const glm::vec3 &max, int data);
+            // Remove the box of a proxy
+            void Remove(int proxy);
+            // Update the box of a proxy; returns true if the tree changed
+            bool Move(int proxy, const glm::vec3 &min, const glm::vec3 &max);
+            // User data given at insertion
+            int GetData(int proxy) const;
+            void SetData(int proxy, int data);
+
+            // Append the user data of every box that intersects the frustum
+            void Query(const Frustum &frustum, std::vector<int> &visible);
+
+            // Number of boxes in the tree
+            int GetLeafCount(void) const;
+
+        private:
+            struct Node {
+                glm::vec3 min; // Fat box of a leaf, union of children otherwise
+                glm::vec3 max;
+                glm::vec3 tight_min; // Exact box of a leaf
+                glm::vec3 tight_max;
+                int parent;
+                int child[2]; // Both NO_PROXY for a leaf
+                int height; // 0 for a leaf
+                int data;
+            };
+
+            std::vector<Node> node_; // Leaves and internal nodes
+            std::vector<int> free_; // Released slots
+            int root_;
+            int leaf_count_;
+            float margin_; // Enlargement of leaf boxes
+            std::vector<int> stack_; // Scratch stack for traversal
+            std::vector<int> candidate_; // Leaves to test against the frustum
+
+            int Allocate(void);
+            void Release(int index);
+            bool IsLeaf(int index) const;
+            // Link a leaf into the tree next to the sibling that grows the
+            // total surface area the least
+            void InsertLeaf(int leaf);
+            // Unlink a leaf and collapse its parent
+            void RemoveLeaf(int leaf);
+            // Rebalance, and recompute boxes and heights, from a node up to
+            // the root
+            void Refit(int index);
+            // Rotate the taller grandchild of a node up in its place when
+            // the heights of its children differ by more than one; returns
+            // the node now at that place
+            int Balance(int index);
+            // Append every leaf below a node without testing it
+            void CollectLeaves(int index, std::vector<int> &visible);
+
+    }; // class BoundingVolumeHierarchy
+
+} // namespace game
+
+#endif // BVH_H_
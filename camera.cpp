@@ -166,6 +166,19 @@ void Camera::SetupShader(GLuint program){
 }
 
 
+glm::mat4 Camera::GetViewMatrix(void){
+
+    SetupViewMatrix();
+    return view_matrix_;
+}
+
+
+glm::mat4 Camera::GetProjectionMatrix(void) const {
+
+    return projection_matrix_;
+}
+
+
 void Camera::SetupViewMatrix(void){
 
     //view_matrix_ = glm::lookAt(position, look_at, up);
@@ -58,6 +58,9 @@ namespace game {
             void SetProjection(GLfloat fov, GLfloat near, GLfloat far, GLfloat w, GLfloat h);
             // Set all camera-related variables in shader program
             void SetupShader(GLuint program);
+            // Get current view and projection matrices
+            glm::mat4 GetViewMatrix(void);
+            glm::mat4 GetProjectionMatrix(void) const;
 
         private:
             glm::vec3 position_; // Position of camera
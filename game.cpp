@@ -26,8 +26,48 @@ glm::vec3 camera_position_g(0.5, 0.5, 10.0);
 glm::vec3 camera_look_at_g(0.0, 0.0, 0.0);
 glm::vec3 camera_up_g(0.0, 1.0, 0.0);
 
+// Rendering settings
+const bool frustum_culling_g = true; // Skip nodes outside the view
+const bool show_cull_stats_g = true; // Report culling statistics in the window title
+const bool print_startup_stats_g = false; // Print what startup built to the console
+// Static batching merges non-moving nodes into chunks of this size on the
+// xz plane; bigger chunks mean fewer draws but coarser culling. Merged
+// geometry is capped at the budget, set it to 0 to disable batching.
+// A chunk selects one level of detail for all its members, so cells are
+// kept near the distance at which an asteroid drops its first level
+const float static_batch_cell_size_g = 100.0;
+const size_t static_batch_budget_g = 128 * 1024 * 1024;
+// Draw with glMultiDrawElementsIndirect when OpenGL 4.3 is available
+const bool multi_draw_g = true;
+// Nodes covering less than this fraction of the screen height switch to
+// coarser levels of detail, one level per halving; 0 disables LOD
+const float lod_threshold_g = 0.2;
+// Distant asteroids drawn with instancing; beyond the impostor distance
+// they become quads textured from views of the asteroid baked at startup
+const int distant_asteroid_count_g = 20000;
+const float impostor_distance_g = 800.0;
+// The terrain, placed in the world; the player, orbs and asteroids use it
+// to find the height under them
+const glm::vec3 floor_position_g(-400.0, 0.0, 400.0);
+const glm::vec3 floor_scale_g(10.0, 10.0, 10.0);
+// Texture, mesh and particle data sent to the GPU per frame during the
+// game; larger assets reach their buffers over several frames
+const size_t upload_budget_g = 4 * 1024 * 1024;
+// Seconds of loading done per frame while the title screen shows; the
+// rest of the frame draws it and its progress bar
+const double loading_slice_g = 0.008;
+// GPU memory for buffers and textures; past it, textures no node uses any
+// more are evicted and loaded again when asked for. 0 for no budget
+const size_t gpu_memory_budget_g = 512 * 1024 * 1024;
+
 // Materials 
 const std::string material_directory_g = MATERIAL_DIRECTORY;
+// Generated geometry and decoded textures kept between launches; empty to
+// always regenerate
+const std::string cache_directory_g = material_directory_g + "/cache";
+// Assets packed into one file by pack_builder from resources.txt; loose
+// files are read when it is missing
+const std::string resource_pack_g = material_directory_g + "/resources.pack";
 
 
 Game::Game(void){
@@ -42,6 +82,12 @@ void Game::Init(void){
     InitWindow();
     InitView();
     InitEventHandlers();
+    resman_.SetResourcePack(resource_pack_g, material_directory_g);
+    // Before the first texture, which the cache also holds decoded
+    resman_.SetCacheDirectory(cache_directory_g);
+    resman_.GetUploadQueue().SetBudget(upload_budget_g);
+    resman_.SetMemoryBudget(gpu_memory_budget_g);
+    resman_.SetPrintStats(print_startup_stats_g);
     Init2D();
     // Set variables
     animating_ = true;
@@ -155,25 +201,8 @@ void Game::Init2D(void) {
         }
     )";
 
-    // Compile the vertex shader for 2D rendering
-    GLuint vertexShaderID2D = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShaderID2D, 1, &vertexShaderCode2D, nullptr);
-    glCompileShader(vertexShaderID2D);
-
-    // Compile the fragment shader for 2D rendering
-    GLuint fragmentShaderID2D = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShaderID2D, 1, &fragmentShaderCode2D, nullptr);
-    glCompileShader(fragmentShaderID2D);
-
-    // Link the 2D shader program
-    programID2D = glCreateProgram();
-    glAttachShader(programID2D, vertexShaderID2D);
-    glAttachShader(programID2D, fragmentShaderID2D);
-    glLinkProgram(programID2D);
-
-    // Clean up shader resources
-    glDeleteShader(vertexShaderID2D);
-    glDeleteShader(fragmentShaderID2D);
+    // Link the 2D shader program, from the program cache when it can
+    programID2D = resman_.CreateMaterial("Overlay2DMaterial", vertexShaderCode2D, fragmentShaderCode2D)->GetResource();
 
     Load2DTexture(std::string(MATERIAL_DIRECTORY) + std::string("\\Rover.png"), &textureIDs[0]);
     Load2DTexture(std::string(MATERIAL_DIRECTORY) + std::string("\\marsScreen.jpg"), &textureIDs[1]);
@@ -190,49 +219,26 @@ void Game::Init2D(void) {
     Load2DTexture(std::string(MATERIAL_DIRECTORY) + std::string("\\Numbers\\slash.png"), &slash);
     Load2DTexture(std::string(MATERIAL_DIRECTORY) + std::string("\\tankOutside.png"), &textureIDs[2]);
 
-    // Compile the vertex shader for 2D rendering
-    GLuint vertexShaderID2DTank = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShaderID2DTank, 1, &vertexShaderCode2DTank, nullptr);
-    glCompileShader(vertexShaderID2DTank);
-
-    // Compile the fragment shader for 2D rendering
-    GLuint fragmentShaderID2DTank = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShaderID2DTank, 1, &fragmentShaderCode2DTank, nullptr);
-    glCompileShader(fragmentShaderID2DTank);
-
-    // Link the 2D shader program
-    programID2DTank = glCreateProgram();
-    glAttachShader(programID2DTank, vertexShaderID2DTank);
-    glAttachShader(programID2DTank, fragmentShaderID2DTank);
-    glLinkProgram(programID2DTank);
-
-    // Clean up shader resources
-    glDeleteShader(vertexShaderID2DTank);
-    glDeleteShader(fragmentShaderID2DTank);
+    // Link the 2D shader program of the tank gauge
+    programID2DTank = resman_.CreateMaterial("Overlay2DTankMaterial", vertexShaderCode2DTank, fragmentShaderCode2DTank)->GetResource();
 
     Load2DTexture(std::string(MATERIAL_DIRECTORY) + std::string("\\tankInside.png"), &textureIDs[3]);
+
+    // One texel stretched over the progress bar of the title screen
+    const unsigned char progress_color[4] = { 255, 160, 60, 255 };
+    glGenTextures(1, &progress_texture_);
+    glBindTexture(GL_TEXTURE_2D, progress_texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, progress_color);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 }
 
 void Game::Load2DTexture(std::string filename, GLuint *textureID){
-    int width, height;
 
-    unsigned char* image = SOIL_load_image(filename.c_str(), &width, &height, 0, SOIL_LOAD_RGBA);
-    if (!image) {
-        std::cerr << "Failed to load PNG image\n";
-        exit(EXIT_FAILURE);
-    }
-
-    // Generate OpenGL texture
-    glGenTextures(1, textureID);
-    glBindTexture(GL_TEXTURE_2D, *textureID);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-    SOIL_free_image_data(image);
-
-    // Set texture parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);    
+    // Decoded by the workers of the resource manager along with the other
+    // textures; the handle is filled in once it is uploaded
+    *textureID = 0;
+    overlay_texture_.push_back(std::make_pair(resman_.LoadTextureAsync(filename, filename.c_str()), textureID));
 }
 
 
@@ -532,6 +538,51 @@ void Game::RenderGameMenu(int menu_index = 1){
 }
 
 
+void Game::RenderProgressBar(float progress) {
+    // Set up 2D rendering, using orthographic projection
+    glDisable(GL_DEPTH_TEST);
+
+    // Use the 2D shader program
+    glUseProgram(programID2D);
+
+    glm::mat4 projectionMatrix = glm::ortho(0.0f, window_width_g * 1.0f, 0.0f, window_height_g * 1.0f, -1.0f, 1.0f);
+    GLuint projectionMatrixUniform = glGetUniformLocation(programID2D, "projection_mat");
+    glUniformMatrix4fv(projectionMatrixUniform, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+
+    // Bar along the bottom of the screen, as long as the part loaded
+    float left = 0.1f * window_width_g;
+    float right = left + 0.8f * window_width_g * progress;
+    float rectangleVertices[] = {
+        left, 0.07f * window_height_g, 0.0f, 0.0f, // Top-left corner
+        right, 0.07f * window_height_g, 1.0f, 0.0f,  // Top-right corner
+        right, 0.05f * window_height_g, 1.0f, 1.0f,  // Bottom-right corner
+        left, 0.05f * window_height_g, 0.0f, 1.0f   // Bottom-left corner
+    };
+
+    GLuint rectangleVBO;
+    glGenBuffers(1, &rectangleVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, rectangleVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(rectangleVertices), rectangleVertices, GL_STATIC_DRAW);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), nullptr);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, progress_texture_);
+    glUniform1i(glGetUniformLocation(programID2D, "textureSampler"), 0);
+
+    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+
+    glDisableVertexAttribArray(0);
+    glDisableVertexAttribArray(1);
+    glDeleteBuffers(1, &rectangleVBO);
+
+    // Re-enable depth testing for subsequent rendering
+    glEnable(GL_DEPTH_TEST);
+}
+
 void Game::RenderText(const char* text, float x, float y, float scale) {
     // Set up 2D rendering, using orthographic projection
     glDisable(GL_DEPTH_TEST);
@@ -619,15 +670,97 @@ void Game::RenderText(const char* text, float x, float y, float scale) {
 }
 
 
-void Game::SetupResources(void){
+void Game::Setup(void){
+
+    loading_ = new TaskGraph(resman_.GetThreadPool());
+    TaskGraph &graph = *loading_;
+    // Chosen here so the workers need not share rand()
+    unsigned int field_seed = rand();
+    unsigned int distant_seed = rand();
+
+    // Requests that complete in the background go first: shaders compile
+    // in the driver and images decode on the workers while this thread
+    // generates the meshes
+    int materials = graph.AddMain("Materials", [this](){ LoadMaterials(); });
+    int textures = graph.AddMain("Textures", [this](){ LoadTextures(); });
+    int height_map = graph.Add("HeightMap", [this](){
+        height_map_ = resman_.ReadHeightMap(material_directory_g+"\\height_map.txt");
+    });
+    int impassable_map = graph.Add("ImpassableMap", [this](){
+        impassable_map_ = CreateImpassableTerrainMap(height_map_);
+    }, {height_map});
+    int field_placement = graph.Add("AsteroidPlacement", [this, field_seed](){
+        asteroid_placement_ = PlaceAsteroids(500, field_seed);
+    }, {height_map});
+    int distant_placement = graph.Add("DistantPlacement", [this, distant_seed](){
+        distant_placement_ = PlaceAsteroids(distant_asteroid_count_g, distant_seed);
+    }, {height_map});
+
+    // One mesh per task, so a slice of loading stays short. Their
+    // materials ignore the vertex color, so meshes with texture
+    // coordinates in [0, 1] use the compact vertex layout
+    int sphere = graph.AddMain("SphereMesh", [this](){
+        resman_.CreateSphere("SphereMesh", 0.6, 90, 45, CompactVertex::Format());
+    });
+    int asteroid = graph.AddMain("AsteroidMesh", [this](){
+        resman_.CreateSphere("AsteroidMesh", 3, 90, 45, CompactVertex::Format());
+    });
+    int cylinder = graph.AddMain("AntennaCylinderMesh", [this](){
+        resman_.CreateCylinder("AntennaCylinderMesh", 1.0, 0.025, 30, 30, CompactVertex::Format());
+    });
+    int torus = graph.AddMain("AntennaTorusMesh", [this](){
+        resman_.CreateSeamlessTorus("AntennaTorusMesh", 0.1, 0.05, 80, 80, CompactVertex::Format());
+    });
+    int player = graph.AddMain("PlayerMesh", [this](){
+        resman_.CreateRectangle("PlayerMesh", 1.0, 0.5, 3.0);
+    });
+    int terrain = graph.AddMain("TerrainMesh", [this](){
+        // The terrain repeats its texture, past the precision of half floats
+        resman_.CreateTerrain("TerrainMesh", height_map_, length_, width_, StandardVertex::Format());
+    }, {height_map});
+    // The impostors and static batches read the meshes back from their
+    // buffers, which the queue fills over the next frames
+    int mesh_uploads = graph.AddPoll("MeshUploads", [this](){
+        return resman_.GetUploadQueue().IsEmpty();
+    }, {sphere, asteroid, cylinder, torus, player, terrain});
+
+    int draw_to_texture = graph.AddMain("DrawToTexture", [this](){ scene_.SetupDrawToTexture(); });
+    int particles = graph.AddMain("Particles", [this](){
+        resman_.CreateParticleEffect2("BeaconParticles");
+        resman_.CreateParticleEffect3("SphereParticles");
+    });
+    int finish_materials = graph.AddPoll("FinishMaterials", [this](){ return FinishMaterials(); }, {materials});
+    // Nodes copy the texture handles, which exist once uploaded
+    int finish_textures = graph.AddPoll("FinishTextures", [this](){
+        return resman_.UpdateTextureLoads() == 0;
+    }, {textures});
+    int impostors = graph.AddMain("Impostors", [this](){ SetupImpostors(); }, {mesh_uploads, finish_materials, finish_textures});
+    int scene = graph.AddMain("Scene", [this](){ SetupScene(); }, {sphere, player, terrain, finish_materials, finish_textures});
+    int field = graph.AddMain("AsteroidField", [this](){
+        CreateAsteroidField(asteroid_placement_);
+    }, {scene, asteroid, field_placement});
+    int distant = graph.AddMain("DistantAsteroids", [this](){
+        CreateDistantAsteroids(distant_placement_);
+    }, {distant_placement});
+    int batching = graph.AddMain("StaticBatching", [this](){
+        // The asteroids never move: merge them into static batches
+        StaticBatcher batcher(static_batch_cell_size_g, static_batch_budget_g);
+        batcher.Build(&scene_, &resman_);
+        if (print_startup_stats_g){
+            std::cout << "Static batching: " << batcher.GetMergedCount() << " nodes in " << batcher.GetChunkCount()
+                      << " chunks, " << batcher.GetMemoryUsed() / (1024 * 1024) << " MB" << std::endl;
+        }
+    }, {field, mesh_uploads});
+    int movers = graph.AddMain("Movers", [this](){ SetupMovers(); }, {scene, impassable_map});
+    // Everything is in place before the game starts; the main loop
+    // processes the upload queue every frame
+    graph.AddPoll("Uploads", [this](){
+        return resman_.GetUploadQueue().IsEmpty();
+    }, {draw_to_texture, particles, impostors, distant, batching, movers});
+}
+
 
-    // Create geometry of the objects
-    resman_.CreateSphere("SphereMesh");
-    resman_.CreateSphere("AsteroidMesh", 3, 90, 45);
-    resman_.CreateTerrain("TerrainMesh", length_, width_);
-    resman_.CreateRectangle("PlayerMesh", 1.0, 0.5, 3.0);
-    resman_.CreateCylinder("AntennaCylinderMesh", 1.0, 0.025, 30, 30);
-    resman_.CreateSeamlessTorus("AntennaTorusMesh", 0.1, 0.05, 80, 80);
+void Game::LoadMaterials(void){
 
     //RESOURCE MANAGER ADDS TO THE FILENAME STRING 
     // Load shader for texture mapping
@@ -638,8 +771,39 @@ void Game::SetupResources(void){
 	filename = std::string(MATERIAL_DIRECTORY) + std::string("/lit");
 	resman_.LoadResource(Material, "Lighting", filename.c_str());
 
+    // Variants of the shaders above that read their matrices from the
+    // storage buffer of the multi-draw renderer
+    if (multi_draw_g && MultiDrawRenderer::IsSupported()){
+        filename = std::string(MATERIAL_DIRECTORY) + std::string("/textured_material_mdi");
+        resman_.LoadResource(Material, "TextureShaderMultiDraw", filename.c_str());
+        filename = std::string(MATERIAL_DIRECTORY) + std::string("/lit_mdi");
+        resman_.LoadResource(Material, "LightingMultiDraw", filename.c_str());
+    }
+
+    // Load material to be applied to particles
+    filename = std::string(MATERIAL_DIRECTORY) + std::string("/particle2");
+    resman_.LoadResource(Material, "ParticleMaterial2", filename.c_str());
+
+    // // Load material to be applied to particles
+    filename = std::string(MATERIAL_DIRECTORY) + std::string("/particle3");
+    resman_.LoadResource(Material, "ParticleMaterial3", filename.c_str());
+
+    // Load material for screen-space effect
+    filename = std::string(MATERIAL_DIRECTORY) + std::string("/screen_space");
+    resman_.LoadResource(Material, "ScreenSpaceMaterial", filename.c_str());
+
+    // Instanced asteroids and their impostors
+    filename = std::string(MATERIAL_DIRECTORY) + std::string("/lit_instanced");
+    resman_.LoadResource(Material, "LightingInstanced", filename.c_str());
+    filename = std::string(MATERIAL_DIRECTORY) + std::string("/impostor");
+    resman_.LoadResource(Material, "ImpostorMaterial", filename.c_str());
+}
+
+
+void Game::LoadTextures(void){
+
 	// Load texture to be used on the object
-	filename = std::string(MATERIAL_DIRECTORY) + std::string("/mars.jpg");
+	std::string filename = std::string(MATERIAL_DIRECTORY) + std::string("/mars.jpg");
 	resman_.LoadResource(Texture, "RockyTexture", filename.c_str());
 
     // Load texture to be used on the object
@@ -664,23 +828,48 @@ void Game::SetupResources(void){
 
     filename = std::string(MATERIAL_DIRECTORY) + std::string("/orb3.png");
 	resman_.LoadResource(Texture, "OrbTexture", filename.c_str());
+}
 
-    // Load material to be applied to particles
-    filename = std::string(MATERIAL_DIRECTORY) + std::string("/particle2");
-    resman_.LoadResource(Material, "ParticleMaterial2", filename.c_str());
 
-    // // Load material to be applied to particles
-    filename = std::string(MATERIAL_DIRECTORY) + std::string("/particle3");
-    resman_.LoadResource(Material, "ParticleMaterial3", filename.c_str());
+bool Game::FinishMaterials(void){
+
+    // Every material requested so far was compiled in parallel
+    if (resman_.UpdateMaterialLoads() > 0){
+        return false;
+    }
+
+    if (multi_draw_g && MultiDrawRenderer::IsSupported()){
+        multi_draw_.Init();
+        multi_draw_.SetMaterialVariant(resman_.GetResource("TextureShader")->GetResource(), resman_.GetResource("TextureShaderMultiDraw")->GetResource());
+        multi_draw_.SetMaterialVariant(resman_.GetResource("Lighting")->GetResource(), resman_.GetResource("LightingMultiDraw")->GetResource());
+        scene_.SetMultiDrawRenderer(&multi_draw_);
+    }
+    return true;
+}
+
+
+void Game::UpdateOverlayTextures(void){
+
+    // Handles of the overlay textures uploaded since the last frame
+    for (int i = 0; i < overlay_texture_.size(); ) {
+        if (overlay_texture_[i].first->GetResource()) {
+            *overlay_texture_[i].second = overlay_texture_[i].first->GetResource();
+            overlay_texture_.erase(overlay_texture_.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
 
-    // Load material for screen-space effect
-    filename = std::string(MATERIAL_DIRECTORY) + std::string("/screen_space");
-    resman_.LoadResource(Material, "ScreenSpaceMaterial", filename.c_str());
 
-    // Setup drawing to texture
-    scene_.SetupDrawToTexture();
-    resman_.CreateParticleEffect2("BeaconParticles");
-    resman_.CreateParticleEffect3("SphereParticles");
+void Game::SetupImpostors(void){
+
+    // Bake the views of the asteroid used by its impostors
+    distant_asteroids_.Bake(resman_.GetResource("AsteroidMesh"), resman_.GetResource("Lighting"), resman_.GetResource("AsteroidTexture"));
+    distant_asteroids_.SetPrograms(resman_.GetResource("LightingInstanced")->GetResource(), resman_.GetResource("ImpostorMaterial")->GetResource());
+    distant_asteroids_.SetDistance(impostor_distance_g);
+    distant_asteroids_.SetLodThreshold(lod_threshold_g);
+    scene_.AddImpostorField(&distant_asteroids_);
 }
 
 
@@ -688,6 +877,8 @@ void Game::SetupScene(void){
 
     // Set background color for the scene
     scene_.SetBackgroundColor(viewport_background_color_g);
+    scene_.SetCulling(frustum_culling_g);
+    scene_.SetLodThreshold(lod_threshold_g);
 
     // Create an object for showing the texture
 	// instance contains identifier, geometry, shader, and texture
@@ -709,41 +900,68 @@ void Game::SetupScene(void){
 
     skybox->Scale(glm::vec3(1800.0, 1200.0, 1800.0));
 
-    floor->Translate(glm::vec3(-400, 0, 400));
-    floor->Scale(glm::vec3(10.0, 10.0, 10.0));	
+    floor->SetPosition(floor_position_g);
+    floor->SetScale(floor_scale_g);
 
 
 }
 
 
-void Game::MainLoop(void){
-	float bleh = 0;
-    
-    SceneNode* floor = scene_.GetNode("Floor");
-
-    std::vector<std::vector<float>> height_map = ResourceManager::ReadHeightMap(material_directory_g+"\\height_map.txt");
-    std::vector<std::vector<bool>> impassable_map = CreateImpassableTerrainMap(height_map);
-
-    CreateAsteroidField(500, floor, height_map);
+void Game::SetupMovers(void){
 
-    player_->SetFloorPos(floor->GetPosition());
-    player_->SetFloorScale(floor->GetScale());
-    player_->SetImpassableMap(impassable_map);
+    player_->SetFloorPos(floor_position_g);
+    player_->SetFloorScale(floor_scale_g);
+    player_->SetImpassableMap(impassable_map_);
 
     for(int i =0; i < num_orbs_; i++){
-        orbs_[i]->SetFloorPos(floor->GetPosition());
-        orbs_[i]->SetFloorScale(floor->GetScale());
-        orbs_[i]->SetImpassableMap(impassable_map);
+        orbs_[i]->SetFloorPos(floor_position_g);
+        orbs_[i]->SetFloorScale(floor_scale_g);
+        orbs_[i]->SetImpassableMap(impassable_map_);
         
-        double randx = (((double) rand() / RAND_MAX) * length_ * floor->GetScale().x + floor->GetPosition().x);
-        double randz = -((double) rand() / RAND_MAX) * width_ * floor->GetScale().z + floor->GetPosition().z;
+        double randx = (((double) rand() / RAND_MAX) * length_ * floor_scale_g.x + floor_position_g.x);
+        double randz = -((double) rand() / RAND_MAX) * width_ * floor_scale_g.z + floor_position_g.z;
         orbs_[i]->SetPosition(glm::vec3(randx, 0, randz));
-        orbs_[i]->Update(height_map, length_ , width_);
+        orbs_[i]->Update(height_map_, length_ , width_);
     }
+}
+
+
+void Game::MainLoop(void){
+	float bleh = 0;
     
     // Loop while the user did not close the window
     while (!glfwWindowShouldClose(window_)){
 
+        // Upload textures requested during the game once they are decoded,
+        // and at most the budget of queued data
+        resman_.UpdateTextureLoads();
+        resman_.GetUploadQueue().Process();
+        resman_.SetUnmanagedMemory(multi_draw_.GetMemoryUsed() + distant_asteroids_.GetMemoryUsed());
+        resman_.TrimMemory();
+
+        // Load a slice of the game, then draw the title screen with the
+        // progress so far
+        if (loading_){
+            bool loaded = loading_->RunFor(loading_slice_g);
+            UpdateOverlayTextures();
+            glClearColor(viewport_background_color_g[0], viewport_background_color_g[1], viewport_background_color_g[2], 0.0);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            if (textureIDs[0]) {
+                RenderGameMenu(0);
+            }
+            RenderProgressBar(loading_->GetProgress());
+            if (loaded) {
+                if (print_startup_stats_g) {
+                    std::cout << "Startup: " << loading_->GetCriticalPath() << std::endl;
+                }
+                delete loading_;
+                loading_ = NULL;
+            }
+            glfwSwapBuffers(window_);
+            glfwPollEvents();
+            continue;
+        }
+
         // Animate the scene
         if (animating_ && !pre_game){
             static double last_time = 0;
@@ -753,12 +971,18 @@ void Game::MainLoop(void){
                 scene_.Update();
                 Controls();
 
-                // Setting uniforms for lighting shader
-                Resource* mat = resman_.GetResource("Lighting");
-                glUseProgram(mat->GetResource());
-                // Uniform player position
-                GLint view_pos = glGetUniformLocation(mat->GetResource(), "view_pos");
-                glUniform3fv(view_pos, 1, glm::value_ptr(camera_.GetPosition()));
+                // Setting uniforms for lighting shaders
+                const char* lit_material[] = { "Lighting", "LightingMultiDraw", "LightingInstanced" };
+                for (int i = 0; i < 3; i++) {
+                    Resource* mat = resman_.GetResource(lit_material[i]);
+                    if (!mat) {
+                        continue;
+                    }
+                    glUseProgram(mat->GetResource());
+                    // Uniform player position
+                    GLint view_pos = glGetUniformLocation(mat->GetResource(), "view_pos");
+                    glUniform3fv(view_pos, 1, glm::value_ptr(camera_.GetPosition()));
+                }
 
                 SceneNode *skybox = scene_.GetNode("SkyBox");
 
@@ -766,7 +990,7 @@ void Game::MainLoop(void){
                 glm::vec3 offsetInPlayerSpace = glm::vec3(0.2, 1.5, 15.0);
                 glm::vec3 offsetInWorldSpace = glm::vec3(orientationMatrix * glm::vec4(offsetInPlayerSpace, 0.0f));
 
-                player_->Update(height_map, length_, width_);
+                player_->Update(height_map_, length_, width_);
                 camera_.SetPosition(player_->GetPosition() + offsetInWorldSpace);
                 camera_.SetOrientation(player_->GetOrientation());
 
@@ -787,6 +1011,27 @@ void Game::MainLoop(void){
 
         // Draw the scene to a texture
         scene_.DrawToTexture(&camera_);
+
+        // Report culling statistics once per second
+        if (show_cull_stats_g){
+            static double last_report = 0;
+            double now = glfwGetTime();
+            if (now - last_report > 1.0){
+                const CullStats &stats = scene_.GetCullStats();
+                std::stringstream ss;
+                ss << window_title_g << " - visible " << stats.visible << "/" << stats.total
+                   << ", culled " << stats.culled << ", cull time " << stats.time_ms << " ms"
+                   << ", triangles " << stats.triangles;
+                if (multi_draw_g && MultiDrawRenderer::IsSupported()){
+                    ss << ", draw calls " << multi_draw_.GetDrawCallCount();
+                }
+                ss << ", instanced asteroids " << distant_asteroids_.GetMeshCount()
+                   << ", impostors " << distant_asteroids_.GetImpostorCount()
+                   << ", GPU memory " << resman_.GetMemoryUsed() / (1024 * 1024) << " MB";
+                glfwSetWindowTitle(window_, ss.str().c_str());
+                last_report = now;
+            }
+        }
         // Process the texture with a screen-space effect and display
         // the texture
         scene_.DisplayTexture(resman_.GetResource("ScreenSpaceMaterial")->GetResource(), player_->fill);
@@ -849,10 +1094,16 @@ void Game::ResizeCallback(GLFWwindow* window, int width, int height){
 
 Game::~Game(){
     
+    // Waits for the loading still running on the workers
+    delete loading_;
+    // Buffers, textures and programs go before the context, along with
+    // the uploads still queued
+    resman_.GetUploadQueue().DeleteObjects();
+    resman_.DeleteObjects();
     glfwTerminate();
 }
 
-Orb* Game::CreateOrbInstance(std::string entity_name, std::string object_name, std::string material_name, std::string texture_name){
+Orb* Game::CreateOrbInstance(const std::string &entity_name, const std::string &object_name, const std::string &material_name, const std::string &texture_name){
 
     Resource* geom = resman_.GetResource("BeaconParticles");
     if (!geom){
@@ -893,7 +1144,7 @@ Orb* Game::CreateOrbInstance(std::string entity_name, std::string object_name, s
     return orb;
 }
 
-void Game::CreatePlayer(std::string entity_name, std::string object_name, std::string material_name, std::string texture_name){
+void Game::CreatePlayer(const std::string &entity_name, const std::string &object_name, const std::string &material_name, const std::string &texture_name){
     // Get resources
     Resource *geom = resman_.GetResource(object_name);
     if (!geom){
@@ -935,7 +1186,7 @@ void Game::CreatePlayer(std::string entity_name, std::string object_name, std::s
 }
 
 
-SceneNode *Game::CreateInstance(std::string entity_name, std::string object_name, std::string material_name, std::string texture_name){
+SceneNode *Game::CreateInstance(const std::string &entity_name, const std::string &object_name, const std::string &material_name, const std::string &texture_name){
 
     Resource *geom = resman_.GetResource(object_name);
     if (!geom){
@@ -959,7 +1210,7 @@ SceneNode *Game::CreateInstance(std::string entity_name, std::string object_name
     return scn;
 }
 
-SceneNode* Game::CreateNonSceneInstance(std::string entity_name, std::string object_name, std::string material_name, std::string texture_name) {
+SceneNode* Game::CreateNonSceneInstance(const std::string &entity_name, const std::string &object_name, const std::string &material_name, const std::string &texture_name) {
 
     Resource* geom = resman_.GetResource(object_name);
     if (!geom) {
@@ -1069,13 +1320,60 @@ std::vector<std::vector<bool>> Game::CreateImpassableTerrainMap(std::vector<std:
 }
 
 // Creates the asteroids scattered across the surface of the height map
-void Game::CreateAsteroidField(int num_asteroids, SceneNode* floor_, std::vector<std::vector<float>> height_values) {
+glm::vec3 Game::RandomFieldPosition(std::mt19937 &generator, const std::vector<std::vector<float>> &height_values) const {
 
     int length_count = height_values.size();
     int width_count = height_values[0].size();
-    float height = 0.0;
+    float height = floor_position_g.y;
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // Random position over the floor
+    float x_pos = (floor_position_g.x + length_ * floor_scale_g.x * unit(generator));
+    float z_pos = (floor_position_g.z - width_ * floor_scale_g.z * unit(generator));
+
+    float x = ((x_pos - floor_position_g.x) / (length_ * floor_scale_g.x) * length_count);
+    float z = (-(z_pos - floor_position_g.z) / (width_ * floor_scale_g.z) * width_count);
+
+    // Height of the terrain under it
+    if ((length_count-1 > floor(x)) && (floor(x) >= 0) && (width_count-1 > floor(z)) && (floor(z) >= 0)) {
+
+        float a = height_values[floor(x)][ceil(z)];
+        float b = height_values[ceil(x)][ceil(z)];
+        float c = height_values[floor(x)][floor(z)];
+        float d = height_values[ceil(x)][floor(z)];
+
+        float s = x - floor(x);
+        float t = z - floor(z);
+
+        height = (1 - t) * ((1 - s) * a + s * b) + (t * ((1 - s) * c + s * d));
+
+        height = floor_position_g.y + (height / 5.0f) * floor_scale_g.y;
+    }
+
+    return glm::vec3(x_pos, height, z_pos);
+}
 
+
+std::vector<Game::AsteroidPlacement> Game::PlaceAsteroids(int num_asteroids, unsigned int seed) const {
+
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<AsteroidPlacement> placement(num_asteroids);
     for (int i = 0; i < num_asteroids; i++) {
+        // Random position, size and orientation
+        placement[i].position = RandomFieldPosition(generator, height_map_);
+        placement[i].scale = 1 + 4 * unit(generator);
+        float angle = glm::pi<float>() * unit(generator);
+        glm::vec3 axis(unit(generator), unit(generator), unit(generator));
+        placement[i].orientation = glm::normalize(glm::angleAxis(angle, axis));
+    }
+    return placement;
+}
+
+
+void Game::CreateAsteroidField(const std::vector<AsteroidPlacement> &placement) {
+
+    for (int i = 0; i < placement.size(); i++) {
         // Create instance name
         std::stringstream ss;
         ss << i;
@@ -1085,36 +1383,22 @@ void Game::CreateAsteroidField(int num_asteroids, SceneNode* floor_, std::vector
         // Create asteroid instance
         SceneNode* ast = CreateInstance(name, "AsteroidMesh", "Lighting", "AsteroidTexture");
 
-        // Set attributes of asteroid: random position, orientation, and
-        float x_pos = (floor_->GetPosition().x + length_ * floor_->GetScale().x * ((float)rand() / RAND_MAX));
-        float z_pos = (floor_->GetPosition().z - width_ * floor_->GetScale().z * ((float)rand() / RAND_MAX));
-
-        float x = ((x_pos - floor_->GetPosition().x) / (length_ * floor_->GetScale().x) * length_count);
-        float z = (-(z_pos - floor_->GetPosition().z) / (width_ * floor_->GetScale().z) * width_count);
-
-        if ((length_count-1 > floor(x)) && (floor(x) >= 0) && (width_count-1 > floor(z)) && (floor(z) >= 0)) {
-
-            float a = height_values[floor(x)][ceil(z)];
-            float b = height_values[ceil(x)][ceil(z)];
-            float c = height_values[floor(x)][floor(z)];
-            float d = height_values[ceil(x)][floor(z)];
-
-            float s = x - floor(x);
-            float t = z - floor(z);
+        ast->SetScale(glm::vec3(placement[i].scale, placement[i].scale, placement[i].scale));
+        ast->SetPosition(placement[i].position);
+        ast->SetOrientation(placement[i].orientation);
+        ast->SetStatic(true);
+        
+    }
 
-            height = (1 - t) * ((1 - s) * a + s * b) + (t * ((1 - s) * c + s * d));
+}
 
-            height = floor_->GetPosition().y + (height / 5.0f) * floor_->GetScale().y;
-        }
 
-        float rand_scale = 1 + 4 * ((float)rand() / RAND_MAX);
+void Game::CreateDistantAsteroids(const std::vector<AsteroidPlacement> &placement) {
 
-        ast->SetScale(glm::vec3(rand_scale, rand_scale, rand_scale));
-        ast->SetPosition(glm::vec3(x_pos, height, z_pos));
-        ast->SetOrientation(glm::normalize(glm::angleAxis(glm::pi<float>() * ((float)rand() / RAND_MAX), glm::vec3(((float)rand() / RAND_MAX), ((float)rand() / RAND_MAX), ((float)rand() / RAND_MAX)))));
-        
+    // Instances only have a position and a scale, so they cost no scene node
+    for (int i = 0; i < placement.size(); i++) {
+        distant_asteroids_.AddInstance(placement[i].position, placement[i].scale);
     }
-
 }
 
 
@@ -6,6 +6,7 @@
 #include <exception>
 #include <string>
 #include <iostream>
+#include <random>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -20,6 +21,8 @@
 #include "camera.h"
 #include "player.h"
 #include "orb.h"
+#include "static_batch.h"
+#include "task_graph.h"
 
 namespace game {
 
@@ -43,10 +46,11 @@ namespace game {
         ~Game();
         // Call Init() before calling any other method
         void Init(void);
-        // Set up resources for the game
-        void SetupResources(void);
-        // Set up initial scene
-        void SetupScene(void);
+        // Queue the loading of the resources and the initial scene, in
+        // steps that run at the same time when they do not depend on each
+        // other. MainLoop runs them a slice per frame behind the title
+        // screen
+        void Setup(void);
         // Run the game: keep the application active
         void MainLoop(void);
 
@@ -63,6 +67,12 @@ namespace game {
         // Camera abstraction
         Camera camera_;
 
+        // Batched submission of the scene, used if the context supports it
+        MultiDrawRenderer multi_draw_;
+
+        // Asteroids drawn with instancing and impostors
+        ImpostorField distant_asteroids_;
+
         // Player abstraction
         Player* player_;
 
@@ -81,6 +91,19 @@ namespace game {
         float length_ = 500;
         float width_ = 500;
 
+        // Terrain heights, and where the terrain is too steep to cross
+        std::vector<std::vector<float>> height_map_;
+        std::vector<std::vector<bool>> impassable_map_;
+
+        // Random asteroid on the terrain, chosen by a worker at startup
+        struct AsteroidPlacement {
+            glm::vec3 position;
+            float scale;
+            glm::quat orientation;
+        };
+        std::vector<AsteroidPlacement> asteroid_placement_;
+        std::vector<AsteroidPlacement> distant_placement_;
+
         GLuint programID3D;
         GLuint programID2D;
         GLuint programID2DTank;
@@ -88,6 +111,13 @@ namespace game {
         GLuint textureIDs[4];
         GLuint numberTextures[10];
         GLuint slash;
+        // One-texel texture of the progress bar
+        GLuint progress_texture_;
+        // Loading still to do, NULL once the game is loaded
+        TaskGraph *loading_ = NULL;
+
+        // Overlay textures still loading, and where their handles go
+        std::vector<std::pair<Resource*, GLuint*> > overlay_texture_;
 
         // Methods to initialize the game
         void InitWindow(void);
@@ -95,12 +125,24 @@ namespace game {
         void InitEventHandlers(void);
         void Init2D(void);
 
+        // Steps of Setup; see it for what each one waits for
+        void LoadMaterials(void);
+        void LoadTextures(void);
+        // True once every material is linked
+        bool FinishMaterials(void);
+        void SetupImpostors(void);
+        void SetupScene(void);
+        void SetupMovers(void);
+
         void Render2DOverlay(void);
         void RenderTank(void);
         void RenderText(const char* text, float x, float y, float scale);
         void RenderGameMenu(int menu_index);
         void RenderPNG(float offset_x, GLuint texture);
+        void RenderProgressBar(float progress);
         void Load2DTexture(std::string filename, GLuint* textureID);
+        // Fill in the handles of the overlay textures uploaded so far
+        void UpdateOverlayTextures(void);
 
         // Methods to handle events
         static void ResizeCallback(GLFWwindow* window, int width, int height);
@@ -110,17 +152,25 @@ namespace game {
 
         // Asteroid field
         // Create instance of one asteroid
-        Orb* CreateOrbInstance(std::string entity_name, std::string object_name, std::string material_name, std::string texture_name);
+        Orb* CreateOrbInstance(const std::string &entity_name, const std::string &object_name, const std::string &material_name, const std::string &texture_name);
 
-        SceneNode* CreateNonSceneInstance(std::string entity_name, std::string object_name, std::string material_name, std::string texturename);
+        SceneNode* CreateNonSceneInstance(const std::string &entity_name, const std::string &object_name, const std::string &material_name, const std::string &texturename);
 
+        // Random asteroids over the floor; touches no scene node or
+        // OpenGL object, so a worker can run it
+        std::vector<AsteroidPlacement> PlaceAsteroids(int num_asteroids, unsigned int seed) const;
         // Create entire random asteroid field
-        void CreateAsteroidField(int num_asteroids, SceneNode* floor_, std::vector<std::vector<float>> height_values);
+        void CreateAsteroidField(const std::vector<AsteroidPlacement> &placement);
+        // Scatter instanced asteroids over the floor, drawn as impostors
+        // once far away
+        void CreateDistantAsteroids(const std::vector<AsteroidPlacement> &placement);
+        // Random point on the terrain covered by the floor
+        glm::vec3 RandomFieldPosition(std::mt19937 &generator, const std::vector<std::vector<float>> &height_values) const;
         // Create the player
-        void CreatePlayer(std::string entity_name, std::string object_name, std::string material_name, std::string texture_name);
+        void CreatePlayer(const std::string &entity_name, const std::string &object_name, const std::string &material_name, const std::string &texture_name);
 
         // Create an instance of an object stored in the resource manager
-        SceneNode* CreateInstance(std::string entity_name, std::string object_name, std::string material_name, std::string texture_name = std::string(""));
+        SceneNode* CreateInstance(const std::string &entity_name, const std::string &object_name, const std::string &material_name, const std::string &texture_name = std::string(""));
 
         std::vector<std::vector<bool>> CreateImpassableTerrainMap(std::vector<std::vector<float>> height_values);
 
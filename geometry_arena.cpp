@@ -0,0 +1,143 @@
+#include <vector>
+
+#include "geometry_arena.h"
+
+namespace game {
+
+// Smallest size a buffer of the arena is grown to
+static const GLsizeiptr min_arena_size = 1024 * 1024;
+
+GeometryArena::GeometryArena(const VertexFormat &format){
+
+    format_ = &format;
+    vertex_size_ = format.stride;
+    array_buffer_ = 0;
+    element_array_buffer_ = 0;
+    vertex_capacity_ = 0;
+    index_capacity_ = 0;
+    vertex_used_ = 0;
+    index_used_ = 0;
+}
+
+
+GeometryArena::~GeometryArena(){
+}
+
+
+bool GeometryArena::Add(const Resource *geometry){
+
+    if (range_.find(geometry) != range_.end()){
+        return true;
+    }
+    if (geometry->GetType() != Mesh || geometry->GetElementArrayBuffer() == 0 || &geometry->GetVertexFormat() != format_){
+        return false;
+    }
+    // Attribute streams laid out by a file cannot be offset by a base vertex
+    if (!format_->unpack){
+        return false;
+    }
+
+    GLint vertex_bytes;
+    glBindBuffer(GL_COPY_READ_BUFFER, geometry->GetArrayBuffer());
+    glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &vertex_bytes);
+    GLsizeiptr index_bytes = geometry->GetSize() * sizeof(GLuint);
+
+    Reserve(array_buffer_, vertex_capacity_, vertex_used_, vertex_used_ + vertex_bytes);
+    Reserve(element_array_buffer_, index_capacity_, index_used_, index_used_ + index_bytes);
+
+    // Copy vertices and indices without a round trip through the CPU
+    glBindBuffer(GL_COPY_READ_BUFFER, geometry->GetArrayBuffer());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, array_buffer_);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, vertex_used_, vertex_bytes);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, geometry->GetElementArrayBuffer());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, element_array_buffer_);
+    if (geometry->GetIndexType() == GL_UNSIGNED_SHORT){
+        // The arena holds 32-bit indices; 16-bit ones are widened once
+        std::vector<GLushort> short_index(geometry->GetSize());
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, short_index.size() * sizeof(GLushort), &short_index[0]);
+        std::vector<GLuint> index(short_index.begin(), short_index.end());
+        glBufferSubData(GL_COPY_WRITE_BUFFER, index_used_, index_bytes, &index[0]);
+    } else {
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, index_used_, index_bytes);
+    }
+
+    ArenaRange range;
+    range.first_index = index_used_ / sizeof(GLuint);
+    range.index_count = geometry->GetSize();
+    range.base_vertex = vertex_used_ / vertex_size_;
+    range_[geometry] = range;
+
+    // Keep the next mesh aligned to a whole vertex
+    vertex_used_ += ((vertex_bytes + vertex_size_ - 1) / vertex_size_) * vertex_size_;
+    index_used_ += index_bytes;
+
+    return true;
+}
+
+
+const ArenaRange *GeometryArena::Find(const Resource *geometry) const {
+
+    std::map<const Resource *, ArenaRange>::const_iterator it = range_.find(geometry);
+    if (it == range_.end()){
+        return NULL;
+    }
+    return &it->second;
+}
+
+
+GLuint GeometryArena::GetArrayBuffer(void) const {
+
+    return array_buffer_;
+}
+
+
+GLuint GeometryArena::GetElementArrayBuffer(void) const {
+
+    return element_array_buffer_;
+}
+
+
+const VertexFormat &GeometryArena::GetVertexFormat(void) const {
+
+    return *format_;
+}
+
+
+size_t GeometryArena::GetMemoryUsed(void) const {
+
+    return (size_t) (vertex_capacity_ + index_capacity_);
+}
+
+
+void GeometryArena::Reserve(GLuint &buffer, GLsizeiptr &capacity, GLsizeiptr used, GLsizeiptr size){
+
+    if (size <= capacity){
+        return;
+    }
+
+    // Double the size to keep the number of copies logarithmic
+    GLsizeiptr new_capacity = capacity * 2;
+    if (new_capacity < size){
+        new_capacity = size;
+    }
+    if (new_capacity < min_arena_size){
+        new_capacity = min_arena_size;
+    }
+
+    GLuint new_buffer;
+    glGenBuffers(1, &new_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, new_buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, new_capacity, NULL, GL_STATIC_DRAW);
+
+    if (buffer){
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+        glDeleteBuffers(1, &buffer);
+    }
+
+    buffer = new_buffer;
+    capacity = new_capacity;
+}
+
+} // namespace game
@@ -0,0 +1,63 @@
+#ifndef GEOMETRY_ARENA_H_
+#define GEOMETRY_ARENA_H_
+
+#include <map>
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "resource.h"
+
+namespace game {
+
+    // Location of a mesh inside a GeometryArena
+    struct ArenaRange {
+        GLuint first_index; // Offset of the first index, in indices
+        GLuint index_count; // Number of indices
+        GLint base_vertex; // Offset added to every index
+    };
+
+    // Shared vertex and index buffers holding many meshes
+    //
+    // Meshes are copied from their own buffers on the GPU, and keep their
+    // indices unchanged: draws add the base vertex of the mesh instead.
+    // All meshes in an arena share one vertex layout
+    class GeometryArena {
+
+        public:
+            GeometryArena(const VertexFormat &format);
+            ~GeometryArena();
+
+            // Copy a mesh into the arena; returns false for geometry that
+            // has no index buffer or another vertex layout
+            bool Add(const Resource *geometry);
+            // Location of a mesh, NULL if it was never added
+            const ArenaRange *Find(const Resource *geometry) const;
+
+            // Buffers to bind when drawing from the arena
+            GLuint GetArrayBuffer(void) const;
+            GLuint GetElementArrayBuffer(void) const;
+            // Layout shared by the meshes
+            const VertexFormat &GetVertexFormat(void) const;
+            // Bytes of both buffers, used or not
+            size_t GetMemoryUsed(void) const;
+
+        private:
+            const VertexFormat *format_;
+            GLsizei vertex_size_; // Bytes per vertex
+            GLuint array_buffer_;
+            GLuint element_array_buffer_;
+            GLsizeiptr vertex_capacity_; // Sizes of the buffers, in bytes
+            GLsizeiptr index_capacity_;
+            GLsizeiptr vertex_used_; // Bytes filled so far
+            GLsizeiptr index_used_;
+            std::map<const Resource *, ArenaRange> range_; // Meshes added
+
+            // Grow a buffer to hold at least size bytes, keeping the bytes
+            // already used
+            static void Reserve(GLuint &buffer, GLsizeiptr &capacity, GLsizeiptr used, GLsizeiptr size);
+
+    }; // class GeometryArena
+
+} // namespace game
+
+#endif // GEOMETRY_ARENA_H_
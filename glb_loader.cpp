@@ -0,0 +1,657 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sstream>
+#include <stdexcept>
+
+#include "glb_loader.h"
+
+namespace game {
+
+// Identifiers of the file and of its chunks, as little-endian words
+static const GLuint glb_magic = 0x46546C67; // "glTF"
+static const GLuint glb_chunk_json = 0x4E4F534A; // "JSON"
+static const GLuint glb_chunk_binary = 0x004E4942; // "BIN\0"
+
+// glTF component types are the matching GL enums
+static const GLenum gltf_float = GL_FLOAT;
+
+// Deepest nesting accepted in the JSON chunk
+static const int max_json_depth = 64;
+
+// Value of the JSON chunk. Values live in a single array and refer to
+// the values they contain by index
+struct JsonValue {
+    enum Kind { Null, Bool, Number, String, Array, Object } kind;
+    double number; // Also 0 or 1 for booleans
+    std::string string;
+    std::vector<int> member; // Elements of an array, values of an object
+    std::vector<std::string> key; // Keys of an object
+};
+
+
+// Small JSON reader for the scene description of a glTF file. Lookups
+// take and return value indices, -1 standing for a missing value
+class JsonDocument {
+
+    public:
+        // Parse a whole document, which becomes value 0; false on errors
+        bool Parse(const char *text, size_t size){
+            value_.clear();
+            p_ = text;
+            end_ = text + size;
+            if (ParseValue(0) != 0){
+                return false;
+            }
+            SkipSpace();
+            // The chunk may be padded with spaces or zeros
+            while (p_ < end_ && *p_ == '\0'){
+                p_++;
+            }
+            return p_ == end_;
+        }
+
+        // Member of an object
+        int Find(int value, const char *key) const {
+            if (value < 0 || value_[value].kind != JsonValue::Object){
+                return -1;
+            }
+            for (int i = 0; i < value_[value].key.size(); i++){
+                if (value_[value].key[i] == key){
+                    return value_[value].member[i];
+                }
+            }
+            return -1;
+        }
+
+        // Elements of an array; other values have none
+        int Size(int value) const {
+            if (value < 0 || value_[value].kind != JsonValue::Array){
+                return 0;
+            }
+            return (int) value_[value].member.size();
+        }
+
+        int At(int value, int i) const {
+            if (i < 0 || i >= Size(value)){
+                return -1;
+            }
+            return value_[value].member[i];
+        }
+
+        double Number(int value, double fallback) const {
+            if (value < 0 || (value_[value].kind != JsonValue::Number && value_[value].kind != JsonValue::Bool)){
+                return fallback;
+            }
+            return value_[value].number;
+        }
+
+        int Integer(int value, int fallback) const {
+            return (int) Number(value, fallback);
+        }
+
+        std::string String(int value) const {
+            if (value < 0 || value_[value].kind != JsonValue::String){
+                return std::string();
+            }
+            return value_[value].string;
+        }
+
+    private:
+        std::vector<JsonValue> value_;
+        const char *p_;
+        const char *end_;
+
+        void SkipSpace(void){
+            while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')){
+                p_++;
+            }
+        }
+
+        bool Match(const char *word){
+            size_t length = strlen(word);
+            if ((size_t) (end_ - p_) < length || strncmp(p_, word, length) != 0){
+                return false;
+            }
+            p_ += length;
+            return true;
+        }
+
+        // Parse the value at p_ into a new entry; its index, or -1
+        int ParseValue(int depth){
+            SkipSpace();
+            if (p_ >= end_ || depth > max_json_depth){
+                return -1;
+            }
+            int index = (int) value_.size();
+            value_.push_back(JsonValue());
+            value_[index].kind = JsonValue::Null;
+            value_[index].number = 0.0;
+
+            char c = *p_;
+            if (c == '{'){
+                value_[index].kind = JsonValue::Object;
+                p_++;
+                SkipSpace();
+                if (p_ < end_ && *p_ == '}'){
+                    p_++;
+                    return index;
+                }
+                while (true){
+                    SkipSpace();
+                    std::string key;
+                    if (!ParseString(key)){
+                        return -1;
+                    }
+                    SkipSpace();
+                    if (p_ >= end_ || *p_ != ':'){
+                        return -1;
+                    }
+                    p_++;
+                    int member = ParseValue(depth + 1);
+                    if (member < 0){
+                        return -1;
+                    }
+                    value_[index].key.push_back(key);
+                    value_[index].member.push_back(member);
+                    SkipSpace();
+                    if (p_ < end_ && *p_ == ','){
+                        p_++;
+                    } else if (p_ < end_ && *p_ == '}'){
+                        p_++;
+                        return index;
+                    } else {
+                        return -1;
+                    }
+                }
+            } else if (c == '['){
+                value_[index].kind = JsonValue::Array;
+                p_++;
+                SkipSpace();
+                if (p_ < end_ && *p_ == ']'){
+                    p_++;
+                    return index;
+                }
+                while (true){
+                    int member = ParseValue(depth + 1);
+                    if (member < 0){
+                        return -1;
+                    }
+                    value_[index].member.push_back(member);
+                    SkipSpace();
+                    if (p_ < end_ && *p_ == ','){
+                        p_++;
+                    } else if (p_ < end_ && *p_ == ']'){
+                        p_++;
+                        return index;
+                    } else {
+                        return -1;
+                    }
+                }
+            } else if (c == '"'){
+                value_[index].kind = JsonValue::String;
+                std::string s;
+                if (!ParseString(s)){
+                    return -1;
+                }
+                value_[index].string = s;
+                return index;
+            } else if (Match("true")){
+                value_[index].kind = JsonValue::Bool;
+                value_[index].number = 1.0;
+                return index;
+            } else if (Match("false")){
+                value_[index].kind = JsonValue::Bool;
+                return index;
+            } else if (Match("null")){
+                return index;
+            }
+
+            // Number; copied out since the chunk is not terminated
+            char buffer[64];
+            int length = 0;
+            while (p_ < end_ && length < (int) sizeof(buffer) - 1 && (strchr("+-.eE", *p_) || (*p_ >= '0' && *p_ <= '9'))){
+                buffer[length++] = *p_++;
+            }
+            buffer[length] = '\0';
+            char *number_end;
+            value_[index].number = strtod(buffer, &number_end);
+            if (length == 0 || number_end != buffer + length){
+                return -1;
+            }
+            value_[index].kind = JsonValue::Number;
+            return index;
+        }
+
+        bool ParseString(std::string &s){
+            if (p_ >= end_ || *p_ != '"'){
+                return false;
+            }
+            p_++;
+            while (p_ < end_ && *p_ != '"'){
+                if (*p_ != '\\'){
+                    s += *p_++;
+                    continue;
+                }
+                p_++;
+                if (p_ >= end_){
+                    return false;
+                }
+                char c = *p_++;
+                if (c == 'n') s += '\n';
+                else if (c == 't') s += '\t';
+                else if (c == 'r') s += '\r';
+                else if (c == 'b') s += '\b';
+                else if (c == 'f') s += '\f';
+                else if (c == 'u'){
+                    // Code point as UTF-8; names are all glTF needs strings for
+                    if (end_ - p_ < 4){
+                        return false;
+                    }
+                    char hex[5] = { p_[0], p_[1], p_[2], p_[3], '\0' };
+                    unsigned long code = strtoul(hex, NULL, 16);
+                    p_ += 4;
+                    if (code < 0x80){
+                        s += (char) code;
+                    } else if (code < 0x800){
+                        s += (char) (0xC0 | (code >> 6));
+                        s += (char) (0x80 | (code & 0x3F));
+                    } else {
+                        s += (char) (0xE0 | (code >> 12));
+                        s += (char) (0x80 | ((code >> 6) & 0x3F));
+                        s += (char) (0x80 | (code & 0x3F));
+                    }
+                } else {
+                    s += c; // Quote, backslash and slash
+                }
+            }
+            if (p_ >= end_){
+                return false;
+            }
+            p_++;
+            return true;
+        }
+
+}; // class JsonDocument
+
+
+// Typed view of the binary chunk described by a glTF accessor
+struct Accessor {
+    size_t offset; // Bytes from the start of the binary chunk
+    GLsizei count;
+    GLenum type; // Component type
+    GLint components;
+    GLboolean normalized;
+    GLsizei stride; // Bytes between elements
+    size_t bytes; // Bytes from the first element to the end of the last
+    int json; // The accessor in the JSON chunk
+};
+
+
+static void GlbError(const char *filename, const std::string &message){
+
+    throw(std::ios_base::failure(std::string("Error in ") + std::string(filename) + ": " + message));
+}
+
+
+static GLsizei ComponentSize(GLenum type){
+
+    switch (type){
+        case GL_BYTE: case GL_UNSIGNED_BYTE: return 1;
+        case GL_SHORT: case GL_UNSIGNED_SHORT: return 2;
+        case GL_UNSIGNED_INT: case GL_FLOAT: return 4;
+        default: return 0;
+    }
+}
+
+
+static Accessor ReadAccessor(const JsonDocument &json, int index, const GlbFile &glb, const char *filename){
+
+    Accessor a;
+    a.json = json.At(json.Find(0, "accessors"), index);
+    if (a.json < 0){
+        GlbError(filename, "missing accessor");
+    }
+    if (json.Find(a.json, "sparse") >= 0){
+        GlbError(filename, "sparse accessors are not supported");
+    }
+    int view = json.At(json.Find(0, "bufferViews"), json.Integer(json.Find(a.json, "bufferView"), -1));
+    if (view < 0){
+        GlbError(filename, "accessors without a buffer view are not supported");
+    }
+    if (json.Integer(json.Find(view, "buffer"), 0) != 0){
+        GlbError(filename, "only the binary chunk is supported as a buffer");
+    }
+
+    std::string type = json.String(json.Find(a.json, "type"));
+    a.components = (type == "SCALAR") ? 1 : (type == "VEC2") ? 2 : (type == "VEC3") ? 3 : (type == "VEC4") ? 4 : 0;
+    a.type = json.Integer(json.Find(a.json, "componentType"), 0);
+    a.normalized = json.Number(json.Find(a.json, "normalized"), 0.0) != 0.0;
+    a.count = json.Integer(json.Find(a.json, "count"), 0);
+    GLsizei component_size = ComponentSize(a.type);
+    if (a.components == 0 || component_size == 0 || a.count <= 0){
+        GlbError(filename, "unsupported accessor type");
+    }
+
+    GLsizei element_size = a.components * component_size;
+    a.stride = json.Integer(json.Find(view, "byteStride"), element_size);
+    size_t view_offset = json.Integer(json.Find(view, "byteOffset"), 0);
+    size_t view_length = json.Integer(json.Find(view, "byteLength"), 0);
+    a.offset = view_offset + json.Integer(json.Find(a.json, "byteOffset"), 0);
+    a.bytes = (size_t) (a.count - 1) * a.stride + element_size;
+
+    // GL reads attributes at their natural alignment
+    if (a.stride < element_size || a.offset % component_size != 0 || a.stride % component_size != 0){
+        GlbError(filename, "misaligned accessor");
+    }
+    if (a.offset + a.bytes > view_offset + view_length || view_offset + view_length > glb.binary_size){
+        GlbError(filename, "accessor past the end of the binary chunk");
+    }
+    return a;
+}
+
+
+// One component of an element of an accessor, as a float
+static float ReadComponent(const GlbFile &glb, const Accessor &a, int element, int component){
+
+    const char *p = glb.binary + a.offset + (size_t) element * a.stride + component * ComponentSize(a.type);
+    switch (a.type){
+        case GL_FLOAT: { GLfloat v; memcpy(&v, p, sizeof(v)); return v; }
+        case GL_BYTE: { GLbyte v = *p; return a.normalized ? ((v < -127) ? -1.0f : v / 127.0f) : v; }
+        case GL_UNSIGNED_BYTE: { GLubyte v = *p; return a.normalized ? v / 255.0f : v; }
+        case GL_SHORT: { GLshort v; memcpy(&v, p, sizeof(v)); return a.normalized ? ((v < -32767) ? -1.0f : v / 32767.0f) : v; }
+        case GL_UNSIGNED_SHORT: { GLushort v; memcpy(&v, p, sizeof(v)); return a.normalized ? v / 65535.0f : v; }
+        default: { GLuint v; memcpy(&v, p, sizeof(v)); return (float) v; }
+    }
+}
+
+
+static glm::vec4 ReadElement(const GlbFile &glb, const Accessor &a, int element){
+
+    glm::vec4 v(0.0f);
+    for (int c = 0; c < a.components; c++){
+        v[c] = ReadComponent(glb, a, element, c);
+    }
+    return v;
+}
+
+
+static void ReadPrimitive(const JsonDocument &json, int primitive, GlbFile &glb, const char *filename, GlbPrimitive &prim){
+
+    if (json.Integer(json.Find(primitive, "mode"), GL_TRIANGLES) != GL_TRIANGLES){
+        GlbError(filename, "only triangle primitives are supported");
+    }
+
+    // Attributes the shaders read; others such as tangents and skin
+    // weights stay in the file but are not set up
+    static const char *attribute_name[VertexSemanticCount] = { "POSITION", "NORMAL", "COLOR_0", "TEXCOORD_0" };
+    int attributes = json.Find(primitive, "attributes");
+    Accessor accessor[VertexSemanticCount];
+    bool present[VertexSemanticCount];
+    for (int s = 0; s < VertexSemanticCount; s++){
+        int index = json.Integer(json.Find(attributes, attribute_name[s]), -1);
+        present[s] = (index >= 0);
+        if (present[s]){
+            accessor[s] = ReadAccessor(json, index, glb, filename);
+        }
+    }
+    const Accessor &position = accessor[VertexPosition];
+    if (!present[VertexPosition] || position.type != gltf_float || position.components != 3){
+        GlbError(filename, "primitive without float positions");
+    }
+
+    // One range holds every attribute, so the primitive is one buffer
+    prim.vertex_count = position.count;
+    prim.vertex_offset = position.offset;
+    size_t vertex_end = position.offset + position.bytes;
+    for (int s = 0; s < VertexSemanticCount; s++){
+        if (present[s]){
+            if (accessor[s].count != prim.vertex_count){
+                GlbError(filename, "attributes of a primitive differ in length");
+            }
+            prim.vertex_offset = (accessor[s].offset < prim.vertex_offset) ? accessor[s].offset : prim.vertex_offset;
+            vertex_end = (accessor[s].offset + accessor[s].bytes > vertex_end) ? accessor[s].offset + accessor[s].bytes : vertex_end;
+        }
+    }
+    prim.vertex_bytes = vertex_end - prim.vertex_offset;
+
+    VertexFormat &format = prim.format;
+    format.stride = position.stride;
+    format.attribute_count = 0;
+    format.pack = NULL;
+    format.unpack = NULL;
+    for (int s = 0; s < VertexSemanticCount; s++){
+        if (present[s]){
+            VertexAttribute &a = format.attribute[format.attribute_count++];
+            a.semantic = (VertexSemantic) s;
+            a.components = accessor[s].components;
+            a.type = accessor[s].type;
+            a.normalized = accessor[s].normalized;
+            a.offset = accessor[s].offset - prim.vertex_offset;
+            a.stride = accessor[s].stride;
+        }
+    }
+
+    // Position bounds are required by glTF, but are cheap to recompute
+    int min = json.Find(position.json, "min");
+    int max = json.Find(position.json, "max");
+    if (json.Size(min) == 3 && json.Size(max) == 3){
+        for (int k = 0; k < 3; k++){
+            prim.min[k] = (float) json.Number(json.At(min, k), 0.0);
+            prim.max[k] = (float) json.Number(json.At(max, k), 0.0);
+        }
+    } else {
+        prim.min = prim.max = glm::vec3(ReadElement(glb, position, 0));
+        for (int v = 1; v < position.count; v++){
+            glm::vec3 p = glm::vec3(ReadElement(glb, position, v));
+            prim.min = glm::min(prim.min, p);
+            prim.max = glm::max(prim.max, p);
+        }
+    }
+
+    int indices = json.Integer(json.Find(primitive, "indices"), -1);
+    prim.indexed = (indices >= 0);
+    if (!prim.indexed){
+        prim.index_offset = 0;
+        prim.index_count = prim.vertex_count;
+        prim.index_type = (prim.vertex_count <= 65536) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        return;
+    }
+    Accessor index = ReadAccessor(json, indices, glb, filename);
+    if (index.components != 1 || (index.type != GL_UNSIGNED_BYTE && index.type != GL_UNSIGNED_SHORT && index.type != GL_UNSIGNED_INT) ||
+        index.stride != ComponentSize(index.type)){
+        GlbError(filename, "unsupported index accessor");
+    }
+    prim.index_offset = index.offset;
+    prim.index_count = index.count;
+    prim.index_type = index.type;
+
+    // Indices past the vertices would read outside the buffer
+    for (int i = 0; i < index.count; i++){
+        if (ReadComponent(glb, index, i, 0) >= prim.vertex_count){
+            GlbError(filename, "index out of range");
+        }
+    }
+}
+
+
+// Copies of a mesh listed by EXT_mesh_gpu_instancing
+static void ReadInstances(const JsonDocument &json, int node, GlbFile &glb, const char *filename, GlbNode &n){
+
+    int attributes = json.Find(json.Find(json.Find(node, "extensions"), "EXT_mesh_gpu_instancing"), "attributes");
+    if (attributes < 0){
+        return;
+    }
+    static const char *name[3] = { "TRANSLATION", "ROTATION", "SCALE" };
+    int count = -1;
+    Accessor accessor[3];
+    bool present[3];
+    for (int k = 0; k < 3; k++){
+        int index = json.Integer(json.Find(attributes, name[k]), -1);
+        present[k] = (index >= 0);
+        if (present[k]){
+            accessor[k] = ReadAccessor(json, index, glb, filename);
+            if (accessor[k].components != ((k == 1) ? 4 : 3) || (count >= 0 && accessor[k].count != count)){
+                GlbError(filename, "malformed instances");
+            }
+            count = accessor[k].count;
+        }
+    }
+    for (int i = 0; i < count; i++){
+        n.instance_translation.push_back(present[0] ? glm::vec3(ReadElement(glb, accessor[0], i)) : glm::vec3(0.0f));
+        glm::vec4 r = present[1] ? ReadElement(glb, accessor[1], i) : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        n.instance_rotation.push_back(glm::quat(r.w, r.x, r.y, r.z));
+        n.instance_scale.push_back(present[2] ? glm::vec3(ReadElement(glb, accessor[2], i)) : glm::vec3(1.0f));
+    }
+}
+
+
+static void ReadNode(const JsonDocument &json, int node, GlbFile &glb, const char *filename, GlbNode &n){
+
+    n.name = json.String(json.Find(node, "name"));
+    n.mesh = json.Integer(json.Find(node, "mesh"), -1);
+    if (n.mesh >= (int) glb.mesh.size()){
+        GlbError(filename, "node refers to a missing mesh");
+    }
+    int children = json.Find(node, "children");
+    for (int i = 0; i < json.Size(children); i++){
+        n.child.push_back(json.Integer(json.At(children, i), -1));
+    }
+
+    n.translation = glm::vec3(0.0f);
+    n.rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    n.scale = glm::vec3(1.0f);
+    int matrix = json.Find(node, "matrix");
+    if (json.Size(matrix) == 16){
+        // Column-major matrix split into translation, rotation and scale;
+        // shear has no equivalent in a scene node and is lost
+        glm::mat4 m;
+        for (int i = 0; i < 16; i++){
+            m[i / 4][i % 4] = (float) json.Number(json.At(matrix, i), 0.0);
+        }
+        n.translation = glm::vec3(m[3]);
+        glm::mat3 r;
+        for (int k = 0; k < 3; k++){
+            n.scale[k] = glm::length(glm::vec3(m[k]));
+            r[k] = (n.scale[k] > 0.0f) ? glm::vec3(m[k]) / n.scale[k] : glm::vec3(0.0f);
+        }
+        if (glm::determinant(r) < 0.0f){
+            n.scale.x = -n.scale.x;
+            r[0] = -r[0];
+        }
+        n.rotation = glm::quat_cast(r);
+    } else {
+        int t = json.Find(node, "translation");
+        int r = json.Find(node, "rotation");
+        int s = json.Find(node, "scale");
+        for (int k = 0; k < 3; k++){
+            n.translation[k] = (float) json.Number(json.At(t, k), 0.0);
+            n.scale[k] = (float) json.Number(json.At(s, k), 1.0);
+        }
+        // glTF stores x, y, z, w
+        n.rotation = glm::quat((float) json.Number(json.At(r, 3), 1.0), (float) json.Number(json.At(r, 0), 0.0),
+                               (float) json.Number(json.At(r, 1), 0.0), (float) json.Number(json.At(r, 2), 0.0));
+    }
+
+    ReadInstances(json, node, glb, filename, n);
+}
+
+
+void LoadGlb(const char *filename, GlbFile &glb){
+
+    if (!glb.file.Open(filename)){
+        throw(std::ios_base::failure(std::string("Error opening file ")+std::string(filename)));
+    }
+    const char *data = glb.file.GetData();
+    size_t size = glb.file.GetSize();
+
+    // Header, then the JSON chunk and the optional binary chunk
+    GLuint header[3];
+    if (size < sizeof(header)){
+        GlbError(filename, "not a binary glTF file");
+    }
+    memcpy(header, data, sizeof(header));
+    if (header[0] != glb_magic || header[1] != 2 || header[2] > size){
+        GlbError(filename, "not a binary glTF 2.0 file");
+    }
+    size = header[2];
+    const char *json_text = NULL;
+    size_t json_size = 0;
+    glb.binary = NULL;
+    glb.binary_size = 0;
+    size_t offset = sizeof(header);
+    while (offset + 8 <= size){
+        GLuint chunk[2];
+        memcpy(chunk, data + offset, sizeof(chunk));
+        offset += sizeof(chunk);
+        if (chunk[0] > size - offset){
+            GlbError(filename, "chunk past the end of the file");
+        }
+        if (chunk[1] == glb_chunk_json && !json_text){
+            json_text = data + offset;
+            json_size = chunk[0];
+        } else if (chunk[1] == glb_chunk_binary && !glb.binary){
+            glb.binary = data + offset;
+            glb.binary_size = chunk[0];
+        }
+        offset += (chunk[0] + 3) & ~3;
+    }
+
+    JsonDocument json;
+    if (!json_text || !json.Parse(json_text, json_size)){
+        GlbError(filename, "malformed JSON chunk");
+    }
+    int buffer = json.At(json.Find(0, "buffers"), 0);
+    if (json.Size(json.Find(0, "buffers")) > 1 || json.Find(buffer, "uri") >= 0){
+        GlbError(filename, "external buffers are not supported");
+    }
+
+    int meshes = json.Find(0, "meshes");
+    glb.mesh.resize(json.Size(meshes));
+    for (int m = 0; m < glb.mesh.size(); m++){
+        int mesh = json.At(meshes, m);
+        glb.mesh[m].name = json.String(json.Find(mesh, "name"));
+        int primitives = json.Find(mesh, "primitives");
+        glb.mesh[m].primitive.resize(json.Size(primitives));
+        for (int p = 0; p < glb.mesh[m].primitive.size(); p++){
+            ReadPrimitive(json, json.At(primitives, p), glb, filename, glb.mesh[m].primitive[p]);
+        }
+    }
+
+    // Nodes form a forest: every node has at most one parent
+    int nodes = json.Find(0, "nodes");
+    glb.node.resize(json.Size(nodes));
+    std::vector<int> parent(glb.node.size(), -1);
+    for (int n = 0; n < glb.node.size(); n++){
+        ReadNode(json, json.At(nodes, n), glb, filename, glb.node[n]);
+        for (int i = 0; i < glb.node[n].child.size(); i++){
+            int child = glb.node[n].child[i];
+            if (child < 0 || child >= (int) glb.node.size() || parent[child] >= 0 || child == n){
+                GlbError(filename, "malformed node hierarchy");
+            }
+            parent[child] = n;
+        }
+    }
+
+    // Roots of the default scene, or every parentless node
+    int scenes = json.Find(0, "scenes");
+    int scene = json.At(scenes, json.Integer(json.Find(0, "scene"), 0));
+    glb.root.clear();
+    if (scene >= 0){
+        int roots = json.Find(scene, "nodes");
+        for (int i = 0; i < json.Size(roots); i++){
+            int root = json.Integer(json.At(roots, i), -1);
+            if (root < 0 || root >= (int) glb.node.size() || parent[root] >= 0){
+                GlbError(filename, "malformed scene");
+            }
+            glb.root.push_back(root);
+        }
+    } else {
+        for (int n = 0; n < glb.node.size(); n++){
+            if (parent[n] < 0){
+                glb.root.push_back(n);
+            }
+        }
+    }
+}
+
+} // namespace game;
@@ -0,0 +1,74 @@
+#ifndef GLB_LOADER_H_
+#define GLB_LOADER_H_
+
+#include <string>
+#include <vector>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/quaternion.hpp>
+
+#include "vertex_layout.h"
+#include "mapped_file.h"
+
+namespace game {
+
+// Draw call of a glTF mesh, as ranges of the binary chunk
+struct GlbPrimitive {
+    // Bytes of the binary chunk spanning every attribute, uploaded as is
+    size_t vertex_offset;
+    size_t vertex_bytes;
+    GLsizei vertex_count;
+    // Attributes at their offsets in that range, each with its own
+    // stride; pack and unpack are NULL since the layout is the file's
+    VertexFormat format;
+    // Indices, vertex_count of them in order if there is no index accessor
+    bool indexed;
+    size_t index_offset;
+    GLsizei index_count;
+    GLenum index_type; // GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    // Bounds of the positions, which glTF requires
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+struct GlbMesh {
+    std::string name;
+    std::vector<GlbPrimitive> primitive;
+};
+
+struct GlbNode {
+    std::string name;
+    int mesh; // Index in GlbFile::mesh, -1 for none
+    glm::vec3 translation;
+    glm::quat rotation;
+    glm::vec3 scale;
+    std::vector<int> child;
+    // Copies of the mesh from EXT_mesh_gpu_instancing, relative to the
+    // node; empty for a single copy
+    std::vector<glm::vec3> instance_translation;
+    std::vector<glm::quat> instance_rotation;
+    std::vector<glm::vec3> instance_scale;
+};
+
+// Contents of a binary glTF 2.0 file. binary points into the mapping of
+// file, so the data stays readable as long as the GlbFile exists
+struct GlbFile {
+    MappedFile file;
+    const char *binary; // Binary chunk
+    size_t binary_size;
+    std::vector<GlbMesh> mesh;
+    std::vector<GlbNode> node;
+    std::vector<int> root; // Nodes of the default scene
+};
+
+// Map a .glb file and read its meshes and node hierarchy. Vertex data is
+// left where it is in the binary chunk, described by ranges and formats.
+// Only triangle primitives in the binary chunk are supported; throws
+// std::ios_base::failure for anything else or a damaged file
+void LoadGlb(const char *filename, GlbFile &glb);
+
+} // namespace game;
+
+#endif // GLB_LOADER_H_
@@ -0,0 +1,311 @@
+#include <math.h>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "impostor_field.h"
+#include "scene_graph.h"
+#include "scene_node.h"
+#include "bvh.h"
+
+namespace game {
+
+// Elevation of the top and bottom rows of views, in radians
+static const float max_view_elevation = glm::pi<float>() / 3.0f;
+
+ImpostorField::ImpostorField(void){
+
+    geometry_ = NULL;
+    texture_ = 0;
+    mesh_program_ = 0;
+    impostor_program_ = 0;
+    distance_ = 1000.0f;
+    lod_threshold_ = 0.0f;
+    frame_buffer_ = 0;
+    atlas_ = 0;
+    depth_buffer_ = 0;
+    columns_ = 1;
+    rows_ = 1;
+    elevation_range_ = 0.0f;
+    memory_used_ = 0;
+    quad_buffer_ = 0;
+    instance_buffer_ = 0;
+    mesh_count_ = 0;
+    impostor_count_ = 0;
+}
+
+
+ImpostorField::~ImpostorField(){
+}
+
+
+void ImpostorField::Bake(const Resource *geometry, const Resource *material, const Resource *texture, int columns, int rows, GLsizei cell_size){
+
+    geometry_ = geometry;
+    texture_ = texture ? texture->GetResource() : 0;
+    columns_ = columns;
+    rows_ = rows;
+    elevation_range_ = (rows > 1) ? max_view_elevation : 0.0f;
+
+    SceneGraph::CreateRenderTarget(columns * cell_size, rows * cell_size, GL_RGBA, frame_buffer_, atlas_, depth_buffer_);
+    // Four bytes per texel, a third more for the mipmaps, and four per
+    // depth sample
+    size_t texels = (size_t) columns * cell_size * rows * cell_size;
+    memory_used_ = texels * 4 * 4 / 3 + texels * 4;
+
+    // The mesh sits at the origin, centered on its bounding sphere
+    glm::vec3 center(0.0f);
+    float radius = 1.0f;
+    if (geometry->HasBounds()){
+        center = geometry->GetBoundsCenter();
+        radius = geometry->GetBoundsRadius();
+    }
+    SceneNode node("ImpostorBake", geometry, material, texture);
+    node.SetPosition(-center);
+
+    // Far enough for an almost orthographic view, with the bounding sphere
+    // touching the edges of its cell
+    float camera_distance = 10.0f * radius;
+    float fov = 2.0f * asin(radius / camera_distance) * 180.0f / glm::pi<float>();
+
+    // Save current viewport
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    // Uncovered texels keep a zero alpha
+    glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer_);
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_DEPTH_TEST);
+
+    Camera view;
+    for (int row = 0; row < rows; row++){
+        float elevation = (rows > 1) ? -elevation_range_ + 2.0f * elevation_range_ * row / (rows - 1) : 0.0f;
+        for (int column = 0; column < columns; column++){
+            float azimuth = 2.0f * glm::pi<float>() * column / columns;
+            glm::vec3 direction(cos(elevation) * cos(azimuth), sin(elevation), cos(elevation) * sin(azimuth));
+            view.SetView(direction * camera_distance, glm::vec3(0.0, 0.0, 0.0), glm::vec3(0.0, 1.0, 0.0));
+            view.SetProjection(fov, camera_distance - 1.5f * radius, camera_distance + 1.5f * radius, 1.0, 1.0);
+
+            glViewport(column * cell_size, row * cell_size, cell_size, cell_size);
+            node.Draw(&view);
+        }
+    }
+
+    // Reset frame buffer and viewport
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+    // Distant impostors are a few pixels wide
+    glBindTexture(GL_TEXTURE_2D, atlas_);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Quad drawn as a triangle strip
+    static const GLfloat quad_corner[] = {
+        -1.0f, -1.0f,
+         1.0f, -1.0f,
+        -1.0f,  1.0f,
+         1.0f,  1.0f
+    };
+    if (!quad_buffer_){
+        glGenBuffers(1, &quad_buffer_);
+        glGenBuffers(1, &instance_buffer_);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, quad_buffer_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad_corner), quad_corner, GL_STATIC_DRAW);
+}
+
+
+void ImpostorField::SetPrograms(GLuint mesh_program, GLuint impostor_program){
+
+    mesh_program_ = mesh_program;
+    impostor_program_ = impostor_program;
+}
+
+
+void ImpostorField::SetDistance(float distance){
+
+    distance_ = distance;
+}
+
+
+void ImpostorField::SetLodThreshold(float threshold){
+
+    lod_threshold_ = threshold;
+}
+
+
+void ImpostorField::AddInstance(const glm::vec3 &position, float scale){
+
+    instance_.push_back(glm::vec4(position, scale));
+}
+
+
+int ImpostorField::GetInstanceCount(void) const {
+
+    return (int) instance_.size();
+}
+
+
+void ImpostorField::Draw(Camera *camera){
+
+    mesh_count_ = 0;
+    impostor_count_ = 0;
+    if (!geometry_ || instance_.size() == 0){
+        return;
+    }
+
+    Frustum frustum;
+    frustum.SetFromMatrix(camera->GetProjectionMatrix() * camera->GetViewMatrix());
+    glm::vec3 eye = camera->GetPosition();
+    float projection_scale = camera->GetProjectionMatrix()[1][1];
+
+    glm::vec3 bounds_center(0.0f);
+    float bounds_radius = 1.0f;
+    if (geometry_->HasBounds()){
+        bounds_center = geometry_->GetBoundsCenter();
+        bounds_radius = geometry_->GetBoundsRadius();
+    }
+
+    // Sort the instances in view by how they are drawn
+    int level_count = geometry_->GetLodCount();
+    mesh_.resize(level_count);
+    for (int level = 0; level < level_count; level++){
+        mesh_[level].clear();
+    }
+    impostor_.clear();
+    for (int i = 0; i < instance_.size(); i++){
+        const glm::vec4 &instance = instance_[i];
+        glm::vec3 center = glm::vec3(instance) + bounds_center * instance.w;
+        float radius = bounds_radius * instance.w;
+
+        bool inside = true;
+        for (int p = 0; p < 6; p++){
+            if (glm::dot(glm::vec3(frustum.plane[p]), center) + frustum.plane[p].w < -radius){
+                inside = false;
+                break;
+            }
+        }
+        if (!inside){
+            continue;
+        }
+
+        float distance = glm::length(center - eye);
+        if (distance > distance_){
+            impostor_.push_back(instance);
+            continue;
+        }
+        int level = 0;
+        if (lod_threshold_ > 0.0f && distance > radius){
+            float fraction = radius * projection_scale / (distance - radius);
+            level = SceneNode::LodLevelFor(fraction, lod_threshold_, level_count);
+        }
+        mesh_[level].push_back(instance);
+    }
+
+    // One upload for the frame, meshes first in level order
+    draw_.clear();
+    for (int level = 0; level < level_count; level++){
+        draw_.insert(draw_.end(), mesh_[level].begin(), mesh_[level].end());
+    }
+    mesh_count_ = (int) draw_.size();
+    draw_.insert(draw_.end(), impostor_.begin(), impostor_.end());
+    impostor_count_ = (int) impostor_.size();
+    if (draw_.size() == 0){
+        return;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+    glBufferData(GL_ARRAY_BUFFER, draw_.size() * sizeof(glm::vec4), &draw_[0], GL_STREAM_DRAW);
+
+    // Close instances: one instanced draw per level of detail
+    GLsizei first = 0;
+    if (mesh_count_ > 0){
+        glUseProgram(mesh_program_);
+        camera->SetupShader(mesh_program_);
+        SceneNode::SetupMaterial(mesh_program_, texture_);
+        for (int level = 0; level < level_count; level++){
+            GLsizei count = (GLsizei) mesh_[level].size();
+            if (count == 0){
+                continue;
+            }
+            const Resource *lod = geometry_->GetLod(level);
+            glBindBuffer(GL_ARRAY_BUFFER, lod->GetArrayBuffer());
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lod->GetElementArrayBuffer());
+            lod->GetVertexFormat().SetupAttributes(mesh_program_);
+            SetupInstanceAttribute(mesh_program_, first);
+            glDrawElementsInstanced(GL_TRIANGLES, lod->GetSize(), lod->GetIndexType(), 0, count);
+            first += count;
+        }
+        ResetInstanceAttribute(mesh_program_);
+    }
+
+    // Distant instances: every impostor in one call
+    if (impostor_count_ > 0){
+        glUseProgram(impostor_program_);
+        camera->SetupShader(impostor_program_);
+
+        GLint bounds_var = glGetUniformLocation(impostor_program_, "bounds");
+        glUniform4f(bounds_var, bounds_center.x, bounds_center.y, bounds_center.z, bounds_radius);
+        GLint atlas_size_var = glGetUniformLocation(impostor_program_, "atlas_size");
+        glUniform2f(atlas_size_var, (float) columns_, (float) rows_);
+        GLint elevation_var = glGetUniformLocation(impostor_program_, "elevation_range");
+        glUniform1f(elevation_var, elevation_range_);
+
+        GLint tex = glGetUniformLocation(impostor_program_, "texture_map");
+        glUniform1i(tex, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, atlas_);
+
+        glBindBuffer(GL_ARRAY_BUFFER, quad_buffer_);
+        GLint corner_att = glGetAttribLocation(impostor_program_, "corner");
+        glVertexAttribPointer(corner_att, 2, GL_FLOAT, GL_FALSE, 2*sizeof(GLfloat), 0);
+        glEnableVertexAttribArray(corner_att);
+
+        SetupInstanceAttribute(impostor_program_, first);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, impostor_count_);
+        ResetInstanceAttribute(impostor_program_);
+    }
+}
+
+
+int ImpostorField::GetMeshCount(void) const {
+
+    return mesh_count_;
+}
+
+
+int ImpostorField::GetImpostorCount(void) const {
+
+    return impostor_count_;
+}
+
+
+size_t ImpostorField::GetMemoryUsed(void) const {
+
+    return memory_used_;
+}
+
+
+void ImpostorField::SetupInstanceAttribute(GLuint program, GLsizei first){
+
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+    GLint instance_att = glGetAttribLocation(program, "instance");
+    glVertexAttribPointer(instance_att, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void *) (first * sizeof(glm::vec4)));
+    glVertexAttribDivisor(instance_att, 1);
+    glEnableVertexAttribArray(instance_att);
+}
+
+
+void ImpostorField::ResetInstanceAttribute(GLuint program){
+
+    // Other programs may use the same attribute index per vertex
+    GLint instance_att = glGetAttribLocation(program, "instance");
+    glVertexAttribDivisor(instance_att, 0);
+    glDisableVertexAttribArray(instance_att);
+}
+
+} // namespace game
@@ -0,0 +1,93 @@
+#ifndef IMPOSTOR_FIELD_H_
+#define IMPOSTOR_FIELD_H_
+
+#include <vector>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "resource.h"
+#include "camera.h"
+
+namespace game {
+
+    // Many copies of one mesh drawn with instancing, as camera-facing
+    // impostors once they are far away
+    //
+    // The mesh is rendered offscreen from a grid of view directions into an
+    // atlas at startup. Each frame, instances in view closer than the
+    // impostor distance are drawn as the mesh, one instanced call per level
+    // of detail, and the others as quads textured with the atlas view
+    // closest to the direction of the camera, in a single instanced call
+    class ImpostorField {
+
+        public:
+            ImpostorField(void);
+            ~ImpostorField();
+
+            // Render views of a mesh into the impostor atlas; columns views
+            // around the vertical axis times rows elevations, each
+            // cell_size pixels wide. Call once the context exists
+            void Bake(const Resource *geometry, const Resource *material, const Resource *texture, int columns = 8, int rows = 4, GLsizei cell_size = 128);
+
+            // Programs drawing the instanced mesh and the impostors
+            void SetPrograms(GLuint mesh_program, GLuint impostor_program);
+            // Instances farther than this from the camera are impostors
+            void SetDistance(float distance);
+            // Screen height fraction below which closer instances use
+            // coarser levels of detail, 0 to always use the full mesh
+            void SetLodThreshold(float threshold);
+
+            // Add a copy of the mesh, uniformly scaled
+            void AddInstance(const glm::vec3 &position, float scale);
+            int GetInstanceCount(void) const;
+
+            // Draw the instances in view of the camera
+            void Draw(Camera *camera);
+
+            // Instances drawn by the last call to Draw
+            int GetMeshCount(void) const;
+            int GetImpostorCount(void) const;
+            // Bytes of the atlas, with its mipmaps, and of its depth buffer
+            size_t GetMemoryUsed(void) const;
+
+        private:
+            const Resource *geometry_; // Mesh and its levels of detail
+            GLuint texture_; // Texture of the mesh
+            GLuint mesh_program_;
+            GLuint impostor_program_;
+            float distance_;
+            float lod_threshold_;
+
+            // Atlas of views of the mesh
+            GLuint frame_buffer_;
+            GLuint atlas_;
+            GLuint depth_buffer_;
+            int columns_; // Views around the vertical axis
+            int rows_; // Elevations of the views
+            float elevation_range_; // Elevation of the top and bottom rows, in radians
+            size_t memory_used_; // Atlas and depth buffer
+
+            GLuint quad_buffer_; // Corners of the impostor quad
+            GLuint instance_buffer_; // Per-frame instances, meshes first
+            std::vector<glm::vec4> instance_; // Position and scale of every instance
+
+            // Scratch lists of the instances in view
+            std::vector<std::vector<glm::vec4> > mesh_; // Per level of detail
+            std::vector<glm::vec4> impostor_;
+            std::vector<glm::vec4> draw_; // Everything, in upload order
+
+            int mesh_count_;
+            int impostor_count_;
+
+            // Point the instance attribute of a program at an offset of
+            // the instance buffer
+            void SetupInstanceAttribute(GLuint program, GLsizei first);
+            // Stop reading the instance attribute per instance
+            void ResetInstanceAttribute(GLuint program);
+
+    }; // class ImpostorField
+
+} // namespace game
+
+#endif // IMPOSTOR_FIELD_H_
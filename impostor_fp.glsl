@@ -0,0 +1,21 @@
+#version 140
+
+// Attributes passed from the vertex shader
+in vec2 uv_interp;
+
+// Uniform (global) buffer
+uniform sampler2D texture_map;
+
+
+void main() 
+{
+    vec4 pixel = texture(texture_map, uv_interp);
+
+    // The atlas is cleared to a zero alpha, while the lit shaders always
+    // leave at least their ambient term where the mesh was drawn
+    if (pixel.a < 0.1) {
+        discard;
+    }
+
+    gl_FragColor = vec4(pixel.rgb, 1.0);
+}
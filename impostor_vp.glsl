@@ -0,0 +1,51 @@
+#version 140
+
+// Vertex buffer: corner of the quad, from -1 to 1
+in vec2 corner;
+// Per instance: position and uniform scale
+in vec4 instance;
+
+// Uniform (global) buffer
+uniform mat4 view_mat;
+uniform mat4 projection_mat;
+uniform vec4 bounds; // Bounding sphere of the mesh: center and radius
+uniform vec2 atlas_size; // Views around the vertical axis, and elevations
+uniform float elevation_range; // Elevation of the top and bottom rows of views
+
+// Attributes forwarded to the fragment shader
+out vec2 uv_interp;
+
+const float pi = 3.1415926536;
+
+
+void main()
+{
+    vec3 center = instance.xyz + bounds.xyz * instance.w;
+    float radius = bounds.w * instance.w;
+
+    // Camera position, from the inverse of the view matrix
+    vec3 eye = -transpose(mat3(view_mat)) * view_mat[3].xyz;
+    vec3 to_eye = normalize(eye - center);
+
+    // Face the camera, keeping the up direction the views were baked with
+    vec3 side = cross(vec3(0.0, 1.0, 0.0), to_eye);
+    if (dot(side, side) < 1e-6) {
+        side = vec3(1.0, 0.0, 0.0);
+    }
+    side = normalize(side);
+    vec3 up = cross(to_eye, side);
+
+    vec3 position = center + (side * corner.x + up * corner.y) * radius;
+    gl_Position = projection_mat * view_mat * vec4(position, 1.0);
+
+    // Cell of the atlas baked closest to the direction of the camera
+    float azimuth = atan(to_eye.z, to_eye.x);
+    float column = mod(floor(azimuth / (2.0 * pi) * atlas_size.x + 0.5), atlas_size.x);
+    float row = 0.0;
+    if (atlas_size.y > 1.0) {
+        float elevation = asin(clamp(to_eye.y, -1.0, 1.0));
+        row = floor((elevation + elevation_range) / (2.0 * elevation_range) * (atlas_size.y - 1.0) + 0.5);
+        row = clamp(row, 0.0, atlas_size.y - 1.0);
+    }
+    uv_interp = (vec2(column, row) + corner * 0.5 + 0.5) / atlas_size;
+}
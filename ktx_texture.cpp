@@ -0,0 +1,120 @@
+#include <string.h>
+#include <fstream>
+#include <stdexcept>
+
+#include "ktx_texture.h"
+
+namespace game {
+
+// First bytes of every KTX 1.1 file
+static const unsigned char ktx_identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+// Written by the writer of the file as a native word
+static const GLuint ktx_endianness = 0x04030201;
+
+// Header following the identifier
+struct KtxHeader {
+    GLuint endianness;
+    GLuint gl_type;
+    GLuint gl_type_size;
+    GLuint gl_format;
+    GLuint gl_internal_format;
+    GLuint gl_base_internal_format;
+    GLuint pixel_width;
+    GLuint pixel_height;
+    GLuint pixel_depth;
+    GLuint array_elements;
+    GLuint faces;
+    GLuint mip_levels;
+    GLuint key_value_bytes;
+};
+
+
+static void KtxError(const char *filename, const char *message){
+
+    throw(std::ios_base::failure(std::string("Error in ") + std::string(filename) + ": " + message));
+}
+
+
+void ReadKtx(const char *filename, const char *data, size_t size, KtxTexture &ktx){
+
+    if (size < sizeof(ktx_identifier) + sizeof(KtxHeader) || memcmp(data, ktx_identifier, sizeof(ktx_identifier)) != 0){
+        KtxError(filename, "not a KTX 1.1 file");
+    }
+    KtxHeader header;
+    memcpy(&header, data + sizeof(ktx_identifier), sizeof(header));
+    if (header.endianness != ktx_endianness){
+        KtxError(filename, "byte order of another machine");
+    }
+    if (header.pixel_width == 0 || header.pixel_height == 0 || header.pixel_depth > 1 || header.array_elements > 0 || header.faces != 1){
+        KtxError(filename, "not a 2D texture");
+    }
+
+    ktx.compressed = header.gl_type == 0;
+    ktx.internal_format = header.gl_internal_format;
+    ktx.format = header.gl_format;
+    ktx.type = header.gl_type;
+    ktx.level.clear();
+
+    // No levels asks the loader to generate them; it gets the first one
+    size_t offset = sizeof(ktx_identifier) + sizeof(KtxHeader) + header.key_value_bytes;
+    GLuint level_count = header.mip_levels ? header.mip_levels : 1;
+    GLsizei width = header.pixel_width;
+    GLsizei height = header.pixel_height;
+    for (GLuint i = 0; i < level_count; i++){
+        GLuint image_size;
+        if (offset > size || size - offset < sizeof(image_size)){
+            KtxError(filename, "truncated mip level");
+        }
+        memcpy(&image_size, data + offset, sizeof(image_size));
+        offset += sizeof(image_size);
+        if (size - offset < image_size){
+            KtxError(filename, "truncated mip level");
+        }
+        KtxLevel level = { width, height, data + offset, image_size };
+        ktx.level.push_back(level);
+        // Levels are padded to 4 bytes
+        offset += (image_size + 3) & ~3;
+        width = (width > 1) ? width / 2 : 1;
+        height = (height > 1) ? height / 2 : 1;
+    }
+}
+
+
+void WriteKtx(const std::string filename, GLenum internal_format, GLenum base_format, GLsizei width, GLsizei height, const std::vector<std::vector<unsigned char> > &level){
+
+    KtxHeader header;
+    header.endianness = ktx_endianness;
+    header.gl_type = 0;
+    header.gl_type_size = 1;
+    header.gl_format = 0;
+    header.gl_internal_format = internal_format;
+    header.gl_base_internal_format = base_format;
+    header.pixel_width = width;
+    header.pixel_height = height;
+    header.pixel_depth = 0;
+    header.array_elements = 0;
+    header.faces = 1;
+    header.mip_levels = level.size();
+    header.key_value_bytes = 0;
+
+    std::ofstream out(filename.c_str(), std::ios::binary);
+    if (!out){
+        throw(std::ios_base::failure(std::string("Error opening file ")+filename));
+    }
+    out.write((const char *) ktx_identifier, sizeof(ktx_identifier));
+    out.write((const char *) &header, sizeof(header));
+    static const char padding[3] = { 0 };
+    for (int i = 0; i < level.size(); i++){
+        GLuint image_size = level[i].size();
+        out.write((const char *) &image_size, sizeof(image_size));
+        if (image_size > 0){
+            out.write((const char *) &level[i][0], image_size);
+        }
+        out.write(padding, ((image_size + 3) & ~3) - image_size);
+    }
+    if (!out){
+        throw(std::ios_base::failure(std::string("Error writing file ")+filename));
+    }
+}
+
+} // namespace game
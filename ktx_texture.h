@@ -0,0 +1,42 @@
+#ifndef KTX_TEXTURE_H_
+#define KTX_TEXTURE_H_
+
+#include <string>
+#include <vector>
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+namespace game {
+
+// Mip level of a KTX texture, pointing into the file data
+struct KtxLevel {
+    GLsizei width;
+    GLsizei height;
+    const char *data;
+    size_t size;
+};
+
+// 2D texture in a KTX 1.1 file, with the OpenGL enums the file stores
+struct KtxTexture {
+    bool compressed; // Upload with glCompressedTexImage2D
+    GLenum internal_format;
+    GLenum format; // 0 if compressed
+    GLenum type; // 0 if compressed
+    std::vector<KtxLevel> level; // Full size first
+};
+
+// Read the header and mip levels of a KTX 1.1 file in memory, named
+// filename in errors; the levels point into data. Only 2D textures,
+// without faces or array layers, in the byte order of this machine are
+// supported; throws std::ios_base::failure for anything else or a
+// damaged file
+void ReadKtx(const char *filename, const char *data, size_t size, KtxTexture &ktx);
+
+// Write a compressed 2D texture as a KTX 1.1 file, one buffer per mip
+// level starting with the full width and height; throws
+// std::ios_base::failure if the file cannot be written
+void WriteKtx(const std::string filename, GLenum internal_format, GLenum base_format, GLsizei width, GLsizei height, const std::vector<std::vector<unsigned char> > &level);
+
+} // namespace game;
+
+#endif // KTX_TEXTURE_H_
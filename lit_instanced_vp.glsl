@@ -0,0 +1,42 @@
+#version 140
+
+// Vertex buffer
+in vec3 vertex;
+in vec3 normal;
+in vec3 color;
+in vec2 uv;
+// Per instance: position and uniform scale
+in vec4 instance;
+
+// Uniform (global) buffer
+uniform mat4 view_mat;
+uniform mat4 projection_mat;
+
+// Attributes forwarded to the fragment shader
+out vec3 position_interp;
+out vec3 normal_interp;
+out vec4 color_interp;
+out vec2 uv_interp;
+out vec3 light_pos;
+
+// Material attributes (constants)
+uniform vec3 light_position = vec3(50.5, -0.5, -5005.5);
+
+
+void main()
+{
+    vec4 world_position = vec4(instance.xyz + vertex * instance.w, 1.0);
+
+    gl_Position = projection_mat * view_mat * world_position;
+
+    position_interp = vec3(view_mat * world_position);
+
+    // Instances are only translated and uniformly scaled
+    normal_interp = normal;
+
+    color_interp = vec4(color, 1.0);
+
+    uv_interp = uv;
+
+    light_pos = vec3(view_mat * vec4(light_position, 1.0));
+}
@@ -0,0 +1,52 @@
+#version 430
+
+// Vertex buffer
+in vec3 vertex;
+in vec3 normal;
+in vec3 color;
+in vec2 uv;
+// Index of the draw, instanced and offset by the base instance of each
+// indirect command
+in uint draw_id;
+
+// Per-draw transformations, one entry per indirect command
+struct DrawData {
+    mat4 world_mat;
+    mat4 normal_mat;
+};
+layout(std430, binding = 0) readonly buffer DrawBuffer {
+    DrawData draw_data[];
+};
+
+// Uniform (global) buffer
+uniform mat4 view_mat;
+uniform mat4 projection_mat;
+
+// Attributes forwarded to the fragment shader
+out vec3 position_interp;
+out vec3 normal_interp;
+out vec4 color_interp;
+out vec2 uv_interp;
+out vec3 light_pos;
+
+// Material attributes (constants)
+uniform vec3 light_position = vec3(50.5, -0.5, -5005.5);
+
+
+void main()
+{
+    mat4 world_mat = draw_data[draw_id].world_mat;
+    mat4 normal_mat = draw_data[draw_id].normal_mat;
+
+    gl_Position = projection_mat * view_mat * world_mat * vec4(vertex, 1.0);
+
+    position_interp = vec3(view_mat * world_mat * vec4(vertex, 1.0));
+    
+    normal_interp = vec3(normal_mat * vec4(normal, 0.0));
+
+    color_interp = vec4(color, 1.0);
+
+    uv_interp = uv;
+
+    light_pos = vec3(view_mat * vec4(light_position, 1.0));
+}
@@ -27,10 +27,10 @@ int main(int argc, char** argv){
         // Initialize game
         app.Init();
 
-        // Set up the main resources and scene in the game
-        app.SetupResources();
-        
-        app.SetupScene();
+        // Queue the loading of the main resources and scene in the game,
+        // which the main loop runs behind the title screen
+        app.Setup();
+
         // Run game
         app.MainLoop();
     }
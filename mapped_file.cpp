@@ -0,0 +1,128 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.h"
+
+namespace game {
+
+MappedFile::MappedFile(void){
+
+    data_ = NULL;
+    size_ = 0;
+#ifdef _WIN32
+    file_ = INVALID_HANDLE_VALUE;
+    mapping_ = NULL;
+#else
+    file_ = -1;
+#endif
+}
+
+
+MappedFile::~MappedFile(){
+
+    Close();
+}
+
+
+bool MappedFile::Open(const char *filename){
+
+    Close();
+
+#ifdef _WIN32
+    file_ = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file_ == INVALID_HANDLE_VALUE){
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size)){
+        Close();
+        return false;
+    }
+    size_ = (size_t) size.QuadPart;
+    if (size_ == 0){
+        return true; // Empty files cannot be mapped
+    }
+    mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping_){
+        Close();
+        return false;
+    }
+    data_ = (const char *) MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+#else
+    file_ = open(filename, O_RDONLY);
+    if (file_ < 0){
+        return false;
+    }
+    struct stat info;
+    if (fstat(file_, &info) != 0){
+        Close();
+        return false;
+    }
+    size_ = (size_t) info.st_size;
+    if (size_ == 0){
+        return true; // Empty files cannot be mapped
+    }
+    void *data = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, file_, 0);
+    data_ = (data == MAP_FAILED) ? NULL : (const char *) data;
+    if (data_){
+        // Files are mostly read front to back
+        madvise(data, size_, MADV_SEQUENTIAL);
+    }
+#endif
+
+    if (!data_){
+        Close();
+        return false;
+    }
+    return true;
+}
+
+
+void MappedFile::Close(void){
+
+#ifdef _WIN32
+    if (data_){
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_){
+        CloseHandle(mapping_);
+    }
+    if (file_ != INVALID_HANDLE_VALUE){
+        CloseHandle(file_);
+    }
+    file_ = INVALID_HANDLE_VALUE;
+    mapping_ = NULL;
+#else
+    if (data_){
+        munmap((void *) data_, size_);
+    }
+    if (file_ >= 0){
+        close(file_);
+    }
+    file_ = -1;
+#endif
+    data_ = NULL;
+    size_ = 0;
+}
+
+
+const char *MappedFile::GetData(void) const {
+
+    return data_;
+}
+
+
+size_t MappedFile::GetSize(void) const {
+
+    return size_;
+}
+
+} // namespace game
@@ -0,0 +1,45 @@
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <stddef.h>
+
+namespace game {
+
+    // Read-only view of a whole file mapped into memory
+    //
+    // Pages are read by the system on first access, so nothing is copied
+    // until the data is used, and unused parts of a file cost nothing
+    class MappedFile {
+
+        public:
+            MappedFile(void);
+            ~MappedFile();
+
+            // Map a file, unmapping any previous one; returns false if it
+            // cannot be opened
+            bool Open(const char *filename);
+            void Close(void);
+
+            // Contents of the file; NULL when empty or not open
+            const char *GetData(void) const;
+            size_t GetSize(void) const;
+
+        private:
+            const char *data_;
+            size_t size_;
+#ifdef _WIN32
+            void *file_; // Handles of the file and of its mapping
+            void *mapping_;
+#else
+            int file_; // Descriptor of the file
+#endif
+
+            // Not copyable: the mapping has a single owner
+            MappedFile(const MappedFile &);
+            MappedFile &operator=(const MappedFile &);
+
+    }; // class MappedFile
+
+} // namespace game
+
+#endif // MAPPED_FILE_H_
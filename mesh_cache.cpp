@@ -0,0 +1,205 @@
+#include <vector>
+#include <fstream>
+#include <string.h>
+
+#include "mesh_cache.h"
+
+namespace game {
+
+// Bump when the format or a mesh generator changes
+static const GLuint mesh_cache_version = 1;
+
+// Blobs start on multiples of this many bytes
+static const GLuint blob_alignment = 16;
+
+
+static GLuint Align(GLuint offset){
+
+    return (offset + blob_alignment - 1) / blob_alignment * blob_alignment;
+}
+
+
+static GLuint IndexSize(GLenum index_type){
+
+    return (index_type == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+
+MeshCache::MeshCache(void){
+
+    header_ = NULL;
+    level_ = NULL;
+}
+
+
+MeshCache::~MeshCache(){
+}
+
+
+bool MeshCache::Write(const std::string &path, const std::string &key, unsigned long long source_time, unsigned long long source_size, const Resource *mesh){
+
+    const VertexFormat &format = mesh->GetVertexFormat();
+
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "MSHC", 4);
+    header.version = mesh_cache_version;
+    header.key_length = key.size();
+    header.level_count = mesh->GetLodCount();
+    header.source_time = source_time;
+    header.source_size = source_size;
+    header.stride = format.stride;
+    header.attribute_count = format.attribute_count;
+    for (int i = 0; i < format.attribute_count; i++){
+        header.attribute[i][0] = format.attribute[i].semantic;
+        header.attribute[i][1] = format.attribute[i].components;
+        header.attribute[i][2] = format.attribute[i].type;
+        header.attribute[i][3] = format.attribute[i].normalized;
+    }
+
+    // Read every level back from the GPU and lay out the blobs
+    std::vector<MeshCacheLevel> level(header.level_count);
+    std::vector<std::vector<char> > vertex(header.level_count);
+    std::vector<std::vector<char> > index(header.level_count);
+    GLuint offset = sizeof(header) + header.key_length + header.level_count * sizeof(MeshCacheLevel);
+    for (int l = 0; l < level.size(); l++){
+        const Resource *lod = mesh->GetLod(l);
+        if (&lod->GetVertexFormat() != &format || lod->GetElementArrayBuffer() == 0 || !lod->HasBounds()){
+            return false;
+        }
+
+        GLint vertex_bytes;
+        glBindBuffer(GL_ARRAY_BUFFER, lod->GetArrayBuffer());
+        glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &vertex_bytes);
+        vertex[l].resize(vertex_bytes);
+        index[l].resize(lod->GetSize() * IndexSize(lod->GetIndexType()));
+        if (vertex[l].size() == 0 || index[l].size() == 0){
+            return false;
+        }
+        glGetBufferSubData(GL_ARRAY_BUFFER, 0, vertex[l].size(), &vertex[l][0]);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lod->GetElementArrayBuffer());
+        glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, index[l].size(), &index[l][0]);
+
+        MeshCacheLevel &info = level[l];
+        offset = Align(offset);
+        info.vertex_offset = offset;
+        info.vertex_bytes = vertex[l].size();
+        offset = Align(offset + info.vertex_bytes);
+        info.index_offset = offset;
+        info.index_count = lod->GetSize();
+        info.index_type = lod->GetIndexType();
+        offset += index[l].size();
+
+        glm::vec3 bounds[3] = { lod->GetBoundsMin(), lod->GetBoundsMax(), lod->GetBoundsCenter() };
+        for (int i = 0; i < 3; i++){
+            for (int k = 0; k < 3; k++){
+                info.bounds[i*3 + k] = bounds[i][k];
+            }
+        }
+        info.bounds[9] = lod->GetBoundsRadius();
+    }
+
+    std::ofstream file(path.c_str(), std::ios::binary);
+    if (!file){
+        return false;
+    }
+    file.write((const char *) &header, sizeof(header));
+    file.write(key.c_str(), key.size());
+    file.write((const char *) &level[0], level.size() * sizeof(MeshCacheLevel));
+    static const char padding[blob_alignment] = { 0 };
+    GLuint position = sizeof(header) + header.key_length + header.level_count * sizeof(MeshCacheLevel);
+    for (int l = 0; l < level.size(); l++){
+        file.write(padding, level[l].vertex_offset - position);
+        file.write(&vertex[l][0], vertex[l].size());
+        position = level[l].vertex_offset + level[l].vertex_bytes;
+        file.write(padding, level[l].index_offset - position);
+        file.write(&index[l][0], index[l].size());
+        position = level[l].index_offset + index[l].size();
+    }
+    return file.good();
+}
+
+
+bool MeshCache::Open(const std::string &path, const std::string &key, unsigned long long source_time, unsigned long long source_size, const VertexFormat &format){
+
+    header_ = NULL;
+    level_ = NULL;
+    if (!file_.Open(path.c_str())){
+        return false;
+    }
+    const char *data = file_.GetData();
+    size_t size = file_.GetSize();
+
+    // Header, key and source version
+    if (size < sizeof(MeshCacheHeader)){
+        return false;
+    }
+    const MeshCacheHeader *header = (const MeshCacheHeader *) data;
+    if (memcmp(header->magic, "MSHC", 4) != 0 || header->version != mesh_cache_version || header->level_count == 0){
+        return false;
+    }
+    size_t levels_end = sizeof(MeshCacheHeader) + header->key_length + header->level_count * sizeof(MeshCacheLevel);
+    if (levels_end > size || header->key_length != key.size() || memcmp(data + sizeof(MeshCacheHeader), key.c_str(), key.size()) != 0){
+        return false;
+    }
+    if (header->source_time != source_time || header->source_size != source_size){
+        return false;
+    }
+
+    // Vertex layout
+    if (header->stride != format.stride || header->attribute_count != format.attribute_count){
+        return false;
+    }
+    for (int i = 0; i < format.attribute_count; i++){
+        if (header->attribute[i][0] != format.attribute[i].semantic || header->attribute[i][1] != format.attribute[i].components ||
+            header->attribute[i][2] != format.attribute[i].type || header->attribute[i][3] != format.attribute[i].normalized){
+            return false;
+        }
+    }
+
+    // Blobs inside the file
+    const MeshCacheLevel *level = (const MeshCacheLevel *) (data + sizeof(MeshCacheHeader) + header->key_length);
+    for (GLuint l = 0; l < header->level_count; l++){
+        const MeshCacheLevel &info = level[l];
+        if ((size_t) info.vertex_offset + info.vertex_bytes > size ||
+            (size_t) info.index_offset + (size_t) info.index_count * IndexSize(info.index_type) > size){
+            return false;
+        }
+    }
+
+    header_ = header;
+    level_ = level;
+    return true;
+}
+
+
+int MeshCache::GetLevelCount(void) const {
+
+    return header_ ? header_->level_count : 0;
+}
+
+
+const MeshCacheLevel &MeshCache::GetLevel(int level) const {
+
+    return level_[level];
+}
+
+
+const void *MeshCache::GetVertices(int level) const {
+
+    return file_.GetData() + level_[level].vertex_offset;
+}
+
+
+const void *MeshCache::GetIndices(int level) const {
+
+    return file_.GetData() + level_[level].index_offset;
+}
+
+
+GLsizeiptr MeshCache::GetIndexBytes(int level) const {
+
+    return level_[level].index_count * IndexSize(level_[level].index_type);
+}
+
+} // namespace game
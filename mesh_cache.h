@@ -0,0 +1,75 @@
+#ifndef MESH_CACHE_H_
+#define MESH_CACHE_H_
+
+#include <string>
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "resource.h"
+#include "mapped_file.h"
+
+namespace game {
+
+    // Start of a mesh cache file. It is followed by the key, one
+    // MeshCacheLevel per level of detail, then the vertex and index blobs
+    // of all levels, each starting on a 16-byte boundary
+    struct MeshCacheHeader {
+        char magic[4]; // "MSHC"
+        GLuint version;
+        GLuint key_length; // Bytes of the key that follows the header
+        GLuint level_count;
+        unsigned long long source_time; // Modification time and size of the
+        unsigned long long source_size; // source file, 0 for generated meshes
+        // Vertex layout
+        GLuint stride;
+        GLuint attribute_count;
+        GLuint attribute[VertexSemanticCount][4]; // Semantic, components, type, normalized
+    };
+
+    // One level of detail; offsets are in bytes from the start of the file
+    struct MeshCacheLevel {
+        GLuint vertex_offset;
+        GLuint vertex_bytes;
+        GLuint index_offset;
+        GLuint index_count;
+        GLenum index_type;
+        GLfloat bounds[10]; // Min, max, center and radius
+    };
+
+    // Binary file holding a mesh with its levels of detail exactly as
+    // they sit in their GL buffers, so loading them is a memory mapping
+    // and one glBufferData per buffer, with no parsing
+    class MeshCache {
+
+        public:
+            MeshCache(void);
+            ~MeshCache();
+
+            // Write a mesh and its levels of detail, read back from their
+            // buffers. source_time and source_size identify the version
+            // of the file the mesh came from. Returns false if the file
+            // cannot be written
+            static bool Write(const std::string &path, const std::string &key, unsigned long long source_time, unsigned long long source_size, const Resource *mesh);
+
+            // Map a cache file; false if it is missing, damaged, made for
+            // another key or source version, or in another vertex layout
+            bool Open(const std::string &path, const std::string &key, unsigned long long source_time, unsigned long long source_size, const VertexFormat &format);
+
+            // Contents of the open file, pointing into the mapping
+            int GetLevelCount(void) const;
+            const MeshCacheLevel &GetLevel(int level) const;
+            const void *GetVertices(int level) const;
+            const void *GetIndices(int level) const;
+            // Bytes of the index blob of a level
+            GLsizeiptr GetIndexBytes(int level) const;
+
+        private:
+            MappedFile file_;
+            const MeshCacheHeader *header_;
+            const MeshCacheLevel *level_;
+
+    }; // class MeshCache
+
+} // namespace game
+
+#endif // MESH_CACHE_H_
@@ -0,0 +1,212 @@
+#include <vector>
+#include <string.h>
+#include <math.h>
+
+#include "mesh_optimize.h"
+
+namespace game {
+
+// Score of the last triangle's vertices, fixed so that the order of its
+// own vertices does not matter
+static const float last_triangle_score = 0.75f;
+// Falloff of the score with the position in the cache
+static const float cache_decay_power = 1.5f;
+// Weight of the bonus for vertices with few triangles left, which clears
+// lone triangles before they become expensive to come back to
+static const float valence_boost_scale = 2.0f;
+static const float valence_boost_power = 0.5f;
+
+
+float ComputeAcmr(const GLuint *index, int index_num, int cache_size){
+
+    if (index_num < 3){
+        return 0.0f;
+    }
+
+    std::vector<GLuint> cache;
+    int misses = 0;
+    for (int i = 0; i < index_num; i++){
+        bool hit = false;
+        for (int j = 0; j < cache.size(); j++){
+            if (cache[j] == index[i]){
+                hit = true;
+                break;
+            }
+        }
+        if (!hit){
+            misses++;
+            // First in, first out
+            if (cache.size() == cache_size){
+                cache.erase(cache.begin());
+            }
+            cache.push_back(index[i]);
+        }
+    }
+    return (float) misses / (index_num / 3);
+}
+
+
+// Desirability of a vertex for the next triangle, given its position in the
+// cache (-1 if not cached) and its number of triangles left to draw
+static float VertexScore(int cache_position, int valence){
+
+    if (valence == 0){
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cache_position >= 0){
+        if (cache_position < 3){
+            score = last_triangle_score;
+        } else {
+            float scaler = 1.0f / (vertex_cache_size - 3);
+            score = powf(1.0f - (cache_position - 3) * scaler, cache_decay_power);
+        }
+    }
+    score += valence_boost_scale * powf((float) valence, -valence_boost_power);
+    return score;
+}
+
+
+void OptimizeVertexCache(GLuint *index, int index_num, int vertex_num){
+
+    int face_num = index_num / 3;
+    if (face_num == 0){
+        return;
+    }
+
+    // Triangles around each vertex; live[v] of them are not drawn yet and
+    // kept at the front of the vertex's range
+    std::vector<int> live(vertex_num, 0);
+    for (int i = 0; i < face_num * 3; i++){
+        live[index[i]]++;
+    }
+    std::vector<int> offset(vertex_num + 1, 0);
+    for (int v = 0; v < vertex_num; v++){
+        offset[v + 1] = offset[v] + live[v];
+    }
+    std::vector<int> adjacency(face_num * 3);
+    std::vector<int> fill(offset.begin(), offset.end() - 1);
+    for (int f = 0; f < face_num; f++){
+        for (int j = 0; j < 3; j++){
+            adjacency[fill[index[f*3 + j]]++] = f;
+        }
+    }
+
+    std::vector<int> cache_position(vertex_num, -1);
+    std::vector<float> vertex_score(vertex_num);
+    for (int v = 0; v < vertex_num; v++){
+        vertex_score[v] = VertexScore(-1, live[v]);
+    }
+
+    std::vector<float> face_score(face_num);
+    std::vector<bool> emitted(face_num, false);
+    int best = -1;
+    float best_score = -1.0f;
+    for (int f = 0; f < face_num; f++){
+        face_score[f] = vertex_score[index[f*3]] + vertex_score[index[f*3 + 1]] + vertex_score[index[f*3 + 2]];
+        if (face_score[f] > best_score){
+            best = f;
+            best_score = face_score[f];
+        }
+    }
+
+    std::vector<GLuint> result;
+    result.reserve(face_num * 3);
+    std::vector<int> cache;
+    std::vector<int> new_cache;
+    int cursor = 0;
+
+    for (int drawn = 0; drawn < face_num; drawn++){
+        // Nothing in the cache leads anywhere: restart from the first
+        // triangle not drawn yet
+        if (best < 0){
+            while (emitted[cursor]){
+                cursor++;
+            }
+            best = cursor;
+        }
+
+        int f = best;
+        emitted[f] = true;
+
+        // The triangle's vertices move to the front of the cache
+        new_cache.clear();
+        for (int j = 0; j < 3; j++){
+            int v = index[f*3 + j];
+            result.push_back(v);
+            new_cache.push_back(v);
+
+            int *around = &adjacency[offset[v]];
+            for (int k = 0; k < live[v]; k++){
+                if (around[k] == f){
+                    around[k] = around[live[v] - 1];
+                    around[live[v] - 1] = f;
+                    break;
+                }
+            }
+            live[v]--;
+        }
+        for (int i = 0; i < cache.size(); i++){
+            int v = cache[i];
+            if (v != index[f*3] && v != index[f*3 + 1] && v != index[f*3 + 2]){
+                new_cache.push_back(v);
+            }
+        }
+
+        // Vertices past the end of the cache are evicted
+        for (int i = 0; i < new_cache.size(); i++){
+            int v = new_cache[i];
+            cache_position[v] = (i < vertex_cache_size) ? i : -1;
+            vertex_score[v] = VertexScore(cache_position[v], live[v]);
+        }
+
+        // Only triangles around the vertices that moved change score
+        best = -1;
+        best_score = -1.0f;
+        for (int i = 0; i < new_cache.size(); i++){
+            int v = new_cache[i];
+            for (int k = 0; k < live[v]; k++){
+                int t = adjacency[offset[v] + k];
+                face_score[t] = vertex_score[index[t*3]] + vertex_score[index[t*3 + 1]] + vertex_score[index[t*3 + 2]];
+                if (face_score[t] > best_score){
+                    best = t;
+                    best_score = face_score[t];
+                }
+            }
+        }
+
+        if (new_cache.size() > vertex_cache_size){
+            new_cache.resize(vertex_cache_size);
+        }
+        cache.swap(new_cache);
+    }
+
+    memcpy(index, &result[0], face_num * 3 * sizeof(GLuint));
+}
+
+
+int OptimizeVertexFetch(void *vertex, GLsizei vertex_size, GLuint *index, int index_num, int vertex_num){
+
+    std::vector<int> remap(vertex_num, -1);
+    int next = 0;
+    for (int i = 0; i < index_num; i++){
+        GLuint v = index[i];
+        if (remap[v] < 0){
+            remap[v] = next++;
+        }
+        index[i] = remap[v];
+    }
+
+    GLubyte *data = (GLubyte *) vertex;
+    std::vector<GLubyte> source(data, data + vertex_num * vertex_size);
+    for (int v = 0; v < vertex_num; v++){
+        if (remap[v] >= 0){
+            memcpy(&data[remap[v] * vertex_size], &source[v * vertex_size], vertex_size);
+        }
+    }
+
+    return next;
+}
+
+} // namespace game;
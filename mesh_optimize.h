@@ -0,0 +1,30 @@
+#ifndef MESH_OPTIMIZE_H_
+#define MESH_OPTIMIZE_H_
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+namespace game {
+
+// Entries of the post-transform vertex cache the optimizations target
+const int vertex_cache_size = 32;
+
+// Average cache miss ratio: vertices transformed per triangle when drawing
+// the indices through a FIFO cache of cache_size vertices. 0.5 is the best
+// a regular grid can reach, 3 means no reuse at all
+float ComputeAcmr(const GLuint *index, int index_num, int cache_size = vertex_cache_size);
+
+// Reorder the triangles of an indexed mesh so that consecutive triangles
+// share vertices still in the post-transform cache (Forsyth's linear-speed
+// algorithm)
+void OptimizeVertexCache(GLuint *index, int index_num, int vertex_num);
+
+// Reorder the vertices in the order the indices first use them, so the
+// vertex fetch walks memory linearly, and rewrite the indices to match.
+// Vertices no index uses are dropped; returns the number of vertices left
+// vertex_size is in bytes, so any vertex layout can be reordered
+int OptimizeVertexFetch(void *vertex, GLsizei vertex_size, GLuint *index, int index_num, int vertex_num);
+
+} // namespace game;
+
+#endif // MESH_OPTIMIZE_H_
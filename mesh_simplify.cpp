@@ -0,0 +1,294 @@
+#include <map>
+#include <queue>
+#include <algorithm>
+#include <math.h>
+
+#include "mesh_simplify.h"
+
+namespace game {
+
+// Weight of the planes that pin open borders in place
+static const double border_weight = 1000.0;
+
+// Symmetric 4x4 matrix measuring the squared distance of a point to a set
+// of planes, stored as its 10 unique coefficients
+struct Quadric {
+    double a[10];
+
+    Quadric(void){
+        for (int i = 0; i < 10; i++){
+            a[i] = 0.0;
+        }
+    }
+
+    // Quadric of the plane n.p + d = 0, scaled by weight
+    Quadric(const glm::vec3 &n, double d, double weight){
+        a[0] = weight * n.x * n.x; a[1] = weight * n.x * n.y; a[2] = weight * n.x * n.z; a[3] = weight * n.x * d;
+        a[4] = weight * n.y * n.y; a[5] = weight * n.y * n.z; a[6] = weight * n.y * d;
+        a[7] = weight * n.z * n.z; a[8] = weight * n.z * d;
+        a[9] = weight * d * d;
+    }
+
+    Quadric &operator+=(const Quadric &other){
+        for (int i = 0; i < 10; i++){
+            a[i] += other.a[i];
+        }
+        return *this;
+    }
+
+    // Sum of squared distances of p to the planes
+    double Error(const glm::vec3 &p) const {
+        double x = p.x, y = p.y, z = p.z;
+        return a[0]*x*x + 2*a[1]*x*y + 2*a[2]*x*z + 2*a[3]*x
+             + a[4]*y*y + 2*a[5]*y*z + 2*a[6]*y
+             + a[7]*z*z + 2*a[8]*z
+             + a[9];
+    }
+
+    // Point of minimum error; false if it is not unique
+    bool Minimum(glm::vec3 &p) const {
+        double det = a[0] * (a[4]*a[7] - a[5]*a[5]) - a[1] * (a[1]*a[7] - a[5]*a[2]) + a[2] * (a[1]*a[5] - a[4]*a[2]);
+        if (fabs(det) < 1e-12){
+            return false;
+        }
+        // Cramer's rule on the upper 3x3 block
+        double bx = -a[3], by = -a[6], bz = -a[8];
+        p.x = (float) ((bx * (a[4]*a[7] - a[5]*a[5]) - a[1] * (by*a[7] - a[5]*bz) + a[2] * (by*a[5] - a[4]*bz)) / det);
+        p.y = (float) ((a[0] * (by*a[7] - a[5]*bz) - bx * (a[1]*a[7] - a[5]*a[2]) + a[2] * (a[1]*bz - by*a[2])) / det);
+        p.z = (float) ((a[0] * (a[4]*bz - by*a[5]) - a[1] * (a[1]*bz - by*a[2]) + bx * (a[1]*a[5] - a[4]*a[2])) / det);
+        return true;
+    }
+};
+
+
+// Candidate edge collapse; stamps detect candidates made stale by other
+// collapses
+struct Collapse {
+    double cost;
+    int v0, v1;
+    int stamp0, stamp1;
+    glm::vec3 target;
+
+    // Order for a min-heap on cost
+    bool operator<(const Collapse &other) const {
+        return cost > other.cost;
+    }
+};
+
+
+// State of the simplification
+struct Simplifier {
+    std::vector<glm::vec3> position;
+    std::vector<Quadric> quadric;
+    std::vector<int> stamp;
+    std::vector<bool> removed;
+    std::vector<Face> face;
+    std::vector<bool> face_alive;
+    std::vector<std::vector<int> > vertex_face; // Faces around each vertex
+    std::priority_queue<Collapse> heap;
+
+    glm::vec3 FaceNormal(const Face &f, int from, int to, const glm::vec3 &p) const {
+        glm::vec3 c[3];
+        for (int j = 0; j < 3; j++){
+            c[j] = (f.i[j] == from || f.i[j] == to) ? p : position[f.i[j]];
+        }
+        return glm::cross(c[1] - c[0], c[2] - c[0]);
+    }
+
+    // Queue the collapse of an edge into its cheapest point
+    void Push(int v0, int v1){
+        Quadric q = quadric[v0];
+        q += quadric[v1];
+
+        Collapse c;
+        c.v0 = v0;
+        c.v1 = v1;
+        c.stamp0 = stamp[v0];
+        c.stamp1 = stamp[v1];
+        // An ill-conditioned quadric may put its minimum far from the
+        // edge; fall back to the best of the end points and midpoint
+        glm::vec3 mid = (position[v0] + position[v1]) * 0.5f;
+        float reach = glm::length(position[v1] - position[v0]);
+        if (!q.Minimum(c.target) || glm::length(c.target - mid) > reach){
+            glm::vec3 candidate[3] = { position[v0], position[v1], mid };
+            c.target = candidate[0];
+            for (int k = 1; k < 3; k++){
+                if (q.Error(candidate[k]) < q.Error(c.target)){
+                    c.target = candidate[k];
+                }
+            }
+        }
+        c.cost = q.Error(c.target);
+        heap.push(c);
+    }
+
+    // Whether moving v0 and v1 to p flips or collapses a triangle that
+    // does not contain the edge
+    bool Flips(int v0, int v1, const glm::vec3 &p) const {
+        int v[2] = { v0, v1 };
+        for (int k = 0; k < 2; k++){
+            for (int i = 0; i < vertex_face[v[k]].size(); i++){
+                int fi = vertex_face[v[k]][i];
+                if (!face_alive[fi]){
+                    continue;
+                }
+                const Face &f = face[fi];
+                bool has0 = (f.i[0] == v0 || f.i[1] == v0 || f.i[2] == v0);
+                bool has1 = (f.i[0] == v1 || f.i[1] == v1 || f.i[2] == v1);
+                if (has0 && has1){
+                    continue;
+                }
+                // Faces that are already degenerate cannot flip
+                glm::vec3 before = FaceNormal(f, -1, -1, p);
+                if (glm::dot(before, before) == 0.0f){
+                    continue;
+                }
+                glm::vec3 after = FaceNormal(f, v0, v1, p);
+                if (glm::dot(before, after) <= 0.0f){
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+};
+
+
+TriMesh SimplifyMesh(const TriMesh &mesh, int target_faces){
+
+    Simplifier s;
+    int vertex_num = (int) mesh.position.size();
+    s.position = mesh.position;
+    s.quadric.resize(vertex_num);
+    s.stamp.assign(vertex_num, 0);
+    s.removed.assign(vertex_num, false);
+    s.face = mesh.face;
+    s.face_alive.assign(mesh.face.size(), true);
+    s.vertex_face.resize(vertex_num);
+
+    // Plane of every face, weighted by its area, and use count of edges
+    std::map<std::pair<int, int>, int> edge_count;
+    for (int fi = 0; fi < s.face.size(); fi++){
+        const Face &f = s.face[fi];
+        glm::vec3 n = glm::cross(s.position[f.i[1]] - s.position[f.i[0]], s.position[f.i[2]] - s.position[f.i[0]]);
+        float area = glm::length(n);
+        if (area > 0.0f){
+            n /= area;
+            Quadric q(n, -glm::dot(n, s.position[f.i[0]]), area * 0.5);
+            for (int j = 0; j < 3; j++){
+                s.quadric[f.i[j]] += q;
+            }
+        }
+        for (int j = 0; j < 3; j++){
+            s.vertex_face[f.i[j]].push_back(fi);
+            int a = f.i[j], b = f.i[(j + 1) % 3];
+            edge_count[std::make_pair((a < b) ? a : b, (a < b) ? b : a)]++;
+        }
+    }
+
+    // Pin open borders with planes through the border edges, perpendicular
+    // to their face
+    for (int fi = 0; fi < s.face.size(); fi++){
+        const Face &f = s.face[fi];
+        glm::vec3 n = glm::cross(s.position[f.i[1]] - s.position[f.i[0]], s.position[f.i[2]] - s.position[f.i[0]]);
+        for (int j = 0; j < 3; j++){
+            int a = f.i[j], b = f.i[(j + 1) % 3];
+            if (edge_count[std::make_pair((a < b) ? a : b, (a < b) ? b : a)] != 1){
+                continue;
+            }
+            glm::vec3 edge = s.position[b] - s.position[a];
+            glm::vec3 border = glm::cross(edge, n);
+            float length = glm::length(border);
+            if (length > 0.0f){
+                border /= length;
+                Quadric q(border, -glm::dot(border, s.position[a]), border_weight * glm::dot(edge, edge));
+                s.quadric[a] += q;
+                s.quadric[b] += q;
+            }
+        }
+    }
+
+    for (std::map<std::pair<int, int>, int>::iterator it = edge_count.begin(); it != edge_count.end(); it++){
+        s.Push(it->first.first, it->first.second);
+    }
+
+    // Collapse the cheapest edges until the target is reached
+    int face_num = (int) s.face.size();
+    while (face_num > target_faces && !s.heap.empty()){
+        Collapse c = s.heap.top();
+        s.heap.pop();
+        if (s.removed[c.v0] || s.removed[c.v1] || c.stamp0 != s.stamp[c.v0] || c.stamp1 != s.stamp[c.v1]){
+            continue;
+        }
+        if (s.Flips(c.v0, c.v1, c.target)){
+            continue;
+        }
+
+        // Merge v1 into v0
+        s.position[c.v0] = c.target;
+        s.quadric[c.v0] += s.quadric[c.v1];
+        s.removed[c.v1] = true;
+        s.stamp[c.v0]++;
+        s.stamp[c.v1]++;
+        for (int i = 0; i < s.vertex_face[c.v1].size(); i++){
+            int fi = s.vertex_face[c.v1][i];
+            if (!s.face_alive[fi]){
+                continue;
+            }
+            Face &f = s.face[fi];
+            for (int j = 0; j < 3; j++){
+                if (f.i[j] == c.v1){
+                    f.i[j] = c.v0;
+                }
+            }
+            if (f.i[0] == f.i[1] || f.i[1] == f.i[2] || f.i[2] == f.i[0]){
+                s.face_alive[fi] = false;
+                face_num--;
+            } else {
+                s.vertex_face[c.v0].push_back(fi);
+            }
+        }
+
+        // Requeue the edges around the merged vertex
+        std::vector<int> neighbor;
+        for (int i = 0; i < s.vertex_face[c.v0].size(); i++){
+            int fi = s.vertex_face[c.v0][i];
+            if (!s.face_alive[fi]){
+                continue;
+            }
+            for (int j = 0; j < 3; j++){
+                int v = s.face[fi].i[j];
+                if (v != c.v0 && std::find(neighbor.begin(), neighbor.end(), v) == neighbor.end()){
+                    neighbor.push_back(v);
+                }
+            }
+        }
+        for (int i = 0; i < neighbor.size(); i++){
+            s.Push(c.v0, neighbor[i]);
+        }
+    }
+
+    // Compact the surviving positions
+    TriMesh result;
+    result.normal = mesh.normal;
+    result.tex_coord = mesh.tex_coord;
+    std::vector<int> remap(vertex_num, -1);
+    for (int fi = 0; fi < s.face.size(); fi++){
+        if (!s.face_alive[fi]){
+            continue;
+        }
+        Face f = s.face[fi];
+        for (int j = 0; j < 3; j++){
+            if (remap[f.i[j]] < 0){
+                remap[f.i[j]] = (int) result.position.size();
+                result.position.push_back(s.position[f.i[j]]);
+            }
+            f.i[j] = remap[f.i[j]];
+        }
+        result.face.push_back(f);
+    }
+
+    return result;
+}
+
+} // namespace game;
@@ -0,0 +1,16 @@
+#ifndef MESH_SIMPLIFY_H_
+#define MESH_SIMPLIFY_H_
+
+#include "model_loader.h"
+
+namespace game {
+
+// Simplify a mesh to about target_faces triangles by collapsing the edges
+// with the smallest quadric error (Garland and Heckbert). Open borders are
+// kept in place and collapses that would flip a triangle are rejected.
+// Surviving corners keep their normal and texture coordinate indices
+TriMesh SimplifyMesh(const TriMesh &mesh, int target_faces);
+
+} // namespace game;
+
+#endif // MESH_SIMPLIFY_H_
@@ -0,0 +1,40 @@
+#ifndef MODEL_H_
+#define MODEL_H_
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/quaternion.hpp>
+
+#include "resource.h"
+
+namespace game {
+
+    // Node of a model loaded from a scene file, placed relative to its
+    // parent
+    struct ModelNode {
+        std::string name;
+        glm::vec3 position;
+        glm::quat orientation;
+        glm::vec3 scale;
+        // One mesh per primitive; nodes using the same mesh share them
+        std::vector<const Resource *> geometry;
+        std::vector<int> child;
+        // Copies of the meshes relative to the node, empty for one copy
+        std::vector<glm::vec3> instance_position;
+        std::vector<glm::quat> instance_orientation;
+        std::vector<glm::vec3> instance_scale;
+    };
+
+    // Node hierarchy of a model; SceneGraph::CreateModel places a copy of
+    // it in a scene
+    struct Model {
+        std::vector<ModelNode> node;
+        std::vector<int> root;
+        const Resource *group; // Empty mesh of nodes that only hold others
+    };
+
+} // namespace game
+
+#endif // MODEL_H_
@@ -5,6 +5,7 @@
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <vector>
 #define GLEW_STATIC
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -47,6 +48,9 @@ std::vector<std::string> string_split(std::string str, std::string separator);
 std::vector<std::string> string_split_once(std::string str, std::string separator);
 // Print a mesh stored internally
 void print_mesh(TriMesh &mesh);
+// Set the normal of every position to the average of its face normals,
+// for meshes without normals
+void ComputeVertexNormals(TriMesh &mesh);
 // Conversion between strings and numbers
 template <typename T> std::string num_to_str(T num);
 template <typename T> T str_to_num(const std::string &str);
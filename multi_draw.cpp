@@ -0,0 +1,233 @@
+#include "multi_draw.h"
+
+namespace game {
+
+// Binding point of the per-draw storage buffer, matches the *_mdi shaders
+static const GLuint draw_data_binding = 0;
+
+MultiDrawRenderer::MultiDrawRenderer(void){
+
+    indirect_buffer_ = 0;
+    draw_data_buffer_ = 0;
+    draw_id_buffer_ = 0;
+    draw_id_capacity_ = 0;
+    draw_calls_ = 0;
+}
+
+
+MultiDrawRenderer::~MultiDrawRenderer(){
+
+    for (int i = 0; i < arena_.size(); i++){
+        delete arena_[i];
+    }
+}
+
+
+bool MultiDrawRenderer::IsSupported(void){
+
+    // The extensions alone are not enough: the shaders are GLSL 4.30
+    return GLEW_VERSION_4_3;
+}
+
+
+void MultiDrawRenderer::Init(void){
+
+    glGenBuffers(1, &indirect_buffer_);
+    glGenBuffers(1, &draw_data_buffer_);
+    glGenBuffers(1, &draw_id_buffer_);
+}
+
+
+void MultiDrawRenderer::SetMaterialVariant(GLuint material, GLuint variant){
+
+    for (int i = 0; i < material_.size(); i++){
+        if (material_[i] == material){
+            variant_[i] = variant;
+            return;
+        }
+    }
+    material_.push_back(material);
+    variant_.push_back(variant);
+}
+
+
+bool MultiDrawRenderer::Add(SceneNode *node){
+
+    if (node->GetMode() != GL_TRIANGLES || !node->GetGeometryResource()){
+        return false;
+    }
+    const Resource *geometry = node->GetLodGeometry();
+
+    // Only materials with a variant reading the storage buffer
+    GLuint program = 0;
+    for (int i = 0; i < material_.size(); i++){
+        if (material_[i] == node->GetMaterial()){
+            program = variant_[i];
+            break;
+        }
+    }
+    if (!program){
+        return false;
+    }
+
+    // Meshes of one layout share an arena
+    GeometryArena *arena = NULL;
+    for (int i = 0; i < arena_.size(); i++){
+        if (&arena_[i]->GetVertexFormat() == &geometry->GetVertexFormat()){
+            arena = arena_[i];
+            break;
+        }
+    }
+    if (!arena){
+        arena = new GeometryArena(geometry->GetVertexFormat());
+        arena_.push_back(arena);
+    }
+
+    const ArenaRange *range = arena->Find(geometry);
+    if (!range){
+        if (!arena->Add(geometry)){
+            return false;
+        }
+        range = arena->Find(geometry);
+    }
+
+    // Find the bucket, there are only a few of them
+    Bucket *bucket = NULL;
+    for (int i = 0; i < bucket_.size(); i++){
+        if (bucket_[i].program == program && bucket_[i].texture == node->GetTexture() && bucket_[i].arena == arena){
+            bucket = &bucket_[i];
+            break;
+        }
+    }
+    if (!bucket){
+        bucket_.push_back(Bucket());
+        bucket = &bucket_.back();
+        bucket->program = program;
+        bucket->texture = node->GetTexture();
+        bucket->arena = arena;
+    }
+
+    DrawElementsIndirectCommand command;
+    command.count = range->index_count;
+    command.instance_count = 1;
+    command.first_index = range->first_index;
+    command.base_vertex = range->base_vertex;
+    command.base_instance = 0; // Set on flush
+    bucket->command.push_back(command);
+    bucket->transform.push_back(node->GetTransform());
+
+    return true;
+}
+
+
+void MultiDrawRenderer::AddSingle(SceneNode *node){
+
+    single_.push_back(node);
+}
+
+
+void MultiDrawRenderer::Flush(Camera *camera){
+
+    draw_calls_ = 0;
+
+    // Concatenate the buckets; the base instance of a command is its
+    // index in the storage buffer
+    command_.clear();
+    transform_.clear();
+    for (int i = 0; i < bucket_.size(); i++){
+        Bucket &bucket = bucket_[i];
+        for (int j = 0; j < bucket.command.size(); j++){
+            bucket.command[j].base_instance = (GLuint) command_.size();
+            command_.push_back(bucket.command[j]);
+            transform_.push_back(bucket.transform[j]);
+        }
+    }
+
+    GLsizei count = (GLsizei) command_.size();
+    if (count > 0){
+        draw_data_.resize(count);
+        SceneNode::GetTransformStore().GatherMatrices(&transform_[0], count, &draw_data_[0]);
+
+        // Orphan and refill the per-frame buffers
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer_);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, count * sizeof(DrawElementsIndirectCommand), &command_[0], GL_STREAM_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, draw_data_buffer_);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(NodeMatrices), &draw_data_[0], GL_STREAM_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, draw_data_binding, draw_data_buffer_);
+
+        // The draw id buffer only changes when it grows
+        if (count > draw_id_capacity_){
+            draw_id_capacity_ = (count > 2 * draw_id_capacity_) ? count : 2 * draw_id_capacity_;
+            std::vector<GLuint> draw_id(draw_id_capacity_);
+            for (GLsizei i = 0; i < draw_id_capacity_; i++){
+                draw_id[i] = i;
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, draw_id_buffer_);
+            glBufferData(GL_ARRAY_BUFFER, draw_id_capacity_ * sizeof(GLuint), &draw_id[0], GL_STATIC_DRAW);
+        }
+    }
+
+    GLsizei first = 0;
+    for (int i = 0; i < bucket_.size(); i++){
+        Bucket &bucket = bucket_[i];
+        GLsizei bucket_count = (GLsizei) bucket.command.size();
+        if (bucket_count == 0){
+            continue;
+        }
+
+        glUseProgram(bucket.program);
+        camera->SetupShader(bucket.program);
+
+        // Shared geometry
+        glBindBuffer(GL_ARRAY_BUFFER, bucket.arena->GetArrayBuffer());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bucket.arena->GetElementArrayBuffer());
+        bucket.arena->GetVertexFormat().SetupAttributes(bucket.program);
+
+        // One draw id per command
+        GLint draw_id_att = glGetAttribLocation(bucket.program, "draw_id");
+        glBindBuffer(GL_ARRAY_BUFFER, draw_id_buffer_);
+        glVertexAttribIPointer(draw_id_att, 1, GL_UNSIGNED_INT, 0, 0);
+        glVertexAttribDivisor(draw_id_att, 1);
+        glEnableVertexAttribArray(draw_id_att);
+
+        SceneNode::SetupMaterial(bucket.program, bucket.texture);
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer_);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *) (first * sizeof(DrawElementsIndirectCommand)), bucket_count, 0);
+        draw_calls_++;
+
+        // Other programs may use the same attribute index per vertex
+        glVertexAttribDivisor(draw_id_att, 0);
+        glDisableVertexAttribArray(draw_id_att);
+
+        first += bucket_count;
+        bucket.command.clear();
+        bucket.transform.clear();
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    // Everything that could not be batched
+    for (int i = 0; i < single_.size(); i++){
+        single_[i]->DrawGeometry(camera);
+        draw_calls_++;
+    }
+    single_.clear();
+}
+
+
+int MultiDrawRenderer::GetDrawCallCount(void) const {
+
+    return draw_calls_;
+}
+
+
+size_t MultiDrawRenderer::GetMemoryUsed(void) const {
+
+    size_t used = draw_id_capacity_ * sizeof(GLuint);
+    for (int i = 0; i < arena_.size(); i++){
+        used += arena_[i]->GetMemoryUsed();
+    }
+    return used;
+}
+
+} // namespace game
@@ -0,0 +1,96 @@
+#ifndef MULTI_DRAW_H_
+#define MULTI_DRAW_H_
+
+#include <vector>
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "scene_node.h"
+#include "camera.h"
+#include "geometry_arena.h"
+#include "transform_store.h"
+
+namespace game {
+
+    // Layout of one command in an indirect draw buffer
+    struct DrawElementsIndirectCommand {
+        GLuint count; // Number of indices
+        GLuint instance_count; // Always 1
+        GLuint first_index; // Offset of the first index, in indices
+        GLint base_vertex; // Offset added to every index
+        GLuint base_instance; // Index of the draw in the per-draw data
+    };
+
+    // Draws scene nodes with one glMultiDrawElementsIndirect per material
+    // and texture
+    //
+    // Meshes are copied into a shared arena, one per vertex layout, the
+    // first time a node using them is queued. Each frame the queued nodes become indirect commands
+    // and their matrices are gathered into a storage buffer, so the number
+    // of GL calls depends on the number of materials, not of nodes.
+    // Shaders find their matrices through the draw_id attribute, which is
+    // instanced and offset by the base instance of each command
+    class MultiDrawRenderer {
+
+        public:
+            MultiDrawRenderer(void);
+            ~MultiDrawRenderer();
+
+            // Whether the context is OpenGL 4.3 or later, for indirect
+            // multi-draw, base instance, storage buffers and the GLSL
+            // version of the shaders
+            static bool IsSupported(void);
+            // Create the buffers; call once the context exists
+            void Init(void);
+
+            // Draw nodes using a material with a variant of its program
+            // that reads the per-draw matrices from the storage buffer
+            void SetMaterialVariant(GLuint material, GLuint variant);
+
+            // Queue a node for the batched draws; returns false if it must
+            // be drawn on its own
+            bool Add(SceneNode *node);
+            // Queue a node to be drawn with its own call after the batches
+            void AddSingle(SceneNode *node);
+            // Draw and clear everything queued since the last flush
+            void Flush(Camera *camera);
+
+            // Number of GL draw calls issued by the last flush
+            int GetDrawCallCount(void) const;
+            // Bytes of the arenas, a second copy of every mesh queued, and
+            // of the draw id buffer
+            size_t GetMemoryUsed(void) const;
+
+        private:
+            // Nodes drawn together: same program variant, texture and
+            // vertex layout
+            struct Bucket {
+                GLuint program;
+                GLuint texture;
+                GeometryArena *arena;
+                std::vector<DrawElementsIndirectCommand> command;
+                std::vector<TransformHandle> transform;
+            };
+
+            std::vector<GeometryArena *> arena_; // Vertices and indices of all meshes, per layout
+            std::vector<GLuint> material_; // Materials with a variant
+            std::vector<GLuint> variant_; // Variant of each material
+            std::vector<Bucket> bucket_; // Kept across frames, emptied on flush
+            std::vector<SceneNode *> single_; // Nodes drawn on their own
+
+            // Per-frame data of all buckets, in bucket order
+            std::vector<DrawElementsIndirectCommand> command_;
+            std::vector<TransformHandle> transform_;
+            std::vector<NodeMatrices> draw_data_;
+
+            GLuint indirect_buffer_; // Commands
+            GLuint draw_data_buffer_; // Storage buffer of matrices
+            GLuint draw_id_buffer_; // 0, 1, 2... read once per instance
+            GLsizei draw_id_capacity_; // Entries in draw_id_buffer_
+            int draw_calls_;
+
+    }; // class MultiDrawRenderer
+
+} // namespace game
+
+#endif // MULTI_DRAW_H_
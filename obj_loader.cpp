@@ -0,0 +1,289 @@
+#include <math.h>
+
+#include "obj_loader.h"
+#include "mapped_file.h"
+
+namespace game {
+
+// Powers of ten that are exact in a double
+static const double exact_power_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+static inline bool IsSpace(char c){
+
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+
+static inline bool IsDigit(char c){
+
+    return c >= '0' && c <= '9';
+}
+
+
+static inline const char *SkipSpace(const char *p, const char *end){
+
+    while (p < end && IsSpace(*p)){
+        p++;
+    }
+    return p;
+}
+
+
+static inline const char *SkipLine(const char *p, const char *end){
+
+    while (p < end && *p != '\n'){
+        p++;
+    }
+    return (p < end) ? p + 1 : p;
+}
+
+
+// Parse a decimal number such as -1.25e-3 at p and move p past it. Like
+// std::from_chars it never allocates, looks at the locale or reads past
+// end; the result is exact for up to 15 significant digits
+static bool ParseFloat(const char *&p, const char *end, float &value){
+
+    const char *s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')){
+        negative = (*s == '-');
+        s++;
+    }
+
+    // Up to 19 significant digits fit in the mantissa; later integer
+    // digits only scale it and later fraction digits are dropped
+    unsigned long long mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any = false;
+    while (s < end && IsDigit(*s)){
+        if (digits < 19){
+            mantissa = mantissa * 10 + (*s - '0');
+            digits += (mantissa != 0);
+        } else {
+            exponent++;
+        }
+        s++;
+        any = true;
+    }
+    if (s < end && *s == '.'){
+        s++;
+        while (s < end && IsDigit(*s)){
+            if (digits < 19){
+                mantissa = mantissa * 10 + (*s - '0');
+                digits += (mantissa != 0);
+                exponent--;
+            }
+            s++;
+            any = true;
+        }
+    }
+    if (!any){
+        return false;
+    }
+
+    if (s < end && (*s == 'e' || *s == 'E')){
+        const char *e = s + 1;
+        bool negative_exponent = false;
+        if (e < end && (*e == '-' || *e == '+')){
+            negative_exponent = (*e == '-');
+            e++;
+        }
+        if (e < end && IsDigit(*e)){
+            int power = 0;
+            while (e < end && IsDigit(*e)){
+                if (power < 10000){
+                    power = power * 10 + (*e - '0');
+                }
+                e++;
+            }
+            exponent += negative_exponent ? -power : power;
+            s = e;
+        }
+    }
+
+    double result = (double) mantissa;
+    if (exponent < 0){
+        result = (exponent >= -22) ? result / exact_power_of_ten[-exponent] : result * pow(10.0, exponent);
+    } else if (exponent > 0){
+        result = (exponent <= 22) ? result * exact_power_of_ten[exponent] : result * pow(10.0, exponent);
+    }
+    value = (float) (negative ? -result : result);
+    p = s;
+    return true;
+}
+
+
+// Parse a signed integer at p and move p past it
+static bool ParseInt(const char *&p, const char *end, int &value){
+
+    const char *s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')){
+        negative = (*s == '-');
+        s++;
+    }
+    if (s >= end || !IsDigit(*s)){
+        return false;
+    }
+    int result = 0;
+    while (s < end && IsDigit(*s)){
+        result = result * 10 + (*s - '0');
+        s++;
+    }
+    value = negative ? -result : result;
+    p = s;
+    return true;
+}
+
+
+// Turn a 1-based or negative (counted from the end) OBJ index into a
+// 0-based one; -1 if it is out of bounds
+static inline int ResolveIndex(int index, size_t count){
+
+    int resolved = (index < 0) ? (int) count + index : index - 1;
+    return (resolved >= 0 && resolved < (int) count) ? resolved : -1;
+}
+
+
+static void ParseError(const char *filename, int line, const char *message){
+
+    std::stringstream ss;
+    ss << "Error in " << filename << " line " << line << ": " << message;
+    throw(std::ios_base::failure(ss.str()));
+}
+
+
+bool LoadObj(const char *filename, TriMesh &mesh){
+
+    MappedFile file;
+    if (!file.Open(filename)){
+        throw(std::ios_base::failure(std::string("Error opening file ")+std::string(filename)));
+    }
+    const char *p = file.GetData();
+    const char *end = p + file.GetSize();
+
+    // Rough capacity from the file size, to avoid most regrowth: a face
+    // line is some 30 bytes and half the lines are faces
+    size_t estimate = file.GetSize() / 60;
+    mesh.face.reserve(estimate);
+    mesh.position.reserve(estimate / 2);
+
+    bool has_normals = false;
+    int line = 0;
+    // Corners of the current polygon
+    std::vector<int> corner_i, corner_t, corner_n;
+
+    while (p < end){
+        line++;
+        p = SkipSpace(p, end);
+        if (p >= end){
+            break;
+        }
+
+        // Keyword, up to the first space
+        const char *keyword = p;
+        while (p < end && !IsSpace(*p) && *p != '\n'){
+            p++;
+        }
+        size_t length = p - keyword;
+
+        if (length == 1 && keyword[0] == 'v'){
+            glm::vec3 position;
+            for (int k = 0; k < 3; k++){
+                p = SkipSpace(p, end);
+                if (!ParseFloat(p, end, position[k])){
+                    ParseError(filename, line, "v command should have 3 parameters");
+                }
+            }
+            mesh.position.push_back(position);
+        } else if (length == 2 && keyword[0] == 'v' && keyword[1] == 'n'){
+            glm::vec3 normal;
+            for (int k = 0; k < 3; k++){
+                p = SkipSpace(p, end);
+                if (!ParseFloat(p, end, normal[k])){
+                    ParseError(filename, line, "vn command should have 3 parameters");
+                }
+            }
+            mesh.normal.push_back(normal);
+            has_normals = true;
+        } else if (length == 2 && keyword[0] == 'v' && keyword[1] == 't'){
+            glm::vec2 tex_coord;
+            for (int k = 0; k < 2; k++){
+                p = SkipSpace(p, end);
+                if (!ParseFloat(p, end, tex_coord[k])){
+                    ParseError(filename, line, "vt command should have 2 parameters");
+                }
+            }
+            mesh.tex_coord.push_back(tex_coord);
+        } else if (length == 1 && keyword[0] == 'f'){
+            // Corners are v, v/t, v//n or v/t/n
+            corner_i.clear();
+            corner_t.clear();
+            corner_n.clear();
+            while (true){
+                p = SkipSpace(p, end);
+                if (p >= end || *p == '\n' || *p == '#'){
+                    break;
+                }
+                int v, t = 0, n = 0;
+                if (!ParseInt(p, end, v)){
+                    ParseError(filename, line, "f parameters should be indices separated by '/'");
+                }
+                if (p < end && *p == '/'){
+                    p++;
+                    if (p < end && *p != '/' && !ParseInt(p, end, t)){
+                        ParseError(filename, line, "invalid texture coordinate index");
+                    }
+                    if (p < end && *p == '/'){
+                        p++;
+                        if (!ParseInt(p, end, n)){
+                            ParseError(filename, line, "invalid normal index");
+                        }
+                    }
+                }
+                int i = ResolveIndex(v, mesh.position.size());
+                if (i < 0){
+                    ParseError(filename, line, "vertex index out of bounds");
+                }
+                // Omitted texture coordinate and normal indices are -1
+                int ti = t ? ResolveIndex(t, mesh.tex_coord.size()) : -1;
+                if (t && ti < 0){
+                    ParseError(filename, line, "texture coordinate index out of bounds");
+                }
+                int ni = n ? ResolveIndex(n, mesh.normal.size()) : -1;
+                if (n && ni < 0){
+                    ParseError(filename, line, "normal index out of bounds");
+                }
+                corner_i.push_back(i);
+                corner_t.push_back(ti);
+                corner_n.push_back(ni);
+            }
+            if (corner_i.size() < 3){
+                ParseError(filename, line, "f command should have at least 3 parameters");
+            }
+
+            // Fan of triangles around the first corner
+            for (int k = 1; k + 1 < corner_i.size(); k++){
+                int c[3] = { 0, k, k + 1 };
+                Face face;
+                for (int j = 0; j < 3; j++){
+                    face.i[j] = corner_i[c[j]];
+                    face.t[j] = corner_t[c[j]];
+                    face.n[j] = corner_n[c[j]];
+                }
+                mesh.face.push_back(face);
+            }
+        }
+        // Ignore comments and other commands
+        p = SkipLine(p, end);
+    }
+
+    return has_normals;
+}
+
+} // namespace game;
@@ -0,0 +1,17 @@
+#ifndef OBJ_LOADER_H_
+#define OBJ_LOADER_H_
+
+#include "model_loader.h"
+
+namespace game {
+
+// Parse a Wavefront OBJ file into a mesh. The file is mapped into memory
+// and tokenized in place, without copying lines or allocating per token.
+// Polygons are split into triangle fans and negative (relative) indices
+// are resolved. Returns whether the file has normals; throws
+// std::ios_base::failure for files that cannot be read or parsed
+bool LoadObj(const char *filename, TriMesh &mesh);
+
+} // namespace game;
+
+#endif // OBJ_LOADER_H_
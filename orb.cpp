@@ -1,4 +1,5 @@
 #include "orb.h"
+#include "multi_draw.h"
 
 namespace game {
 
@@ -87,4 +88,26 @@ void Orb::Draw(Camera *camera){
     SceneNode::Draw(camera);
 }
 
+void Orb::Submit(MultiDrawRenderer *renderer){
+    renderer->AddSingle(particles_);
+    SceneNode::Submit(renderer);
+}
+
+bool Orb::GetWorldBounds(glm::vec3 &min, glm::vec3 &max){
+
+    if (!SceneNode::GetWorldBounds(min, max)){
+        return false;
+    }
+
+    // The beacon is animated in particle2_vp.glsl and has no geometry
+    // bounds; it spreads sideways and rises in a column above the orb
+    const glm::vec3 beacon_min(-20.0f, 0.0f, -20.0f);
+    const glm::vec3 beacon_max(20.0f, 250.0f, 20.0f);
+    glm::vec3 position = GetPosition();
+    min = glm::min(min, position + beacon_min);
+    max = glm::max(max, position + beacon_max);
+
+    return true;
+}
+
 } // namespace game
@@ -40,6 +40,8 @@ namespace game {
 
             void Update(void) override;
             void Draw(Camera *camera) override;
+            void Submit(MultiDrawRenderer *renderer) override;
+            bool GetWorldBounds(glm::vec3 &min, glm::vec3 &max) override;
             
         private:
             // Angular momentum of asteroid
@@ -0,0 +1,47 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "resource_pack.h"
+
+// Build the resource pack of the game from a list of assets
+//
+// Usage: pack_builder <pack> <root directory> <list>
+// The list names one file per line, relative to the root directory, in
+// the order the game loads them
+int main(int argc, char *argv[]){
+
+    if (argc != 4){
+        std::cerr << "Usage: " << argv[0] << " <pack> <root directory> <list>" << std::endl;
+        return 1;
+    }
+
+    std::ifstream list(argv[3]);
+    if (!list){
+        std::cerr << "Error opening file " << argv[3] << std::endl;
+        return 1;
+    }
+    std::vector<std::string> names;
+    std::string line;
+    while (std::getline(list, line)){
+        // Skip blank lines and comments
+        size_t end = line.find_last_not_of(" \t\r");
+        if (end == std::string::npos || line[0] == '#'){
+            continue;
+        }
+        names.push_back(line.substr(0, end + 1));
+    }
+
+    try {
+        game::ResourcePack::Write(argv[1], argv[2], names);
+    }
+    catch (std::exception &e){
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "Packed " << names.size() << " files into " << argv[1] << std::endl;
+    return 0;
+}
@@ -28,6 +28,16 @@ Player::Player(const std::string name, const Resource *geometry, const Resource
     offsets_[5] = glm::vec3(0.6, -0.2, 1.0);
     offsets_[6] = glm::vec3(0.35, 0.6, 1.0);
     offsets_[7] = glm::vec3(0.335, 1.2, 1.0);
+
+    // Attach wheels and antennas so that they follow the body
+    for (int i = 0; i < num_wheels_; i++){
+        wheels_[i]->SetPosition(offsets_[i]);
+        AddChild(wheels_[i]);
+    }
+    for (int i = 0; i < num_antennas_; i++){
+        antennas_[i]->SetPosition(offsets_[num_wheels_ + i]);
+        AddChild(antennas_[i]);
+    }
 }
 
 
@@ -48,7 +58,7 @@ void Player::SetAngM(glm::quat angm){
 
 void Player::Translate(glm::vec3 trans){
     for (int i = 0; i < num_wheels_; i++){
-        wheels_[i]->Rotate(glm::angleAxis(0.05f, glm::vec3(GetOrientation() * glm::vec4(offsets_[i], 0.0f))));
+        wheels_[i]->Rotate(glm::angleAxis(0.05f, glm::normalize(offsets_[i])));
     }
 
     glm::vec3 temp_pos = SceneNode::GetPosition() + trans;
@@ -68,20 +78,6 @@ void Player::Update(void){
     antennas_[1]->Rotate(glm::angleAxis(1.0f, glm::vec3(0,0.1,0))); 
 }
 
-void Player::Draw(Camera *camera){
-    SceneNode::Draw(camera);
-    for (int i = 0; i < num_wheels_; i++){
-        glm::vec3 offsetInWorldSpace = glm::vec3(GetOrientation() * glm::vec4(offsets_[i], 0.0f));
-        wheels_[i]->SetPosition(GetPosition() + offsetInWorldSpace);
-        wheels_[i]->Draw(camera);
-    }
-    for (int i = 0; i < num_antennas_; i++){
-        glm::vec3 offsetInWorldSpace = glm::vec3(GetOrientation() * glm::vec4(offsets_[num_wheels_ + i], 0.0f));
-        antennas_[i]->SetPosition(GetPosition() + offsetInWorldSpace);
-        antennas_[i]->Draw(camera);
-    }
-}
-
 void Player::Pitch(float angle){
     glm::quat rotation = glm::angleAxis(angle, glm::vec3(1,0,0));
     SetOrientation(glm::normalize(GetOrientation() * rotation));
@@ -46,8 +46,6 @@ namespace game {
             void Update(std::vector<std::vector<float>> height_values, float length, float width);
             void Translate(glm::vec3 trans) override;
 
-            void Draw(Camera *camera) override;
-
             float fill = 1.0;
 
         private:
@@ -0,0 +1,80 @@
+#include <vector>
+#include <fstream>
+#include <string.h>
+
+#include "program_cache.h"
+#include "mapped_file.h"
+
+namespace game {
+
+// Bump when the format changes
+static const GLuint program_cache_version = 1;
+
+
+bool ProgramCache::Write(const std::string &path, const std::string &key, GLuint program){
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0){
+        return false;
+    }
+    std::vector<char> binary(length);
+    GLenum format;
+    glGetProgramBinary(program, length, &length, &format, &binary[0]);
+    if (length <= 0){
+        return false;
+    }
+
+    ProgramCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "PRGC", 4);
+    header.version = program_cache_version;
+    header.key_length = key.size();
+    header.binary_format = format;
+    header.binary_length = length;
+
+    std::ofstream file(path.c_str(), std::ios::binary);
+    if (!file){
+        return false;
+    }
+    file.write((const char *) &header, sizeof(header));
+    file.write(key.c_str(), key.size());
+    file.write(&binary[0], length);
+    return file.good();
+}
+
+
+GLuint ProgramCache::Load(const std::string &path, const std::string &key){
+
+    MappedFile file;
+    if (!file.Open(path.c_str())){
+        return 0;
+    }
+    const char *data = file.GetData();
+    size_t size = file.GetSize();
+
+    if (size < sizeof(ProgramCacheHeader)){
+        return 0;
+    }
+    const ProgramCacheHeader *header = (const ProgramCacheHeader *) data;
+    if (memcmp(header->magic, "PRGC", 4) != 0 || header->version != program_cache_version){
+        return 0;
+    }
+    if (sizeof(ProgramCacheHeader) + (size_t) header->key_length + header->binary_length > size || header->key_length != key.size() ||
+        memcmp(data + sizeof(ProgramCacheHeader), key.c_str(), key.size()) != 0){
+        return 0;
+    }
+
+    // Drivers refuse binaries they did not make, or no longer accept
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header->binary_format, data + sizeof(ProgramCacheHeader) + header->key_length, header->binary_length);
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE){
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+} // namespace game
@@ -0,0 +1,40 @@
+#ifndef PROGRAM_CACHE_H_
+#define PROGRAM_CACHE_H_
+
+#include <string>
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+namespace game {
+
+    // Start of a program cache file. It is followed by the key, then the
+    // binary of the program
+    struct ProgramCacheHeader {
+        char magic[4]; // "PRGC"
+        GLuint version;
+        GLuint key_length; // Bytes of the key that follows the header
+        GLenum binary_format; // As returned by glGetProgramBinary
+        GLuint binary_length;
+    };
+
+    // Binary file holding a linked shader program as the driver returns
+    // it, so loading it skips compiling and linking. The key names the
+    // sources and the driver; binaries of another driver, or another
+    // version of it, are rejected by the key or by glProgramBinary
+    class ProgramCache {
+
+        public:
+            // Write the binary of a program linked with
+            // GL_PROGRAM_BINARY_RETRIEVABLE_HINT. Returns false if the
+            // driver has none or the file cannot be written
+            static bool Write(const std::string &path, const std::string &key, GLuint program);
+
+            // Create a program from a cache file; 0 if it is missing,
+            // damaged, made for another key, or refused by the driver
+            static GLuint Load(const std::string &path, const std::string &key);
+
+    }; // class ProgramCache
+
+} // namespace game
+
+#endif // PROGRAM_CACHE_H_
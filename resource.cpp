@@ -1,14 +1,26 @@
 #include <exception>
 
 #include "resource.h"
+#include "resource_table.h"
 
 namespace game {
 
+// Ticks handed out to references, shared by every resource
+static unsigned long long use_tick = 0;
+
+
 Resource::Resource(ResourceType type, std::string name, GLuint resource, GLsizei size){
     type_ = type;
     name_ = name;
     resource_ = resource;
     size_ = size;
+    index_type_ = GL_UNSIGNED_INT;
+    vertex_format_ = &StandardVertex::Format();
+    has_bounds_ = false;
+    references_ = 0;
+    last_use_ = 0;
+    byte_size_ = 0;
+    handle_ = NO_RESOURCE;
 }
 
 
@@ -18,6 +30,13 @@ Resource::Resource(ResourceType type, std::string name, GLuint array_buffer, GLu
     array_buffer_ = array_buffer;
     element_array_buffer_ = element_array_buffer;
     size_ = size;
+    index_type_ = GL_UNSIGNED_INT;
+    vertex_format_ = &StandardVertex::Format();
+    has_bounds_ = false;
+    references_ = 0;
+    last_use_ = 0;
+    byte_size_ = 0;
+    handle_ = NO_RESOURCE;
 }
 
 
@@ -44,6 +63,12 @@ GLuint Resource::GetResource(void) const {
 }
 
 
+void Resource::SetResource(GLuint resource){
+
+    resource_ = resource;
+}
+
+
 GLuint Resource::GetArrayBuffer(void) const {
 
     return array_buffer_;
@@ -61,4 +86,179 @@ GLsizei Resource::GetSize(void) const {
     return size_;
 }
 
+
+GLenum Resource::GetIndexType(void) const {
+
+    return index_type_;
+}
+
+
+void Resource::SetIndexType(GLenum index_type){
+
+    index_type_ = index_type;
+}
+
+
+const VertexFormat &Resource::GetVertexFormat(void) const {
+
+    return *vertex_format_;
+}
+
+
+void Resource::SetVertexFormat(const VertexFormat &format){
+
+    vertex_format_ = &format;
+}
+
+
+void Resource::SetBounds(glm::vec3 min, glm::vec3 max, glm::vec3 center, float radius){
+
+    bounds_min_ = min;
+    bounds_max_ = max;
+    bounds_center_ = center;
+    bounds_radius_ = radius;
+    has_bounds_ = true;
+}
+
+
+bool Resource::HasBounds(void) const {
+
+    return has_bounds_;
+}
+
+
+glm::vec3 Resource::GetBoundsMin(void) const {
+
+    return bounds_min_;
+}
+
+
+glm::vec3 Resource::GetBoundsMax(void) const {
+
+    return bounds_max_;
+}
+
+
+glm::vec3 Resource::GetBoundsCenter(void) const {
+
+    return bounds_center_;
+}
+
+
+float Resource::GetBoundsRadius(void) const {
+
+    return bounds_radius_;
+}
+
+
+void Resource::AddLod(Resource *lod){
+
+    lod_.push_back(lod);
+}
+
+
+int Resource::GetLodCount(void) const {
+
+    return (int) lod_.size() + 1;
+}
+
+
+const Resource *Resource::GetLod(int level) const {
+
+    if (level <= 0){
+        return this;
+    }
+    if (level > lod_.size()){
+        level = (int) lod_.size();
+    }
+    return lod_[level - 1];
+}
+
+
+void Resource::AddReference(void) const {
+
+    references_++;
+    last_use_ = ++use_tick;
+}
+
+
+void Resource::RemoveReference(void) const {
+
+    references_--;
+    last_use_ = ++use_tick;
+}
+
+
+int Resource::GetReferenceCount(void) const {
+
+    return references_;
+}
+
+
+unsigned long long Resource::GetLastUse(void) const {
+
+    return last_use_;
+}
+
+
+void Resource::SetByteSize(size_t bytes){
+
+    byte_size_ = bytes;
+}
+
+
+size_t Resource::GetByteSize(void) const {
+
+    return byte_size_;
+}
+
+
+void Resource::SetSource(const std::string source){
+
+    source_ = source;
+}
+
+
+const std::string &Resource::GetSource(void) const {
+
+    return source_;
+}
+
+
+void Resource::DeleteObjects(void){
+
+    if (type_ == Material){
+        glDeleteProgram(resource_);
+        resource_ = 0;
+    } else if (type_ == Texture){
+        glDeleteTextures(1, &resource_);
+        resource_ = 0;
+    } else {
+        glDeleteBuffers(1, &array_buffer_);
+        glDeleteBuffers(1, &element_array_buffer_);
+        array_buffer_ = 0;
+        element_array_buffer_ = 0;
+    }
+    byte_size_ = 0;
+}
+
+
+ResourceHandle Resource::GetHandle(void) const {
+
+    return handle_;
+}
+
+
+void Resource::SetHandle(ResourceHandle handle){
+
+    handle_ = handle;
+}
+
+
+ResourceTable &Resource::GetTable(void){
+
+    static ResourceTable table;
+    return table;
+}
+
 } // namespace game
@@ -2,15 +2,31 @@
 #define RESOURCE_H_
 
 #include <string>
+#include <vector>
 #define GLEW_STATIC
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include "vertex_layout.h"
 
 namespace game {
 
     // Possible resource types
     typedef enum Type { Material, PointSet, Mesh, Texture } ResourceType;
 
+    class ResourceTable;
+
+    // Slot of a resource in the resource table, and the generation of the
+    // slot when the resource was put in it
+    struct ResourceHandle {
+        int slot;
+        unsigned int generation;
+    };
+
+    // Handle value that refers to no resource
+    const ResourceHandle NO_RESOURCE = { -1, 0 };
+
     // Class that holds one resource
     class Resource {
 
@@ -27,6 +43,19 @@ namespace game {
                 };
             };
             GLsizei size_; // Number of primitives in geometry
+            GLenum index_type_; // Type of the element array: GL_UNSIGNED_INT or GL_UNSIGNED_SHORT
+            const VertexFormat *vertex_format_; // Layout of the array buffer
+            bool has_bounds_; // Whether the bounds below are known
+            glm::vec3 bounds_min_; // Axis-aligned bounding box in model space
+            glm::vec3 bounds_max_;
+            glm::vec3 bounds_center_; // Bounding sphere in model space
+            float bounds_radius_;
+            std::vector<Resource *> lod_; // Coarser levels of detail, finest first
+            mutable int references_; // Users holding the resource
+            mutable unsigned long long last_use_; // Tick of the last reference, 0 if never referenced
+            size_t byte_size_; // GPU memory of its buffers or texture
+            std::string source_; // File to load it from again, if any
+            ResourceHandle handle_; // Where the table holds it
 
         public:
             Resource(ResourceType type, std::string name, GLuint resource, GLsizei size);
@@ -35,9 +64,61 @@ namespace game {
             ResourceType GetType(void) const;
             const std::string GetName(void) const;
             GLuint GetResource(void) const;
+            // Set the handle of a resource created before it finished
+            // loading, such as a texture decoded in the background
+            void SetResource(GLuint resource);
             GLuint GetArrayBuffer(void) const;
             GLuint GetElementArrayBuffer(void) const;
             GLsizei GetSize(void) const;
+            GLenum GetIndexType(void) const;
+            void SetIndexType(GLenum index_type);
+            // Layout of the vertices; StandardVertex unless set otherwise
+            const VertexFormat &GetVertexFormat(void) const;
+            void SetVertexFormat(const VertexFormat &format);
+
+            // Model-space bounds of geometry; point sets animated in the
+            // shader have none
+            void SetBounds(glm::vec3 min, glm::vec3 max, glm::vec3 center, float radius);
+            bool HasBounds(void) const;
+            glm::vec3 GetBoundsMin(void) const;
+            glm::vec3 GetBoundsMax(void) const;
+            glm::vec3 GetBoundsCenter(void) const;
+            float GetBoundsRadius(void) const;
+
+            // Levels of detail of a mesh: level 0 is the resource itself,
+            // higher levels are coarser
+            void AddLod(Resource *lod);
+            int GetLodCount(void) const;
+            const Resource *GetLod(int level) const;
+
+            // Reference counting: users keeping the resource, like scene
+            // nodes, hold a reference while they draw it. The count of a
+            // const resource changes too, as it is not part of its value
+            void AddReference(void) const;
+            void RemoveReference(void) const;
+            int GetReferenceCount(void) const;
+            // Order of the last reference added or removed, to evict the
+            // least recently used resources first; 0 if never referenced
+            unsigned long long GetLastUse(void) const;
+
+            // Bytes of GPU memory held by the buffers or texture
+            void SetByteSize(size_t bytes);
+            size_t GetByteSize(void) const;
+            // File the resource was loaded from, to load it again once
+            // evicted; empty for generated resources
+            void SetSource(const std::string source);
+            const std::string &GetSource(void) const;
+            // Delete the OpenGL objects of the resource, which keeps its
+            // name and can be given new ones
+            void DeleteObjects(void);
+
+            // Handle of the resource in the table, NO_RESOURCE if it is
+            // not in it
+            ResourceHandle GetHandle(void) const;
+            void SetHandle(ResourceHandle handle);
+            // Table holding every resource, where scene nodes resolve the
+            // handles they keep
+            static ResourceTable &GetTable(void);
 
     }; // class Resource
 
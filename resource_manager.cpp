@@ -1,43 +1,334 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 #include <stdexcept>
+#include <string.h>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
 #include <SOIL/SOIL.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
 
 #include "resource_manager.h"
 #include "model_loader.h"
+#include "mesh_simplify.h"
+#include "mesh_optimize.h"
+#include "obj_loader.h"
+#include "mesh_cache.h"
+#include "glb_loader.h"
+#include "ktx_texture.h"
+#include "texture_cache.h"
+#include "program_cache.h"
+#include "mapped_file.h"
 #include "path_config.h"
 
 
 namespace game {
 
+// Revision of the shape generators, part of every geometry cache key.
+// Generated meshes have no source file to compare times with, so bump it
+// whenever a Build function changes the vertices it produces
+static const int generator_revision = 1;
+
 ResourceManager::ResourceManager(void){
+
+    lod_levels_ = 4;
+    print_stats_ = false;
+    decoding_texture_num_ = 0;
+    uploading_texture_num_ = 0;
+    parallel_compile_set_ = false;
+    memory_budget_ = 0;
+    unmanaged_memory_ = 0;
 }
 
 
 ResourceManager::~ResourceManager(){
+
+    // Their OpenGL objects go with the context, or with DeleteObjects
+    ResourceTable &table = Resource::GetTable();
+    for (int i = 0; i < table.GetSize(); i++){
+        Resource *res = table.GetSlot(i);
+        if (res){
+            table.Remove(res->GetHandle());
+            delete res;
+        }
+    }
 }
 
 
-void ResourceManager::AddResource(ResourceType type, const std::string name, GLuint resource, GLsizei size){
+Resource *ResourceManager::AddResource(ResourceType type, const std::string name, GLuint resource, GLsizei size){
 
     Resource *res;
 
     res = new Resource(type, name, resource, size);
 
-    resource_.push_back(res);
+    Resource::GetTable().Add(res);
+
+    return res;
 }
 
 
-void ResourceManager::AddResource(ResourceType type, const std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size){
+Resource *ResourceManager::AddResource(ResourceType type, const std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size){
 
     Resource *res;
 
     res = new Resource(type, name, array_buffer, element_array_buffer, size);
+    res->SetByteSize(GetBufferSize(array_buffer) + GetBufferSize(element_array_buffer));
+
+    Resource::GetTable().Add(res);
+
+    return res;
+}
+
+
+void ResourceManager::SetLodLevels(int levels){
+
+    lod_levels_ = levels;
+}
+
+
+void ResourceManager::SetPrintStats(bool print){
+
+    print_stats_ = print;
+}
+
+
+void ResourceManager::SetCacheDirectory(const std::string directory){
+
+    cache_directory_ = directory;
+    if (!directory.empty()){
+        // Fails harmlessly when the directory exists
+#ifdef _WIN32
+        _mkdir(directory.c_str());
+#else
+        mkdir(directory.c_str(), 0755);
+#endif
+    }
+}
+
+
+void ResourceManager::SetResourcePack(const std::string filename, const std::string root){
+
+    // Files are read from disk when it cannot be opened
+    pack_root_ = ResourcePack::NormalizeName(root + "/");
+    pack_.Open(filename.c_str());
+}
+
+
+bool ResourceManager::FindPackedFile(const std::string filename, const char *&data, size_t &size) const {
+
+    // Packed names are relative to the root
+    std::string name = ResourcePack::NormalizeName(filename);
+    unsigned long long source_time;
+    if (!pack_.IsOpen() || name.compare(0, pack_root_.size(), pack_root_) != 0 ||
+        !pack_.Find(name.substr(pack_root_.size()), data, size, source_time)){
+        return false;
+    }
+
+    // A loose file edited since the pack was built wins over its packed
+    // copy; without the loose file, the pack is all there is
+    struct stat loose;
+    if (stat(filename.c_str(), &loose) == 0 && ((unsigned long long) loose.st_mtime != source_time || (size_t) loose.st_size != size)){
+        return false;
+    }
+    return true;
+}
+
+
+std::string ResourceManager::LodName(const std::string name, int level){
+
+    return name + "_LOD" + num_to_str<int>(level);
+}
+
+
+std::string ResourceManager::GeometryKey(const std::string generator, std::initializer_list<float> params, const VertexFormat &format) const {
+
+    std::stringstream ss;
+    ss.precision(9);
+    ss << generator << "(";
+    for (std::initializer_list<float>::const_iterator it = params.begin(); it != params.end(); it++){
+        ss << ((it == params.begin()) ? "" : ",") << *it;
+    }
+    ss << ")";
+
+    // The same shape in another layout is another mesh
+    for (int i = 0; i < format.attribute_count; i++){
+        const VertexAttribute &a = format.attribute[i];
+        ss << " " << a.semantic << ":" << a.components << ":" << std::hex << a.type << std::dec << ":" << (int) a.normalized;
+    }
+    ss << " lod" << lod_levels_ << " rev" << generator_revision;
+    return ss.str();
+}
+
+
+std::string ResourceManager::CachePath(const std::string key, const char *extension) const {
+
+    // 64-bit FNV-1a hash of the key
+    unsigned long long hash = 14695981039346656037ULL;
+    for (int i = 0; i < key.size(); i++){
+        hash = (hash ^ (unsigned char) key[i]) * 1099511628211ULL;
+    }
+    std::stringstream ss;
+    ss << cache_directory_ << "/" << std::hex << hash << extension;
+    return ss.str();
+}
+
+
+Resource *ResourceManager::FindGeometry(const std::string key, const std::string name){
+
+    std::map<std::string, Resource *>::iterator it = geometry_cache_.find(key);
+    if (it == geometry_cache_.end()){
+        return NULL;
+    }
+
+    // The new name shares the resource, buffers and levels of detail
+    if (it->second->GetName() != name){
+        Resource::GetTable().AddName(name, it->second->GetHandle());
+    }
+    return it->second;
+}
+
+
+Resource *ResourceManager::LoadCachedMesh(const std::string key, const std::string name, const VertexFormat &format, unsigned long long source_time, unsigned long long source_size){
+
+    if (cache_directory_.empty()){
+        return NULL;
+    }
+
+    // Anything unexpected is a miss, and the mesh is built again
+    MeshCache cache;
+    if (!cache.Open(CachePath(key, ".mesh"), key, source_time, source_size, format)){
+        return NULL;
+    }
+
+    // Buffers are filled straight from the mapped file
+    Resource *res = NULL;
+    for (int level = 0; level < cache.GetLevelCount(); level++){
+        const MeshCacheLevel &info = cache.GetLevel(level);
+        GLuint vbo, ebo;
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, info.vertex_bytes, cache.GetVertices(level), GL_STATIC_DRAW);
+        glGenBuffers(1, &ebo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, cache.GetIndexBytes(level), cache.GetIndices(level), GL_STATIC_DRAW);
+
+        Resource *lod = AddResource(Mesh, (level == 0) ? name : LodName(name, level), vbo, ebo, info.index_count);
+        lod->SetIndexType(info.index_type);
+        lod->SetVertexFormat(format);
+        const GLfloat *b = info.bounds;
+        lod->SetBounds(glm::vec3(b[0], b[1], b[2]), glm::vec3(b[3], b[4], b[5]), glm::vec3(b[6], b[7], b[8]), b[9]);
+        if (level == 0){
+            res = lod;
+        } else {
+            res->AddLod(lod);
+        }
+    }
+
+    return res;
+}
+
+
+void ResourceManager::SaveCachedMesh(const std::string key, const Resource *res, unsigned long long source_time, unsigned long long source_size){
+
+    // A cache that cannot be written only costs the next launch some time
+    if (!cache_directory_.empty()){
+        // The mesh is read back from its buffers, which need their data
+        upload_.Flush();
+        MeshCache::Write(CachePath(key, ".mesh"), key, source_time, source_size, res);
+    }
+}
+
+
+void ResourceManager::ComputeBounds(Resource *res, const GLfloat *vertex, int vertex_num, int vertex_att){
+
+    if (vertex_num <= 0){
+        return;
+    }
+
+    // Axis-aligned box first, then the smallest sphere around its center
+    // that still holds every vertex
+    glm::vec3 min(vertex[0], vertex[1], vertex[2]);
+    glm::vec3 max = min;
+    for (int i = 1; i < vertex_num; i++){
+        glm::vec3 p(vertex[i*vertex_att], vertex[i*vertex_att + 1], vertex[i*vertex_att + 2]);
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+    glm::vec3 center = (min + max) * 0.5f;
+    float radius2 = 0.0f;
+    for (int i = 0; i < vertex_num; i++){
+        glm::vec3 d = glm::vec3(vertex[i*vertex_att], vertex[i*vertex_att + 1], vertex[i*vertex_att + 2]) - center;
+        if (glm::dot(d, d) > radius2){
+            radius2 = glm::dot(d, d);
+        }
+    }
+
+    res->SetBounds(min, max, center, sqrt(radius2));
+}
+
+
+Resource *ResourceManager::UploadIndexedMesh(const std::string name, std::vector<VertexData> &vertex, GLuint *index, int index_num, const VertexFormat &format){
+
+    // Generators emit triangles row by row, which reuses few vertices
+    // from the post-transform cache
+    int vertex_num = (int) vertex.size();
+    float acmr_before = print_stats_ ? ComputeAcmr(index, index_num) : 0.0f;
+    OptimizeVertexCache(index, index_num, vertex_num);
+    vertex_num = OptimizeVertexFetch(&vertex[0], sizeof(VertexData), index, index_num, vertex_num);
+    vertex.resize(vertex_num);
+    if (print_stats_){
+        std::cout << "Mesh " << name << ": " << index_num / 3 << " triangles, ACMR "
+                  << acmr_before << " -> " << ComputeAcmr(index, index_num) << std::endl;
+    }
+
+    return UploadVertices(name, &vertex[0], vertex_num, index, index_num, format);
+}
+
+
+Resource *ResourceManager::UploadVertices(const std::string name, const VertexData *vertex, int vertex_num, const GLuint *index, int index_num, const VertexFormat &format){
+
+    // Pack the vertices into the layout of the mesh
+    std::vector<GLubyte> packed(vertex_num * format.stride);
+    for (int i = 0; i < vertex_num; i++){
+        format.pack(vertex[i], &packed[i * format.stride]);
+    }
+
+    // Allocate the buffers here; their data follows through the queue
+    GLuint vbo, ebo;
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, packed.size(), NULL, GL_STATIC_DRAW);
+    upload_.UploadBuffer(vbo, 0, packed);
+
+    // Half the index memory and bandwidth for meshes under 65536 vertices
+    GLenum index_type = GL_UNSIGNED_INT;
+    std::vector<GLubyte> index_data;
+    if (vertex_num <= 65536){
+        index_type = GL_UNSIGNED_SHORT;
+        index_data.resize(index_num * sizeof(GLushort));
+        for (int i = 0; i < index_num; i++){
+            GLushort short_index = (GLushort) index[i];
+            memcpy(&index_data[i * sizeof(GLushort)], &short_index, sizeof(GLushort));
+        }
+    } else {
+        index_data.assign((const GLubyte *) index, (const GLubyte *) (index + index_num));
+    }
+    glGenBuffers(1, &ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_data.size(), NULL, GL_STATIC_DRAW);
+    upload_.UploadBuffer(ebo, 0, index_data);
+
+    // Create resource
+    Resource *res = AddResource(Mesh, name, vbo, ebo, index_num);
+    res->SetIndexType(index_type);
+    res->SetVertexFormat(format);
+    ComputeBounds(res, &vertex[0].position.x, vertex_num, sizeof(VertexData) / sizeof(GLfloat));
 
-    resource_.push_back(res);
+    return res;
 }
 
 
@@ -49,22 +340,167 @@ void ResourceManager::LoadResource(ResourceType type, const std::string name, co
     } else if (type == Texture){
         LoadTexture(name, filename);
     } else if (type == Mesh){
-        LoadMesh(name, filename);
+        std::string file(filename);
+        if (file.size() >= 4 && file.compare(file.size() - 4, 4, ".glb") == 0){
+            LoadModel(name, filename);
+        } else {
+            LoadMesh(name, filename);
+        }
     } else {
         throw(std::invalid_argument(std::string("Invalid type of resource")));
     }
 }
 
 
-Resource *ResourceManager::GetResource(const std::string name) const {
+Resource *ResourceManager::GetResource(const std::string &name){
+
+    return GetResource(Resource::GetTable().Find(name));
+}
+
+
+Resource *ResourceManager::GetResource(ResourceHandle handle){
 
-    // Find resource with the specified name
-    for (int i = 0; i < resource_.size(); i++){
-        if (resource_[i]->GetName() == name){
-            return resource_[i];
+    Resource *res = Resource::GetTable().Get(handle);
+    if (res && evicted_.erase(res)){
+        StartTextureLoad(res, res->GetSource().c_str());
+    }
+    return res;
+}
+
+
+ResourceHandle ResourceManager::GetHandle(const std::string &name) const {
+
+    return Resource::GetTable().Find(name);
+}
+
+
+bool ResourceManager::RemoveResource(ResourceHandle handle){
+
+    Resource *res = Resource::GetTable().Get(handle);
+    if (!res || res->GetReferenceCount() > 0){
+        return false;
+    }
+
+    // Generated meshes asked for again are made anew
+    for (std::map<std::string, Resource *>::iterator it = geometry_cache_.begin(); it != geometry_cache_.end(); ){
+        if (it->second == res){
+            geometry_cache_.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+    evicted_.erase(res);
+
+    // Levels of detail belong to the mesh
+    for (int level = 1; level < res->GetLodCount(); level++){
+        Resource *lod = const_cast<Resource *>(res->GetLod(level));
+        Resource::GetTable().Remove(lod->GetHandle());
+        lod->DeleteObjects();
+        delete lod;
+    }
+    Resource::GetTable().Remove(handle);
+    res->DeleteObjects();
+    delete res;
+    return true;
+}
+
+
+void ResourceManager::SetMemoryBudget(size_t bytes){
+
+    memory_budget_ = bytes;
+}
+
+
+size_t ResourceManager::GetMemoryBudget(void) const {
+
+    return memory_budget_;
+}
+
+
+size_t ResourceManager::GetMemoryUsed(void) const {
+
+    ResourceTable &table = Resource::GetTable();
+    size_t used = unmanaged_memory_ + upload_.GetMemoryUsed();
+    for (int i = 0; i < table.GetSize(); i++){
+        if (table.GetSlot(i)){
+            used += table.GetSlot(i)->GetByteSize();
+        }
+    }
+    return used;
+}
+
+
+void ResourceManager::SetUnmanagedMemory(size_t bytes){
+
+    unmanaged_memory_ = bytes;
+}
+
+
+int ResourceManager::TrimMemory(void){
+
+    size_t used = GetMemoryUsed();
+    if (memory_budget_ == 0 || used <= memory_budget_){
+        return 0;
+    }
+
+    // Textures that can be loaded again, uploaded, and released by the
+    // last of their users
+    ResourceTable &table = Resource::GetTable();
+    std::vector<Resource *> candidate;
+    for (int i = 0; i < table.GetSize(); i++){
+        Resource *res = table.GetSlot(i);
+        if (res && res->GetType() == Texture && !res->GetSource().empty() && res->GetResource() != 0 &&
+            res->GetReferenceCount() == 0 && res->GetLastUse() > 0){
+            candidate.push_back(res);
+        }
+    }
+    std::sort(candidate.begin(), candidate.end(), [](const Resource *a, const Resource *b){
+        return a->GetLastUse() < b->GetLastUse();
+    });
+
+    int evicted = 0;
+    for (int i = 0; i < candidate.size() && used > memory_budget_; i++){
+        used -= candidate[i]->GetByteSize();
+        candidate[i]->DeleteObjects();
+        evicted_.insert(candidate[i]);
+        evicted++;
+    }
+    return evicted;
+}
+
+
+void ResourceManager::DeleteObjects(void){
+
+    ResourceTable &table = Resource::GetTable();
+    for (int i = 0; i < table.GetSize(); i++){
+        if (table.GetSlot(i)){
+            table.GetSlot(i)->DeleteObjects();
         }
     }
-    return NULL;
+    evicted_.clear();
+}
+
+
+size_t ResourceManager::GetBufferSize(GLuint buffer){
+
+    if (buffer == 0){
+        return 0;
+    }
+    // Bound where no vertex array or draw looks
+    GLint size = 0;
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+    return (size_t) size;
+}
+
+
+const Model *ResourceManager::GetModel(const std::string name) const {
+
+    std::map<std::string, Model>::const_iterator it = model_.find(name);
+    if (it == model_.end()){
+        return NULL;
+    }
+    return &it->second;
 }
 
 void ResourceManager::LoadMaterial(const std::string name, const char *prefix){
@@ -77,92 +513,148 @@ void ResourceManager::LoadMaterial(const std::string name, const char *prefix){
     filename = std::string(prefix) + std::string(FRAGMENT_PROGRAM_EXTENSION);
     std::string fp = LoadTextFile(filename.c_str());
 
-    // Create a shader from the vertex program source code
-    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-    const char *source_vp = vp.c_str();
-    glShaderSource(vs, 1, &source_vp, NULL);
-    glCompileShader(vs);
-
-    // Check if shader compiled successfully
-    GLint status;
-    glGetShaderiv(vs, GL_COMPILE_STATUS, &status);
-    if (status != GL_TRUE){
-        char buffer[512];
-        glGetShaderInfoLog(vs, 512, NULL, buffer);
-        throw(std::ios_base::failure(std::string("Error compiling vertex shader: ")+std::string(buffer)));
-    }
-
-    // Create a shader from the fragment program source code
-    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-    const char *source_fp = fp.c_str();
-    glShaderSource(fs, 1, &source_fp, NULL);
-    glCompileShader(fs);
-
-    // Check if shader compiled successfully
-    glGetShaderiv(fs, GL_COMPILE_STATUS, &status);
-    if (status != GL_TRUE){
-        char buffer[512];
-        glGetShaderInfoLog(fs, 512, NULL, buffer);
-        throw(std::ios_base::failure(std::string("Error compiling fragment shader: ")+std::string(buffer)));
-    }
-
     // Try to also load a geometry shader
     filename = std::string(prefix) + std::string(GEOMETRY_PROGRAM_EXTENSION);
-    bool geometry_program = false;
     std::string gp = "";
-    GLuint gs;
     try {
         gp = LoadTextFile(filename.c_str());
-        geometry_program = true;
     }
         catch(std::exception &e){
     }
 
-    if (geometry_program){
-        // Create a shader from the geometry program source code
-        gs = glCreateShader(GL_GEOMETRY_SHADER);
-        const char *source_gp = gp.c_str();
-        glShaderSource(gs, 1, &source_gp, NULL);
-        glCompileShader(gs);
-
-        // Check if shader compiled successfully
-        GLint status;
-        glGetShaderiv(gs, GL_COMPILE_STATUS, &status);
-        if (status != GL_TRUE){
-            char buffer[512];
-            glGetShaderInfoLog(gs, 512, NULL, buffer);
-            throw(std::ios_base::failure(std::string("Error compiling geometry shader: ")+std::string(buffer)));
+    CreateMaterial(name, vp, fp, gp);
+}
+
+
+Resource *ResourceManager::CreateMaterial(const std::string name, const std::string vp, const std::string fp, const std::string gp){
+
+    // Add a resource for the shader program
+    return AddResource(Material, name, BuildProgram(name, vp, fp, gp), 0);
+}
+
+
+int ResourceManager::UpdateMaterialLoads(void){
+
+    std::string error;
+    for (int i = 0; i < pending_program_.size(); ){
+        // Without parallel compilation checking waits for the driver
+        if (!GLEW_KHR_parallel_shader_compile){
+            CheckProgram(pending_program_[i], error);
+            pending_program_.erase(pending_program_.begin() + i);
+            break;
+        }
+        GLint done = GL_FALSE;
+        glGetProgramiv(pending_program_[i].program, GL_COMPLETION_STATUS_KHR, &done);
+        if (done){
+            CheckProgram(pending_program_[i], error);
+            pending_program_.erase(pending_program_.begin() + i);
+        } else {
+            i++;
         }
     }
 
+    if (!error.empty()){
+        throw(std::ios_base::failure(error));
+    }
+    return (int) pending_program_.size();
+}
+
+
+GLuint ResourceManager::CompileShader(GLenum type, const std::string &source){
+
+    // The status is checked with the program, once every shader is
+    // submitted
+    GLuint shader = glCreateShader(type);
+    const char *source_code = source.c_str();
+    glShaderSource(shader, 1, &source_code, NULL);
+    glCompileShader(shader);
+    return shader;
+}
+
+
+GLuint ResourceManager::BuildProgram(const std::string name, const std::string &vp, const std::string &fp, const std::string &gp){
+
+    // Let the driver compile on as many threads as it likes
+    if (!parallel_compile_set_){
+        if (GLEW_KHR_parallel_shader_compile){
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        }
+        parallel_compile_set_ = true;
+    }
+
+    // Programs linked by the same driver at an earlier launch. The key
+    // holds the sources and the driver, and names the file by its hash
+    PendingProgram pending;
+    pending.name = name;
+    if (!cache_directory_.empty() && GLEW_ARB_get_program_binary){
+        std::stringstream ss;
+        ss << "Program\n" << (const char *) glGetString(GL_VENDOR) << "\n" << (const char *) glGetString(GL_RENDERER) << "\n" << (const char *) glGetString(GL_VERSION) << "\n";
+        pending.key = ss.str() + vp + std::string(1, '\0') + fp + std::string(1, '\0') + gp;
+        pending.path = CachePath(pending.key, ".prog");
+        GLuint program = ProgramCache::Load(pending.path, pending.key);
+        if (program){
+            return program;
+        }
+    }
+
+    pending.shader[0] = CompileShader(GL_VERTEX_SHADER, vp);
+    pending.shader[1] = CompileShader(GL_FRAGMENT_SHADER, fp);
+    pending.shader[2] = gp.empty() ? 0 : CompileShader(GL_GEOMETRY_SHADER, gp);
+
     // Create a shader program linking both vertex and fragment shaders
-    // together
+    // together; the handle is usable right away, and the driver waits
+    // for the link if it is drawn with before UpdateMaterialLoads
     GLuint sp = glCreateProgram();
-    glAttachShader(sp, vs);
-    glAttachShader(sp, fs);
-    if (geometry_program){
-        glAttachShader(sp, gs);
+    for (int i = 0; i < 3; i++){
+        if (pending.shader[i]){
+            glAttachShader(sp, pending.shader[i]);
+        }
+    }
+    if (!pending.path.empty()){
+        glProgramParameteri(sp, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     }
     glLinkProgram(sp);
+    pending.program = sp;
+    pending_program_.push_back(pending);
+    return sp;
+}
+
+
+void ResourceManager::CheckProgram(const PendingProgram &pending, std::string &error){
 
-    // Check if shaders were linked successfully
-    glGetProgramiv(sp, GL_LINK_STATUS, &status);
-    if (status != GL_TRUE){
+    GLint status;
+    glGetProgramiv(pending.program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE && error.empty()){
+        // A shader that did not compile explains the failed link best
+        static const char *stage[3] = { "vertex", "fragment", "geometry" };
         char buffer[512];
-        glGetShaderInfoLog(sp, 512, NULL, buffer);
-        throw(std::ios_base::failure(std::string("Error linking shaders burh: ")+std::string(buffer)));
+        for (int i = 0; i < 3 && error.empty(); i++){
+            if (!pending.shader[i]){
+                continue;
+            }
+            glGetShaderiv(pending.shader[i], GL_COMPILE_STATUS, &status);
+            if (status != GL_TRUE){
+                glGetShaderInfoLog(pending.shader[i], 512, NULL, buffer);
+                error = std::string("Error compiling ")+std::string(stage[i])+std::string(" shader of ")+pending.name+std::string(": ")+std::string(buffer);
+            }
+        }
+        if (error.empty()){
+            glGetProgramInfoLog(pending.program, 512, NULL, buffer);
+            error = std::string("Error linking shaders of ")+pending.name+std::string(": ")+std::string(buffer);
+        }
+    } else if (status == GL_TRUE && !pending.path.empty()){
+        // A cache that cannot be written only costs the next launch some
+        // time
+        ProgramCache::Write(pending.path, pending.key, pending.program);
     }
 
     // Delete memory used by shaders, since they were already compiled
     // and linked
-    glDeleteShader(vs);
-    glDeleteShader(fs);
-    if (geometry_program){
-        glDeleteShader(gs);
+    for (int i = 0; i < 3; i++){
+        if (pending.shader[i]){
+            glDeleteShader(pending.shader[i]);
+        }
     }
-
-    // Add a resource for the shader program
-    AddResource(Material, name, sp, 0);
 }
 
 // void ResourceManager::LoadMaterial(const std::string name, const char *prefix){
@@ -229,7 +721,13 @@ void ResourceManager::LoadMaterial(const std::string name, const char *prefix){
 // }
 
 
-std::string ResourceManager::LoadTextFile(const char *filename){
+std::string ResourceManager::LoadTextFile(const char *filename) const {
+
+    const char *data;
+    size_t size;
+    if (FindPackedFile(filename, data, size)){
+        return std::string(data, size);
+    }
 
     // Open file
     std::ifstream f;
@@ -252,27 +750,53 @@ std::string ResourceManager::LoadTextFile(const char *filename){
 }
 
 // Create the geometry for a cylinder
-void ResourceManager::CreateCylinder(std::string object_name, float height, float circle_radius, int num_height_samples, int num_circle_samples) {
+Resource *ResourceManager::CreateCylinder(std::string object_name, float height, float circle_radius, int num_height_samples, int num_circle_samples, const VertexFormat &format){
+
+    std::string key = GeometryKey("Cylinder", { height, circle_radius, (float) num_height_samples, (float) num_circle_samples }, format);
+    Resource *res = FindGeometry(key, object_name);
+    if (res){
+        return res;
+    }
+    res = LoadCachedMesh(key, object_name, format);
+    if (res){
+        geometry_cache_[key] = res;
+        return res;
+    }
+    res = BuildCylinder(object_name, height, circle_radius, num_height_samples, num_circle_samples, format);
+
+    // Coarser levels of detail halve the sample counts
+    for (int level = 1; level < lod_levels_; level++){
+        num_height_samples = (num_height_samples / 2 < 2) ? 2 : num_height_samples / 2;
+        num_circle_samples /= 2;
+        if (num_circle_samples < 6){
+            break;
+        }
+        res->AddLod(BuildCylinder(LodName(object_name, level), height, circle_radius, num_height_samples, num_circle_samples, format));
+    }
+
+    SaveCachedMesh(key, res);
+    geometry_cache_[key] = res;
+    return res;
+}
+
+
+Resource *ResourceManager::BuildCylinder(std::string object_name, float height, float circle_radius, int num_height_samples, int num_circle_samples, const VertexFormat &format) {
 
 	// Create a cylinder
 
 	// Number of vertices and faces to be created
 	const GLuint vertex_num = num_height_samples * num_circle_samples + 2; // plus two for top and bottom
-	const GLuint face_num = num_height_samples * (num_circle_samples - 1) * 2 + 2 * num_circle_samples; // two extra rings worth for top and bottom
+	const GLuint face_num = (num_height_samples - 1) * num_circle_samples * 2 + 2 * num_circle_samples; // two extra rings worth for top and bottom
 
 																										// Number of attributes for vertices and faces
-	const int vertex_att = 11;  // 11 attributes per vertex: 3D position (3), 3D normal (3), RGB color (3), 2D texture coordinates (2)
 	const int face_att = 3; // Vertex indices (3)
 
 							// Data buffers for the shape
-	GLfloat *vertex = NULL;
+	std::vector<VertexData> vertex(vertex_num);
 	GLuint *face = NULL;
 
-	GLuint vbo, ebo;
-
 	// Allocate memory for buffers
 	try {
-		vertex = new GLfloat[vertex_num * vertex_att];
 		face = new GLuint[face_num * face_att];
 	}
 	catch (std::exception &e) {
@@ -306,13 +830,7 @@ void ResourceManager::CreateCylinder(std::string object_name, float height, floa
 			vertex_coord = glm::vec2(s, t);
 
 			// Add vectors to the data buffer
-			for (int k = 0; k < 3; k++) {
-				vertex[(i*num_circle_samples + j)*vertex_att + k] = vertex_position[k];
-				vertex[(i*num_circle_samples + j)*vertex_att + k + 3] = vertex_normal[k];
-				vertex[(i*num_circle_samples + j)*vertex_att + k + 6] = vertex_color[k];
-			}
-			vertex[(i*num_circle_samples + j)*vertex_att + 9] = vertex_coord[0];
-			vertex[(i*num_circle_samples + j)*vertex_att + 10] = vertex_coord[1];
+			vertex[i*num_circle_samples + j] = { vertex_position, vertex_normal, vertex_color, vertex_coord };
 		}
 	}
 
@@ -324,26 +842,14 @@ void ResourceManager::CreateCylinder(std::string object_name, float height, floa
 	vertex_color = glm::vec3(1, 0.6, 0.4);
 	vertex_coord = glm::vec2(0, 0); // no good way to texture top and bottom
 
-	for (int k = 0; k < 3; k++) {
-		vertex[topvertex*vertex_att + k] = vertex_position[k];
-		vertex[topvertex*vertex_att + k + 3] = vertex_normal[k];
-		vertex[topvertex*vertex_att + k + 6] = vertex_color[k];
-	}
-	vertex[(topvertex)*vertex_att + 9] = vertex_coord[0];
-	vertex[(topvertex)*vertex_att + 10] = vertex_coord[1];
+	vertex[topvertex] = { vertex_position, vertex_normal, vertex_color, vertex_coord };
 
 	//================== bottom vertex
 	vertex_position = glm::vec3(0, (-0.5)*height, 0); // location of bottom middle of cylinder
 	vertex_normal = glm::vec3(0, -1, 0);
 	// leave the color and uv alone
 
-	for (int k = 0; k < 3; k++) {
-		vertex[bottomvertex*vertex_att + k] = vertex_position[k];
-		vertex[bottomvertex*vertex_att + k + 3] = vertex_normal[k];
-		vertex[bottomvertex*vertex_att + k + 6] = vertex_color[k];
-	}
-	vertex[(bottomvertex)*vertex_att + 9] = vertex_coord[0];
-	vertex[(bottomvertex)*vertex_att + 10] = vertex_coord[1];
+	vertex[bottomvertex] = { vertex_position, vertex_normal, vertex_color, vertex_coord };
 
 	//===================== end of vertices
 
@@ -389,27 +895,45 @@ void ResourceManager::CreateCylinder(std::string object_name, float height, floa
 		}
 	}
 
-	// Create OpenGL buffer for vertices
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, vertex_num * vertex_att * sizeof(GLfloat), vertex, GL_STATIC_DRAW);
-
-	// Create OpenGL buffer for faces
-	glGenBuffers(1, &ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, face_num * face_att * sizeof(GLuint), face, GL_STATIC_DRAW);
+	Resource *res = UploadIndexedMesh(object_name, vertex, face, face_num * face_att, format);
 
 	// Free data buffers
-	delete[] vertex;
 	delete[] face;
 
+	return res;
+}
+
+Resource *ResourceManager::CreateTorus(std::string object_name, float loop_radius, float circle_radius, int num_loop_samples, int num_circle_samples, const VertexFormat &format){
 
-	// Create resource
-	AddResource(Mesh, object_name, vbo, ebo, face_num * face_att);
+    std::string key = GeometryKey("Torus", { loop_radius, circle_radius, (float) num_loop_samples, (float) num_circle_samples }, format);
+    Resource *res = FindGeometry(key, object_name);
+    if (res){
+        return res;
+    }
+    res = LoadCachedMesh(key, object_name, format);
+    if (res){
+        geometry_cache_[key] = res;
+        return res;
+    }
+    res = BuildTorus(object_name, loop_radius, circle_radius, num_loop_samples, num_circle_samples, format);
+
+    // Coarser levels of detail halve the sample counts
+    for (int level = 1; level < lod_levels_; level++){
+        num_loop_samples /= 2;
+        num_circle_samples /= 2;
+        if (num_loop_samples < 8 || num_circle_samples < 4){
+            break;
+        }
+        res->AddLod(BuildTorus(LodName(object_name, level), loop_radius, circle_radius, num_loop_samples, num_circle_samples, format));
+    }
 
+    SaveCachedMesh(key, res);
+    geometry_cache_[key] = res;
+    return res;
 }
 
-void ResourceManager::CreateTorus(std::string object_name, float loop_radius, float circle_radius, int num_loop_samples, int num_circle_samples) {
+
+Resource *ResourceManager::BuildTorus(std::string object_name, float loop_radius, float circle_radius, int num_loop_samples, int num_circle_samples, const VertexFormat &format) {
 
 	// Create a torus
 	// The torus is built from a large loop with small circles around the loop
@@ -421,16 +945,14 @@ void ResourceManager::CreateTorus(std::string object_name, float loop_radius, fl
 	const GLuint face_num = num_loop_samples * num_circle_samples * 2;
 
 	// Number of attributes for vertices and faces
-	const int vertex_att = 11;
 	const int face_att = 3;
 
 	// Data buffers for the torus
-	GLfloat *vertex = NULL;
+	std::vector<VertexData> vertex(vertex_num);
 	GLuint *face = NULL;
 
 	// Allocate memory for buffers
 	try {
-		vertex = new GLfloat[vertex_num * vertex_att]; // 11 attributes per vertex: 3D position (3), 3D normal (3), RGB color (3), 2D texture coordinates (2)
 		face = new GLuint[face_num * face_att]; // 3 indices per face
 	}
 	catch (std::exception &e) {
@@ -466,13 +988,7 @@ void ResourceManager::CreateTorus(std::string object_name, float loop_radius, fl
 				phi / (2.0*glm::pi<GLfloat>()));
 
 			// Add vectors to the data buffer
-			for (int k = 0; k < 3; k++) {
-				vertex[(i*num_circle_samples + j)*vertex_att + k] = vertex_position[k];
-				vertex[(i*num_circle_samples + j)*vertex_att + k + 3] = vertex_normal[k];
-				vertex[(i*num_circle_samples + j)*vertex_att + k + 6] = vertex_color[k];
-			}
-			vertex[(i*num_circle_samples + j)*vertex_att + 9] = vertex_coord[0];
-			vertex[(i*num_circle_samples + j)*vertex_att + 10] = vertex_coord[1];
+			vertex[i*num_circle_samples + j] = { vertex_position, vertex_normal, vertex_color, vertex_coord };
 		}
 	}
 
@@ -499,25 +1015,46 @@ void ResourceManager::CreateTorus(std::string object_name, float loop_radius, fl
 	//glGenVertexArrays(1, &vao);
 	//glBindVertexArray(vao);
 
-	GLuint vbo, ebo;
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, vertex_num * vertex_att * sizeof(GLfloat), vertex, GL_STATIC_DRAW);
-
-	glGenBuffers(1, &ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, face_num * face_att * sizeof(GLuint), face, GL_STATIC_DRAW);
+	Resource *res = UploadIndexedMesh(object_name, vertex, face, face_num * face_att, format);
 
 	// Free data buffers
-	delete[] vertex;
 	delete[] face;
 
-	// Create resource
-	AddResource(Mesh, object_name, vbo, ebo, face_num * face_att);
+	return res;
+}
+
+
+Resource *ResourceManager::CreateSphere(std::string object_name, float radius, int num_samples_theta, int num_samples_phi, const VertexFormat &format){
+
+    std::string key = GeometryKey("Sphere", { radius, (float) num_samples_theta, (float) num_samples_phi }, format);
+    Resource *res = FindGeometry(key, object_name);
+    if (res){
+        return res;
+    }
+    res = LoadCachedMesh(key, object_name, format);
+    if (res){
+        geometry_cache_[key] = res;
+        return res;
+    }
+    res = BuildSphere(object_name, radius, num_samples_theta, num_samples_phi, format);
+
+    // Coarser levels of detail halve the sample counts
+    for (int level = 1; level < lod_levels_; level++){
+        num_samples_theta /= 2;
+        num_samples_phi /= 2;
+        if (num_samples_theta < 8 || num_samples_phi < 4){
+            break;
+        }
+        res->AddLod(BuildSphere(LodName(object_name, level), radius, num_samples_theta, num_samples_phi, format));
+    }
+
+    SaveCachedMesh(key, res);
+    geometry_cache_[key] = res;
+    return res;
 }
 
 
-void ResourceManager::CreateSphere(std::string object_name, float radius, int num_samples_theta, int num_samples_phi){
+Resource *ResourceManager::BuildSphere(std::string object_name, float radius, int num_samples_theta, int num_samples_phi, const VertexFormat &format){
 
     // Create a sphere using a well-known parameterization
 
@@ -526,16 +1063,14 @@ void ResourceManager::CreateSphere(std::string object_name, float radius, int nu
     const GLuint face_num = num_samples_theta*(num_samples_phi-1)*2;
 
     // Number of attributes for vertices and faces
-    const int vertex_att = 11;
     const int face_att = 3;
 
     // Data buffers 
-    GLfloat *vertex = NULL;
+    std::vector<VertexData> vertex(vertex_num);
     GLuint *face = NULL;
 
     // Allocate memory for buffers
     try {
-        vertex = new GLfloat[vertex_num * vertex_att]; // 11 attributes per vertex: 3D position (3), 3D normal (3), RGB color (3), 2D texture coordinates (2)
         face = new GLuint[face_num * face_att]; // 3 indices per face
     }
     catch  (std::exception &e){
@@ -568,13 +1103,7 @@ void ResourceManager::CreateSphere(std::string object_name, float radius, int nu
             vertex_coord = glm::vec2(static_cast<float>(i) / (num_samples_theta - 1), 0.5f + asin(sin(phi)) / glm::pi<GLfloat>());
 
             // Add vectors to the data buffer
-            for (int k = 0; k < 3; k++){
-                vertex[(i*num_samples_phi+j)*vertex_att + k] = vertex_position[k];
-                vertex[(i*num_samples_phi+j)*vertex_att + k + 3] = vertex_normal[k];
-                vertex[(i*num_samples_phi+j)*vertex_att + k + 6] = vertex_color[k];
-            }
-            vertex[(i*num_samples_phi+j)*vertex_att + 9] = vertex_coord[0];
-            vertex[(i*num_samples_phi+j)*vertex_att + 10] = vertex_coord[1];
+            vertex[i*num_samples_phi+j] = { vertex_position, vertex_normal, vertex_color, vertex_coord };
         }
     }
 
@@ -601,273 +1130,508 @@ void ResourceManager::CreateSphere(std::string object_name, float radius, int nu
     //glGenVertexArrays(1, &vao);
     //glBindVertexArray(vao);
 
-    GLuint vbo, ebo;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, vertex_num * vertex_att * sizeof(GLfloat), vertex, GL_STATIC_DRAW);
-
-    glGenBuffers(1, &ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, face_num * face_att * sizeof(GLuint), face, GL_STATIC_DRAW);
+    Resource *res = UploadIndexedMesh(object_name, vertex, face, face_num * face_att, format);
 
     // Free data buffers
-    delete [] vertex;
     delete [] face;
 
-    // Create resource
-    AddResource(Mesh, object_name, vbo, ebo, face_num * face_att);
+    return res;
 }
 
 
 void ResourceManager::LoadTexture(const std::string name, const char *filename){
 
-    // Load texture from file
-    GLuint texture = SOIL_load_OGL_texture(filename, SOIL_LOAD_AUTO, SOIL_CREATE_NEW_ID, 0);
-    if (!texture){
-        throw(std::ios_base::failure(std::string("Error loading texture ")+std::string(filename)+std::string(": ")+std::string(SOIL_last_result())));
-    }
+    LoadTextureAsync(name, filename);
+}
 
-    // Create resource
-    AddResource(Texture, name, texture, 0);
+
+Resource *ResourceManager::LoadTextureAsync(const std::string name, const char *filename){
+
+    // The resource exists right away; its handle is set by the upload
+    Resource *res = AddResource(Texture, name, 0, 0);
+    res->SetSource(filename);
+    StartTextureLoad(res, filename);
+    return res;
 }
 
 
-void ResourceManager::LoadMesh(const std::string name, const char *filename){
+void ResourceManager::StartTextureLoad(Resource *res, const char *filename){
 
-    // First load model into memory. If that goes well, we transfer the
-    // mesh to an OpenGL buffer
-    TriMesh mesh;
+    // Compressed textures come with their mip levels and need no decoding
+    if (LoadKtxTexture(res, filename)){
+        return;
+    }
 
-    // Parse file
-    // Open file
-    std::ifstream f;
-    f.open(filename);
-    if (f.fail()){
-        throw(std::ios_base::failure(std::string("Error opening file ")+std::string(filename)));
+    // Look the file up in the pack here, the workers only decode
+    const char *data = NULL;
+    size_t size = 0;
+    bool packed = FindPackedFile(filename, data, size);
+    std::string file(filename);
+    {
+        std::lock_guard<std::mutex> lock(texture_mutex_);
+        decoding_texture_num_++;
     }
 
-    // Parse lines
-    std::string line;
-    std::string ignore(" \t\r\n");
-    std::string part_separator(" \t");
-    std::string face_separator("/");
-    bool added_normal = false;
-    while (std::getline(f, line)){
-        // Clean extremities of the string
-        string_trim(line, ignore);
-        // Ignore comments
-        if ((line.size() <= 0) ||
-            (line[0] == '#')){
-            continue;
+    worker_.Submit([this, res, file, packed, data, size](){
+        DecodedTexture texture;
+        texture.resource = res;
+        texture.filename = file;
+        // Loose files are mapped here, off the main thread
+        MappedFile mapped;
+        if (packed){
+            DecodeTexture(texture, data, size);
+        } else if (mapped.Open(file.c_str()) && mapped.GetData()){
+            DecodeTexture(texture, mapped.GetData(), mapped.GetSize());
+        } else {
+            texture.error = "cannot open file";
         }
-        // Parse string
-        std::vector<std::string> part = string_split(line, part_separator);
-        // Check commands
-        if (!part[0].compare(std::string("v"))){
-            if (part.size() >= 4){
-                glm::vec3 position(str_to_num<float>(part[1].c_str()), str_to_num<float>(part[2].c_str()), str_to_num<float>(part[3].c_str()));
-                mesh.position.push_back(position);
-            } else {
-                throw(std::ios_base::failure(std::string("Error: v command should have exactly 3 parameters")));
-            }
-        } else if (!part[0].compare(std::string("vn"))){
-            if (part.size() >= 4){
-                glm::vec3 normal(str_to_num<float>(part[1].c_str()), str_to_num<float>(part[2].c_str()), str_to_num<float>(part[3].c_str()));
-                mesh.normal.push_back(normal);
-                added_normal = true;
-            } else {
-                throw(std::ios_base::failure(std::string("Error: vn command should have exactly 3 parameters")));
-            }
-        } else if (!part[0].compare(std::string("vt"))){
-            if (part.size() >= 3){
-                glm::vec2 tex_coord(str_to_num<float>(part[1].c_str()), str_to_num<float>(part[2].c_str()));
-                mesh.tex_coord.push_back(tex_coord);
-            } else {
-                throw(std::ios_base::failure(std::string("Error: vt command should have exactly 2 parameters")));
-            }
-        } else if (!part[0].compare(std::string("f"))){
-            if (part.size() >= 4){
-                if (part.size() > 5){
-                    throw(std::ios_base::failure(std::string("Error: f commands with more than 4 vertices not supported")));
-                } else if (part.size() == 5){
-                    // Break a quad into two triangles
-                    Quad quad;
-                    for (int i = 0; i < 4; i++){
-                        std::vector<std::string> fd = string_split_once(part[i+1], face_separator);
-                        if (fd.size() == 1){
-                            quad.i[i] = str_to_num<float>(fd[0].c_str())-1;
-                            quad.t[i] = -1;
-                            quad.n[i] = -1;
-                        } else if (fd.size() == 2){
-                            quad.i[i] = str_to_num<float>(fd[0].c_str())-1;
-                            quad.t[i] = str_to_num<float>(fd[1].c_str())-1;
-                            quad.n[i] = -1;
-                        } else if (fd.size() == 3){
-                            quad.i[i] = str_to_num<float>(fd[0].c_str())-1;
-                            if (std::string("").compare(fd[1]) != 0){
-                                quad.t[i] = str_to_num<float>(fd[1].c_str())-1;
-                            } else {
-                                quad.t[i] = -1;
-                            }
-                            quad.n[i] = str_to_num<float>(fd[2].c_str())-1;
-                        } else {
-                            throw(std::ios_base::failure(std::string("Error: f parameter should have 1 or 3 parameters separated by '/'")));
-                        }
-                    }
-                    Face face1, face2;
-                    face1.i[0] = quad.i[0]; face1.i[1] = quad.i[1]; face1.i[2] = quad.i[2];
-                    face1.n[0] = quad.n[0]; face1.n[1] = quad.n[1]; face1.n[2] = quad.n[2];
-                    face1.t[0] = quad.t[0]; face1.t[1] = quad.t[1]; face1.t[2] = quad.t[2];
-                    face2.i[0] = quad.i[0]; face2.i[1] = quad.i[2]; face2.i[2] = quad.i[3];
-                    face2.n[0] = quad.n[0]; face2.n[1] = quad.n[2]; face2.n[2] = quad.n[3];
-                    face2.t[0] = quad.t[0]; face2.t[1] = quad.t[2]; face2.t[2] = quad.t[3];
-                    mesh.face.push_back(face1);
-                    mesh.face.push_back(face2);
-                } else if (part.size() == 4){
-                    Face face;
-                    for (int i = 0; i < 3; i++){
-                        std::vector<std::string> fd = string_split_once(part[i+1], face_separator);
-                        if (fd.size() == 1){
-                            face.i[i] = str_to_num<float>(fd[0].c_str())-1;
-                            face.t[i] = -1;
-                            face.n[i] = -1;
-                        } else if (fd.size() == 2){
-                            face.i[i] = str_to_num<float>(fd[0].c_str())-1;
-                            face.t[i] = str_to_num<float>(fd[1].c_str())-1;
-                            face.n[i] = -1;
-                        } else if (fd.size() == 3){
-                            face.i[i] = str_to_num<float>(fd[0].c_str())-1;
-                            if (std::string("").compare(fd[1]) != 0){
-                                face.t[i] = str_to_num<float>(fd[1].c_str())-1;
-                            } else {
-                                face.t[i] = -1;
-                            }
-                            face.n[i] = str_to_num<float>(fd[2].c_str())-1;
-                        } else {
-                            throw(std::ios_base::failure(std::string("Error: f parameter should have 1, 2, or 3 parameters separated by '/'")));
-                        }
-                    }
-                    mesh.face.push_back(face);
-                }
-            } else {
-                throw(std::ios_base::failure(std::string("Error: f command should have 3 or 4 parameters")));
-            }
+
+        std::lock_guard<std::mutex> lock(texture_mutex_);
+        decoded_texture_.push_back(texture);
+        decoding_texture_num_--;
+    });
+}
+
+
+void ResourceManager::DecodeTexture(DecodedTexture &texture, const char *data, size_t size) const {
+
+    // Decoded at an earlier launch if the cache has the same contents
+    unsigned long long hash = TextureCache::Hash(data, size);
+    std::string path;
+    if (!cache_directory_.empty()){
+        std::stringstream key;
+        key << "Texture " << std::hex << hash << std::dec << " " << size;
+        path = CachePath(key.str(), ".tex");
+        std::shared_ptr<TextureCache> cache(new TextureCache);
+        if (cache->Open(path, hash, size)){
+            texture.level = cache->GetLevels();
+            texture.cache = cache;
+            return;
         }
-        // Ignore other commands
     }
 
-    // Close file
-    f.close();
+    // Always RGBA, which drivers store RGB textures as anyway
+    int width, height;
+    unsigned char *pixels = SOIL_load_image_from_memory((const unsigned char *) data, (int) size, &width, &height, 0, SOIL_LOAD_RGBA);
+    if (!pixels){
+        // The reason is global in SOIL, and may come from another
+        // decode running at the same time
+        texture.error = SOIL_last_result();
+        return;
+    }
+    std::shared_ptr<std::vector<std::vector<unsigned char> > > decoded(new std::vector<std::vector<unsigned char> >);
+    decoded->push_back(std::vector<unsigned char>(pixels, pixels + width * height * 4));
+    SOIL_free_image_data(pixels);
+
+    // Every mip level down to 1x1, made here so that the cache has them
+    GLsizei level_width = width;
+    GLsizei level_height = height;
+    while (true){
+        TextureLevel level = { level_width, level_height, NULL };
+        texture.level.push_back(level);
+        if (level_width == 1 && level_height == 1){
+            break;
+        }
+        decoded->push_back(std::vector<unsigned char>());
+        TextureCache::Downsample(level_width, level_height, &(*decoded)[decoded->size() - 2][0], decoded->back());
+        level_width = (level_width > 1) ? level_width / 2 : 1;
+        level_height = (level_height > 1) ? level_height / 2 : 1;
+    }
+    for (int i = 0; i < texture.level.size(); i++){
+        texture.level[i].pixels = &(*decoded)[i][0];
+    }
+    texture.decoded = decoded;
 
-    // Check if vertex references are correct
-    for (unsigned int i = 0; i < mesh.face.size(); i++){
-        for (int j = 0; j < 3; j++){
-            if (mesh.face[i].i[j] >= mesh.position.size()){
-                throw(std::ios_base::failure(std::string("Error: index for triangle ")+num_to_str<int>(mesh.face[i].i[j])+std::string(" is out of bounds")));
+    // A cache that cannot be written only costs the next launch some time
+    if (!path.empty()){
+        TextureCache::Write(path, hash, size, texture.level);
+    }
+}
+
+
+int ResourceManager::UpdateTextureLoads(void){
+
+    std::vector<DecodedTexture> ready;
+    int decoding;
+    {
+        std::lock_guard<std::mutex> lock(texture_mutex_);
+        ready.swap(decoded_texture_);
+        decoding = decoding_texture_num_;
+    }
+    UploadTextures(ready);
+    return decoding + uploading_texture_num_;
+}
+
+
+// Whether the driver can sample a compressed format of a KTX file
+static bool IsCompressedFormatSupported(GLenum internal_format){
+
+    switch (internal_format){
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+            return GLEW_EXT_texture_compression_s3tc;
+        case GL_COMPRESSED_RGB8_ETC2:
+        case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+        case GL_COMPRESSED_RGBA8_ETC2_EAC:
+            return GLEW_ARB_ES3_compatibility;
+        case GL_COMPRESSED_RED_RGTC1:
+        case GL_COMPRESSED_RG_RGTC2:
+            // Core since OpenGL 3.0
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+bool ResourceManager::LoadKtxTexture(Resource *res, const char *filename){
+
+    // The file named, or the one next to the image made by
+    // texture_compressor
+    std::string file(filename);
+    bool named = file.size() >= 4 && file.compare(file.size() - 4, 4, ".ktx") == 0;
+    if (!named){
+        size_t dot = file.find_last_of('.');
+        size_t separator = file.find_last_of("/\\");
+        if (dot == std::string::npos || (separator != std::string::npos && dot < separator)){
+            return false;
+        }
+        file = file.substr(0, dot) + ".ktx";
+
+        // An image exported again since it was compressed wins over the
+        // stale .ktx, until texture_compressor runs again
+        struct stat image, compressed;
+        if (stat(filename, &image) == 0 && stat(file.c_str(), &compressed) == 0 && image.st_mtime > compressed.st_mtime){
+            return false;
+        }
+    }
+
+    const char *data;
+    size_t size;
+    MappedFile mapped;
+    if (!FindPackedFile(file, data, size)){
+        if (!mapped.Open(file.c_str())){
+            if (named){
+                throw(std::ios_base::failure(std::string("Error opening file ")+file));
             }
+            return false;
         }
+        data = mapped.GetData();
+        size = mapped.GetSize();
     }
 
-    // Compute degree of each vertex
-    std::vector<int> degree(mesh.position.size(), 0);
-    for (unsigned int i = 0; i < mesh.face.size(); i++){
-        for (int j = 0; j < 3; j++){
-            degree[mesh.face[i].i[j]]++;
+    KtxTexture ktx;
+    ReadKtx(file.c_str(), data, size, ktx);
+    if (ktx.compressed && !IsCompressedFormatSupported(ktx.internal_format)){
+        if (named){
+            throw(std::ios_base::failure(std::string("Unsupported compressed format in ")+file));
         }
+        // The image the file was made from still works
+        return false;
     }
 
-    // Compute vertex normals if no normals were ever added
-    if (!added_normal){
-        mesh.normal = std::vector<glm::vec3>(mesh.position.size(), glm::vec3(0.0, 0.0, 0.0));
-        for (unsigned int i = 0; i < mesh.face.size(); i++){
-            // Compute face normal
-            glm::vec3 vec1, vec2;
-            vec1 = mesh.position[mesh.face[i].i[0]] -
-                        mesh.position[mesh.face[i].i[1]];
-            vec2 = mesh.position[mesh.face[i].i[0]] -
-                        mesh.position[mesh.face[i].i[2]];
-            glm::vec3 norm = glm::cross(vec1, vec2);
-            norm = glm::normalize(norm);
-            // Add face normal to vertices
-            mesh.normal[mesh.face[i].i[0]] += norm;
-            mesh.normal[mesh.face[i].i[1]] += norm;
-            mesh.normal[mesh.face[i].i[2]] += norm;
+    // Blocks go to the GPU as stored, every level at once
+    GLuint handle;
+    glGenTextures(1, &handle);
+    glBindTexture(GL_TEXTURE_2D, handle);
+    size_t bytes = 0;
+    for (int i = 0; i < ktx.level.size(); i++){
+        const KtxLevel &level = ktx.level[i];
+        bytes += level.size;
+        if (ktx.compressed){
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, ktx.internal_format, level.width, level.height, 0, (GLsizei) level.size, level.data);
+        } else {
+            glTexImage2D(GL_TEXTURE_2D, i, ktx.internal_format, level.width, level.height, 0, ktx.format, ktx.type, level.data);
         }
-        for (unsigned int i = 0; i < mesh.normal.size(); i++){
-            if (degree[i] > 0){
-                mesh.normal[i] /= degree[i];
+    }
+    // Complete with the levels the file has
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint) ktx.level.size() - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (ktx.level.size() > 1) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    res->SetResource(handle);
+    res->SetByteSize(bytes);
+    return true;
+}
+
+
+UploadQueue &ResourceManager::GetUploadQueue(void){
+
+    return upload_;
+}
+
+
+ThreadPool &ResourceManager::GetThreadPool(void){
+
+    return worker_;
+}
+
+
+void ResourceManager::UploadTextures(std::vector<DecodedTexture> &texture){
+
+    std::string error;
+    for (int i = 0; i < texture.size(); i++){
+        DecodedTexture &t = texture[i];
+        if (t.level.empty()){
+            if (error.empty()){
+                error = std::string("Error loading texture ")+t.filename+std::string(": ")+t.error;
             }
+            continue;
+        }
+
+        // Storage for every level; the pixels follow through the queue
+        uploading_texture_num_++;
+        GLuint handle;
+        glGenTextures(1, &handle);
+        glBindTexture(GL_TEXTURE_2D, handle);
+        size_t bytes = 0;
+        for (int l = 0; l < t.level.size(); l++){
+            glTexImage2D(GL_TEXTURE_2D, l, GL_RGBA8, t.level[l].width, t.level[l].height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            bytes += (size_t) t.level[l].width * t.level[l].height * 4;
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint) t.level.size() - 1);
+
+        // Sampling SOIL used to set up, until a material sets its own
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        // The resource gets its handle once every level is in, so a
+        // texture is never drawn half uploaded. The last level keeps the
+        // pixels of all of them until then
+        Resource *res = t.resource;
+        std::shared_ptr<TextureCache> cache = t.cache;
+        std::shared_ptr<std::vector<std::vector<unsigned char> > > decoded = t.decoded;
+        for (int l = 0; l < t.level.size(); l++){
+            std::function<void(void)> done;
+            if (l == t.level.size() - 1){
+                done = [this, res, handle, bytes, cache, decoded](){
+                    res->SetResource(handle);
+                    res->SetByteSize(bytes);
+                    uploading_texture_num_--;
+                };
+            }
+            upload_.UploadTexture(handle, l, t.level[l].width, t.level[l].height, GL_RGBA, GL_UNSIGNED_BYTE, t.level[l].pixels, done);
         }
     }
 
-    // Debug
-    //print_mesh(mesh);
+    // Reported once every decoded texture is uploaded
+    if (!error.empty()){
+        throw(std::ios_base::failure(error));
+    }
+}
 
-    // If we got to this point, the file was parsed successfully and the
-    // mesh is in memory
-    // Now, transfer the mesh to OpenGL buffers
-    // Create three new vertices for each face, in case vertex
-    // normals/texture coordinates are not consistent over the mesh
 
-    // Number of attributes for vertices and faces
-    const int vertex_att = 11;
-    const int face_att = 3;
+void ResourceManager::LoadMesh(const std::string name, const char *filename){
 
-    // Create OpenGL buffers and copy data
-    GLuint vbo, ebo;
+    // A mesh loaded before comes straight from the cache, unless the file
+    // changed since
+    // Loaded through LoadResource, in the standard layout
+    const VertexFormat &format = StandardVertex::Format();
+    std::string key = GeometryKey(std::string("Obj ") + filename, {}, format);
+    unsigned long long source_time = 0, source_size = 0;
+    struct stat source;
+    if (stat(filename, &source) == 0){
+        source_time = source.st_mtime;
+        source_size = source.st_size;
+    }
+    if (LoadCachedMesh(key, name, format, source_time, source_size)){
+        return;
+    }
 
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, mesh.face.size() * 3 * vertex_att * sizeof(GLuint), 0, GL_STATIC_DRAW);
+    // First load model into memory. If that goes well, we transfer the
+    // mesh to an OpenGL buffer
+    TriMesh mesh;
+    bool added_normal = LoadObj(filename, mesh);
 
-    glGenBuffers(1, &ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.face.size() * face_att * sizeof(GLuint), 0, GL_STATIC_DRAW);
+    // Compute vertex normals if no normals were ever added
+    if (!added_normal){
+        ComputeVertexNormals(mesh);
+    }
 
-    unsigned int vertex_index = 0;
-    for (unsigned int i = 0; i < mesh.face.size(); i++){
-        // Add three vertices and their attributes
-        GLfloat att[3 * vertex_att] = { 0 };
-        for (int j = 0; j < 3; j++){
-            // Position
-            att[j*vertex_att + 0] = mesh.position[mesh.face[i].i[j]][0];
-            att[j*vertex_att + 1] = mesh.position[mesh.face[i].i[j]][1];
-            att[j*vertex_att + 2] = mesh.position[mesh.face[i].i[j]][2];
-            // Normal
-            if (!added_normal){
-                att[j*vertex_att + 3] = mesh.normal[mesh.face[i].i[j]][0];
-                att[j*vertex_att + 4] = mesh.normal[mesh.face[i].i[j]][1];
-                att[j*vertex_att + 5] = mesh.normal[mesh.face[i].i[j]][2];
+    // Full detail, then coarser levels each simplified from the previous
+    // one to a quarter of its triangles
+    Resource *res = UploadTriMesh(name, mesh, added_normal, format);
+    TriMesh lod = mesh;
+    for (int level = 1; level < lod_levels_; level++){
+        int face_num = (int) lod.face.size() / 4;
+        if (face_num < 16){
+            break;
+        }
+        lod = SimplifyMesh(lod, face_num);
+        if (!added_normal){
+            ComputeVertexNormals(lod);
+        }
+        res->AddLod(UploadTriMesh(LodName(name, level), lod, added_normal, format));
+    }
+
+    SaveCachedMesh(key, res, source_time, source_size);
+}
+
+
+void ResourceManager::LoadModel(const std::string name, const char *filename){
+
+    GlbFile glb;
+    LoadGlb(filename, glb);
+
+    // Meshes are uploaded once, however many nodes use them. Buffers are
+    // filled straight from the mapped binary chunk, attributes staying in
+    // the streams of the file
+    std::vector<std::vector<Resource *> > mesh(glb.mesh.size());
+    for (int m = 0; m < glb.mesh.size(); m++){
+        for (int p = 0; p < glb.mesh[m].primitive.size(); p++){
+            const GlbPrimitive &prim = glb.mesh[m].primitive[p];
+
+            GLuint vbo, ebo;
+            glGenBuffers(1, &vbo);
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            glBufferData(GL_ARRAY_BUFFER, prim.vertex_bytes, glb.binary + prim.vertex_offset, GL_STATIC_DRAW);
+
+            // 8-bit and missing indices are the only ones built here
+            GLenum index_type = prim.index_type;
+            glGenBuffers(1, &ebo);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+            if (prim.indexed && index_type != GL_UNSIGNED_BYTE){
+                GLsizeiptr index_size = (index_type == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, prim.index_count * index_size, glb.binary + prim.index_offset, GL_STATIC_DRAW);
+            } else if (prim.indexed || index_type == GL_UNSIGNED_SHORT){
+                std::vector<GLushort> index(prim.index_count);
+                for (int i = 0; i < prim.index_count; i++){
+                    index[i] = prim.indexed ? (GLubyte) glb.binary[prim.index_offset + i] : i;
+                }
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, index.size() * sizeof(GLushort), &index[0], GL_STATIC_DRAW);
+                index_type = GL_UNSIGNED_SHORT;
             } else {
-                if (mesh.face[i].n[j] >= 0){
-                    att[j*vertex_att + 3] = mesh.normal[mesh.face[i].n[j]][0];
-                    att[j*vertex_att + 4] = mesh.normal[mesh.face[i].n[j]][1];
-                    att[j*vertex_att + 5] = mesh.normal[mesh.face[i].n[j]][2];
+                std::vector<GLuint> index(prim.index_count);
+                for (int i = 0; i < prim.index_count; i++){
+                    index[i] = i;
                 }
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, index.size() * sizeof(GLuint), &index[0], GL_STATIC_DRAW);
             }
-            // No color in (6, 7, 8)
-            // Texture coordinates
-            if (mesh.face[i].t[j] >= 0){
-                att[j*vertex_att + 9] = mesh.tex_coord[mesh.face[i].t[j]][0];
-                att[j*vertex_att + 10] = mesh.tex_coord[mesh.face[i].t[j]][1];
-            }
+
+            // Formats are kept for as long as the meshes using them
+            file_format_.push_back(prim.format);
+            Resource *res = AddResource(Mesh, name + "/" + num_to_str<int>(m) + "/" + num_to_str<int>(p), vbo, ebo, prim.index_count);
+            res->SetIndexType(index_type);
+            res->SetVertexFormat(file_format_.back());
+            res->SetBounds(prim.min, prim.max, (prim.min + prim.max) * 0.5f, glm::length(prim.max - prim.min) * 0.5f);
+            mesh[m].push_back(res);
         }
+    }
+
+    Model &model = model_[name];
+    model.node.resize(glb.node.size());
+    for (int n = 0; n < glb.node.size(); n++){
+        const GlbNode &src = glb.node[n];
+        ModelNode &dst = model.node[n];
+        dst.name = src.name;
+        dst.position = src.translation;
+        dst.orientation = src.rotation;
+        dst.scale = src.scale;
+        if (src.mesh >= 0){
+            dst.geometry.assign(mesh[src.mesh].begin(), mesh[src.mesh].end());
+        }
+        dst.child = src.child;
+        dst.instance_position = src.instance_translation;
+        dst.instance_orientation = src.instance_rotation;
+        dst.instance_scale = src.instance_scale;
+    }
+    model.root = glb.root;
+    model.group = AddResource(Mesh, name + "/group", 0, 0, 0);
 
-        // Copy attributes to buffer
-        glBufferSubData(GL_ARRAY_BUFFER, i * 3 * vertex_att * sizeof(GLfloat), 3 * vertex_att * sizeof(GLfloat), att);
+    if (mesh.size() > 0 && mesh[0].size() > 0){
+        Resource::GetTable().AddName(name, mesh[0][0]->GetHandle());
+    }
+}
 
-        // Add triangle
-        GLuint findex[face_att] = { 0 };
-        findex[0] = vertex_index;
-        findex[1] = vertex_index + 1;
-        findex[2] = vertex_index + 2;
-        vertex_index += 3;
 
-        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, i * face_att * sizeof(GLuint), face_att * sizeof(GLuint), findex);
+Resource *ResourceManager::UploadTriMesh(const std::string name, const TriMesh &mesh, bool added_normal, const VertexFormat &format){
+
+    // Debug
+    //print_mesh(mesh);
+
+    // Corners that share position, normal and texture coordinates become
+    // one indexed vertex. Without normals in the file, each position has
+    // its computed normal
+    int corner_num = (int) mesh.face.size() * 3;
+    std::vector<VertexData> vertex;
+    std::vector<GLuint> index(corner_num);
+    vertex.reserve(corner_num / 2);
+
+    // Open-addressing table from corner to vertex, at most half full
+    size_t capacity = 16;
+    while (capacity < 2 * (size_t) corner_num){
+        capacity *= 2;
+    }
+    const GLuint empty = 0xFFFFFFFF;
+    std::vector<GLuint> slot(capacity, empty);
+    std::vector<glm::ivec3> slot_key(capacity);
+
+    for (int c = 0; c < corner_num; c++){
+        const Face &f = mesh.face[c / 3];
+        int j = c % 3;
+        glm::ivec3 key(f.i[j], f.t[j], added_normal ? f.n[j] : f.i[j]);
+
+        size_t h = ((size_t) key.x * 73856093u) ^ ((size_t) (key.y + 1) * 19349663u) ^ ((size_t) (key.z + 1) * 83492791u);
+        h &= capacity - 1;
+        while (slot[h] != empty && slot_key[h] != key){
+            h = (h + 1) & (capacity - 1);
+        }
+        if (slot[h] == empty){
+            VertexData v;
+            v.position = mesh.position[key.x];
+            v.normal = (key.z >= 0) ? mesh.normal[key.z] : glm::vec3(0.0f);
+            v.color = glm::vec3(0.0f); // No color in the file
+            v.uv = (key.y >= 0) ? mesh.tex_coord[key.y] : glm::vec2(0.0f);
+            slot[h] = (GLuint) vertex.size();
+            slot_key[h] = key;
+            vertex.push_back(v);
+        }
+        index[c] = slot[h];
     }
 
-    // Create resource
-    AddResource(Mesh, name, vbo, ebo, mesh.face.size() * face_att);
+    if (vertex.size() == 0){
+        return AddResource(Mesh, name, 0, 0, 0);
+    }
+    return UploadIndexedMesh(name, vertex, &index[0], corner_num, format);
+}
+
+
+void ComputeVertexNormals(TriMesh &mesh){
+
+    // Compute degree of each vertex
+    std::vector<int> degree(mesh.position.size(), 0);
+    for (unsigned int i = 0; i < mesh.face.size(); i++){
+        for (int j = 0; j < 3; j++){
+            degree[mesh.face[i].i[j]]++;
+        }
+    }
+
+    mesh.normal = std::vector<glm::vec3>(mesh.position.size(), glm::vec3(0.0, 0.0, 0.0));
+    for (unsigned int i = 0; i < mesh.face.size(); i++){
+        // Compute face normal
+        glm::vec3 vec1, vec2;
+        vec1 = mesh.position[mesh.face[i].i[0]] -
+                    mesh.position[mesh.face[i].i[1]];
+        vec2 = mesh.position[mesh.face[i].i[0]] -
+                    mesh.position[mesh.face[i].i[2]];
+        glm::vec3 norm = glm::cross(vec1, vec2);
+        norm = glm::normalize(norm);
+        // Add face normal to vertices
+        mesh.normal[mesh.face[i].i[0]] += norm;
+        mesh.normal[mesh.face[i].i[1]] += norm;
+        mesh.normal[mesh.face[i].i[2]] += norm;
+    }
+    for (unsigned int i = 0; i < mesh.normal.size(); i++){
+        if (degree[i] > 0){
+            mesh.normal[i] /= degree[i];
+        }
+    }
 }
 
 
@@ -1021,11 +1785,42 @@ void ResourceManager::CreateWall(std::string object_name){
     // 8 = vertex_num, 3 = vertex_att
     // 2 = face_num, 3 = face_att
     // Create resource
-    AddResource(Mesh, object_name, vbo, ebo, 2 * 3);
+    Resource *res = AddResource(Mesh, object_name, vbo, ebo, 2 * 3);
+    ComputeBounds(res, vertex, 4, 11);
 }
 
 
-void ResourceManager::CreateSeamlessTorus(std::string object_name, float loop_radius, float circle_radius, int num_loop_samples, int num_circle_samples){
+Resource *ResourceManager::CreateSeamlessTorus(std::string object_name, float loop_radius, float circle_radius, int num_loop_samples, int num_circle_samples, const VertexFormat &format){
+
+    std::string key = GeometryKey("SeamlessTorus", { loop_radius, circle_radius, (float) num_loop_samples, (float) num_circle_samples }, format);
+    Resource *res = FindGeometry(key, object_name);
+    if (res){
+        return res;
+    }
+    res = LoadCachedMesh(key, object_name, format);
+    if (res){
+        geometry_cache_[key] = res;
+        return res;
+    }
+    res = BuildSeamlessTorus(object_name, loop_radius, circle_radius, num_loop_samples, num_circle_samples, format);
+
+    // Coarser levels of detail halve the sample counts
+    for (int level = 1; level < lod_levels_; level++){
+        num_loop_samples /= 2;
+        num_circle_samples /= 2;
+        if (num_loop_samples < 8 || num_circle_samples < 4){
+            break;
+        }
+        res->AddLod(BuildSeamlessTorus(LodName(object_name, level), loop_radius, circle_radius, num_loop_samples, num_circle_samples, format));
+    }
+
+    SaveCachedMesh(key, res);
+    geometry_cache_[key] = res;
+    return res;
+}
+
+
+Resource *ResourceManager::BuildSeamlessTorus(std::string object_name, float loop_radius, float circle_radius, int num_loop_samples, int num_circle_samples, const VertexFormat &format){
 
     // Create a torus
     // The torus is built from a large loop with small circles around the loop
@@ -1037,16 +1832,14 @@ void ResourceManager::CreateSeamlessTorus(std::string object_name, float loop_ra
     const GLuint face_num = num_loop_samples*num_circle_samples*2;
 
     // Number of attributes for vertices and faces
-    const int vertex_att = 11;
     const int face_att = 3;
 
     // Data buffers for the torus
-    GLfloat *vertex = NULL;
+    std::vector<VertexData> vertex(vertex_num);
     GLuint *face = NULL;
 
     // Allocate memory for buffers
     try {
-        vertex = new GLfloat[vertex_num * vertex_att]; // 11 attributes per vertex: 3D position (3), 3D normal (3), RGB color (3), 2D texture coordinates (2)
         face = new GLuint[face_num * face_att]; // 3 indices per face
     }
     catch  (std::exception &e){
@@ -1085,13 +1878,7 @@ void ResourceManager::CreateSeamlessTorus(std::string object_name, float loop_ra
 			// vertex_coord = glm::vec2(fabs(1-2*s),fabs(1-2*t)); // made seamless through mirroring
     //			vertex_coord = glm::vec2((rand() % 2000) / 2000.0, (rand() % 2000) / 2000.0);
             // Add vectors to the data buffer
-            for (int k = 0; k < 3; k++){
-                vertex[(i*(num_circle_samples+1)+j)*vertex_att + k] = vertex_position[k];
-                vertex[(i*(num_circle_samples+1)+j)*vertex_att + k + 3] = vertex_normal[k];
-                vertex[(i*(num_circle_samples+1)+j)*vertex_att + k + 6] = vertex_color[k];
-            }
-            vertex[(i*(num_circle_samples+1)+j)*vertex_att + 9] = vertex_coord[0];
-            vertex[(i*(num_circle_samples+1)+j)*vertex_att + 10] = vertex_coord[1];
+            vertex[i*(num_circle_samples+1)+j] = { vertex_position, vertex_normal, vertex_color, vertex_coord };
         }
     }
 
@@ -1118,21 +1905,12 @@ void ResourceManager::CreateSeamlessTorus(std::string object_name, float loop_ra
     //glGenVertexArrays(1, &vao);
     //glBindVertexArray(vao);
 
-    GLuint vbo, ebo;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, vertex_num * vertex_att * sizeof(GLfloat), vertex, GL_STATIC_DRAW);
-
-    glGenBuffers(1, &ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, face_num * face_att * sizeof(GLuint), face, GL_STATIC_DRAW);
+    Resource *res = UploadIndexedMesh(object_name, vertex, face, face_num * face_att, format);
 
     // Free data buffers
-    delete [] vertex;
     delete [] face;
 
-    // Create resource
-    AddResource(Mesh, object_name, vbo, ebo, face_num * face_att);
+    return res;
 }
 
 void ResourceManager::CreateRectangle(std::string object_name, float length, float width, float height){
@@ -1191,7 +1969,8 @@ void ResourceManager::CreateRectangle(std::string object_name, float length, flo
     // 8 = vertex_num, 3 = vertex_att
     // 2 = face_num, 3 = face_att
     // Create resource
-    AddResource(Mesh, object_name, vbo, ebo, 12 * 3);
+    Resource *res = AddResource(Mesh, object_name, vbo, ebo, 12 * 3);
+    ComputeBounds(res, vertex, 8, 11);
 }
 
 void ResourceManager::CreateSquare(std::string object_name){
@@ -1246,29 +2025,25 @@ void ResourceManager::CreateSquare(std::string object_name){
     // 8 = vertex_num, 3 = vertex_att
     // 2 = face_num, 3 = face_att
     // Create resource
-    AddResource(Mesh, object_name, vbo, ebo, 12 * 3);
+    Resource *res = AddResource(Mesh, object_name, vbo, ebo, 12 * 3);
+    ComputeBounds(res, vertex, 8, 11);
 }
 
-void ResourceManager::CreateTerrain(std::string object_name, float length, float width){
-
-    std::string material_directory_g = MATERIAL_DIRECTORY;
-    std::vector<std::vector<float>> height_map = ReadHeightMap(material_directory_g+"\\height_map.txt");
+void ResourceManager::CreateTerrain(std::string object_name, const std::vector<std::vector<float>> &height_map, float length, float width, const VertexFormat &format){
 
     // Number of vertices and faces to be created
     const GLuint vertex_num = height_map.size()*height_map[0].size();//(height_map.size()+1)*(height_map[0].size()+1);
-    const GLuint face_num = height_map.size()*height_map[0].size()*2;
+    const GLuint face_num = (height_map.size()-1)*(height_map[0].size()-1)*2;
 
     // Number of attributes for vertices and faces
-    const int vertex_att = 11;
     const int face_att = 3;
 
     // Data buffers for the torus
-    GLfloat *vertex = NULL;
+    std::vector<VertexData> vertex(vertex_num);
     GLuint *face = NULL;
 
     // Allocate memory for buffers
     try {
-        vertex = new GLfloat[vertex_num * vertex_att]; // 11 attributes per vertex: 3D position (3), 3D normal (3), RGB color (3), 2D texture coordinates (2)
         face = new GLuint[face_num * face_att]; // 3 indices per face
     }
     catch  (std::exception &e){
@@ -1301,14 +2076,7 @@ void ResourceManager::CreateTerrain(std::string object_name, float length, float
             // vertex_coord = glm::vec2(s,t);
             vertex_coord = glm::vec2((static_cast<float>(i) / height_map.size())*10, (static_cast<float>(j) / height_map[0].size())*10);
 
-            int index = i*height_map[0].size()*vertex_att + j * vertex_att;
-            for(int k = 0; k < 3; k++){
-                vertex[index + k] = vertex_position[k]; //height_map.size() + 1 ? 
-                vertex[index + k + 3] = vertex_normal[k];
-                vertex[index + k + 6] = vertex_color[k];
-            }
-            vertex[index + 9] = vertex_coord[0];
-            vertex[index + 10] = vertex_coord[1];
+            vertex[i*height_map[0].size() + j] = { vertex_position, vertex_normal, vertex_color, vertex_coord };
         }
     }
 
@@ -1323,36 +2091,34 @@ void ResourceManager::CreateTerrain(std::string object_name, float length, float
                         (i + 1) * height_map[0].size() + j);
             // Add two triangles to the data buffer
             for (int k = 0; k < 3; k++){
-                face[(i*(height_map[0].size())+j)*face_att*2 + k] = static_cast<GLuint>(t1[k]);
-                face[(i*(height_map[0].size())+j)*face_att*2 + k + face_att] = static_cast<GLuint>(t2[k]);
+                face[(i*(height_map[0].size()-1)+j)*face_att*2 + k] = static_cast<GLuint>(t1[k]);
+                face[(i*(height_map[0].size()-1)+j)*face_att*2 + k + face_att] = static_cast<GLuint>(t2[k]);
             }
         }
     }
 
-    GLuint vbo, ebo;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, vertex_num * vertex_att * sizeof(GLfloat), vertex, GL_STATIC_DRAW);
-
-    glGenBuffers(1, &ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, face_num * face_att * sizeof(GLuint), face, GL_STATIC_DRAW);
+    UploadIndexedMesh(object_name, vertex, face, face_num * face_att, format);
 
     // Free data buffers
-    delete [] vertex;
     delete [] face;
-
-    // Create resource
-    AddResource(Mesh, object_name, vbo, ebo, face_num * face_att);
 }
 
-std::vector<std::vector<float>> ResourceManager::ReadHeightMap(const std::string& filename){
+std::vector<std::vector<float>> ResourceManager::ReadHeightMap(const std::string& filename) const {
     std::vector<std::vector<float>> heightMap;
 
-    std::ifstream file(filename);
-    if(!file.is_open()){
-        std::cerr << "Error opening file: " << filename << std::endl; 
-        exit(0);
+    // Read from the resource pack or the file
+    std::stringstream file;
+    const char *data;
+    size_t size;
+    if (FindPackedFile(filename, data, size)){
+        file.write(data, size);
+    } else {
+        std::ifstream disk_file(filename);
+        if(!disk_file.is_open()){
+            std::cerr << "Error opening file: " << filename << std::endl; 
+            exit(0);
+        }
+        file << disk_file.rdbuf();
     }
 
     std::string line;
@@ -1368,8 +2134,6 @@ std::vector<std::vector<float>> ResourceManager::ReadHeightMap(const std::string
         heightMap.push_back(row);
     }
 
-    file.close();
-
     return heightMap;
 }
 
@@ -1444,10 +2208,10 @@ void ResourceManager::CreateFireworkParticles(std::string object_name, int num_p
     GLuint vbo;
     glGenBuffers(1, &vbo);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, num_particles * particle_att * sizeof(GLfloat), particle, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, num_particles * particle_att * sizeof(GLfloat), NULL, GL_STATIC_DRAW);
 
-    // Free data buffers
-    delete [] particle;
+    // Queue the data, freed once it is copied
+    upload_.UploadBuffer(vbo, 0, num_particles * particle_att * sizeof(GLfloat), particle, [particle](){ delete [] particle; });
 
     // Create resource
     AddResource(PointSet, object_name, vbo, 0, num_particles);
@@ -1508,10 +2272,10 @@ void ResourceManager::CreateParticleEffect2(std::string object_name, int num_par
     GLuint vbo;
     glGenBuffers(1, &vbo);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, num_particles * particle_att * sizeof(GLfloat), particle, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, num_particles * particle_att * sizeof(GLfloat), NULL, GL_STATIC_DRAW);
 
-    // Free data buffers
-    delete [] particle;
+    // Queue the data, freed once it is copied
+    upload_.UploadBuffer(vbo, 0, num_particles * particle_att * sizeof(GLfloat), particle, [particle](){ delete [] particle; });
 
     // Create resource
     AddResource(PointSet, object_name, vbo, 0, num_particles);
@@ -1589,10 +2353,10 @@ void ResourceManager::CreateParticleEffect3(std::string object_name, int num_par
     GLuint vbo;
     glGenBuffers(1, &vbo);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, num_particles * particle_att * sizeof(GLfloat), particle, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, num_particles * particle_att * sizeof(GLfloat), NULL, GL_STATIC_DRAW);
 
-    // Free data buffers
-    delete [] particle;
+    // Queue the data, freed once it is copied
+    upload_.UploadBuffer(vbo, 0, num_particles * particle_att * sizeof(GLfloat), particle, [particle](){ delete [] particle; });
 
     // Create resource
     AddResource(PointSet, object_name, vbo, 0, num_particles);
@@ -3,6 +3,12 @@
 
 #include <string>
 #include <vector>
+#include <map>
+#include <set>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <initializer_list>
 #define GLEW_STATIC
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -12,6 +18,13 @@
 #include <sstream>
 
 #include "resource.h"
+#include "resource_table.h"
+#include "model_loader.h"
+#include "model.h"
+#include "resource_pack.h"
+#include "thread_pool.h"
+#include "upload_queue.h"
+#include "texture_cache.h"
 
 // Default extensions for different shader source files
 #define VERTEX_PROGRAM_EXTENSION "_vp.glsl"
@@ -28,46 +41,254 @@ namespace game {
             ResourceManager(void);
             ~ResourceManager();
             // Add a resource that was already loaded and allocated to memory
-            void AddResource(ResourceType type, const std::string name, GLuint resource, GLsizei size);
-            void AddResource(ResourceType type, const std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size);
+            Resource *AddResource(ResourceType type, const std::string name, GLuint resource, GLsizei size);
+            Resource *AddResource(ResourceType type, const std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size);
             // Load a resource from a file, according to the specified type
             void LoadResource(ResourceType type, const std::string name, const char *filename);
-            // Get the resource with the specified name
-            Resource *GetResource(const std::string name) const;
+            // Get the resource with the specified name, or of a handle;
+            // NULL if there is none. A texture evicted to stay within the
+            // memory budget is loaded again, and has a texture handle of
+            // 0 until it is uploaded
+            Resource *GetResource(const std::string &name);
+            Resource *GetResource(ResourceHandle handle);
+            // Handle of the resource with the specified name, NO_RESOURCE
+            // if there is none. Keeping it saves looking up the name again
+            ResourceHandle GetHandle(const std::string &name) const;
+            // Delete a resource no one references any more, with its
+            // OpenGL objects and levels of detail; handles to it stop
+            // resolving. Returns false if it is still referenced
+            bool RemoveResource(ResourceHandle handle);
+
+            // GPU memory: the bytes of the buffers and textures of every
+            // resource, of the upload staging buffer, and those reported
+            // by SetUnmanagedMemory. Framebuffers and per-frame stream
+            // buffers are not counted. Past the budget, textures loaded
+            // from files that were used and are no longer referenced are
+            // evicted, least recently used first. Resources never
+            // referenced belong to their creator, which holds their
+            // handles, and are kept
+            void SetMemoryBudget(size_t bytes); // 0 for no budget
+            size_t GetMemoryBudget(void) const;
+            size_t GetMemoryUsed(void) const;
+            // Bytes allocated by renderers on their own, like geometry
+            // arenas and impostor atlases; they count against the budget
+            // but are never evicted
+            void SetUnmanagedMemory(size_t bytes);
+            // Evict until the resources fit the budget, or none is left to
+            // evict; call once per frame. Returns the number evicted
+            int TrimMemory(void);
+            // Delete the OpenGL objects of every resource, while the
+            // context still exists
+            void DeleteObjects(void);
+
+            // Textures are decoded on worker threads and uploaded by the
+            // main thread. Loading one returns its resource right away,
+            // with a texture handle of 0 until the upload is done. A
+            // compressed .ktx file next to the image, when the driver
+            // supports its format, is uploaded right away instead
+            Resource *LoadTextureAsync(const std::string name, const char *filename);
+            // Queue the textures decoded so far for upload, without
+            // waiting; returns the number still being decoded or uploaded.
+            // Throws if one of them could not be decoded
+            int UpdateTextureLoads(void);
+            // Transfers of texture, mesh and particle data, which reach
+            // their buffers over the next frames; process it once per frame
+            UploadQueue &GetUploadQueue(void);
+            // Workers decoding textures, shared with other work that does
+            // not touch OpenGL
+            ThreadPool &GetThreadPool(void);
+            // Shader program from vertex, fragment and optionally geometry
+            // source code in memory, added as a material. Linked programs
+            // are kept in the cache directory and reused by later launches
+            // on the same driver
+            Resource *CreateMaterial(const std::string name, const std::string vp, const std::string fp, const std::string gp = "");
+            // Materials compile in the background, several at once when
+            // the driver supports it: their programs can be used right
+            // away, and the driver waits for the ones not done. Check the
+            // materials done compiling, without waiting; returns the
+            // number still compiling. A driver compiling one program at a
+            // time has one checked per call. Throws with the log of the
+            // first that failed to compile or link
+            int UpdateMaterialLoads(void);
+            // Node hierarchy of a model loaded from a scene file, NULL if
+            // there is none with that name
+            const Model *GetModel(const std::string name) const;
+
+            // Number of levels of detail generated for meshes, including
+            // the full-detail one; 1 disables level-of-detail generation
+            void SetLodLevels(int levels);
+            // Print the vertex cache miss ratio of each generated mesh before
+            // and after optimizing it; off by default
+            void SetPrintStats(bool print);
+            // Pack vertices into a layout, queue them and their indices for
+            // OpenGL buffers, with 16-bit indices when they fit, and add
+            // the mesh as a resource
+            Resource *UploadVertices(const std::string name, const VertexData *vertex, int vertex_num, const GLuint *index, int index_num, const VertexFormat &format);
+
+            // Read files under root from a resource pack when it has them,
+            // instead of opening each one; files missing from the pack, or
+            // every file if the pack cannot be opened, are read from disk
+            void SetResourcePack(const std::string filename, const std::string root);
+            // Contents of a file from the resource pack; false if it is not
+            // packed, or if the file on disk changed since the pack was
+            // built, so edited assets are read without rebuilding it. The
+            // data stays valid as long as the manager
+            bool FindPackedFile(const std::string filename, const char *&data, size_t &size) const;
+
+            // Directory where generated meshes, decoded textures and linked
+            // programs are kept between launches, created if needed;
+            // empty, the default, disables it. Set it before loading
+            // textures and materials. Generated meshes are only checked
+            // against the generator revision in resource_manager.cpp, so
+            // changing a generator without bumping it reuses stale meshes
+            void SetCacheDirectory(const std::string directory);
 
             // Methods to create specific resources
+            // Generated shapes are cached by generator, parameters and
+            // vertex layout: a shape asked for again, under any name,
+            // returns the existing resource, and the cache directory holds
+            // them across launches. Meshes whose materials ignore the
+            // vertex color can use CompactVertex instead of StandardVertex
             // Create the geometry for a torus and add it to the list of resources
-			void CreateTorus(std::string object_name, float loop_radius = 0.6, float circle_radius = 0.2, int num_loop_samples = 90, int num_circle_samples = 30);
-			void CreateSeamlessTorus(std::string object_name, float loop_radius = 0.6, float circle_radius = 0.2, int num_loop_samples = 90, int num_circle_samples = 30);
-            void CreateTerrain(std::string object_name, float length = 1.0, float width = 1.0);
+			Resource *CreateTorus(std::string object_name, float loop_radius = 0.6, float circle_radius = 0.2, int num_loop_samples = 90, int num_circle_samples = 30, const VertexFormat &format = StandardVertex::Format());
+			Resource *CreateSeamlessTorus(std::string object_name, float loop_radius = 0.6, float circle_radius = 0.2, int num_loop_samples = 90, int num_circle_samples = 30, const VertexFormat &format = StandardVertex::Format());
+            void CreateTerrain(std::string object_name, const std::vector<std::vector<float>> &height_map, float length = 1.0, float width = 1.0, const VertexFormat &format = StandardVertex::Format());
 			// Create the geometry for a sphere
-            void CreateSphere(std::string object_name, float radius = 0.6, int num_samples_theta = 90, int num_samples_phi = 45);
-			void CreateCylinder(std::string object_name, float height = 1.0, float circle_radius = 0.6, int num_loop_samples = 90, int num_circle_samples = 30);
+            Resource *CreateSphere(std::string object_name, float radius = 0.6, int num_samples_theta = 90, int num_samples_phi = 45, const VertexFormat &format = StandardVertex::Format());
+			Resource *CreateCylinder(std::string object_name, float height = 1.0, float circle_radius = 0.6, int num_loop_samples = 90, int num_circle_samples = 30, const VertexFormat &format = StandardVertex::Format());
             void CreateRectangle(std::string object_name, float length = 3.0, float width = 0.5, float height = 1.0);
 
 			// "Wall", a flat object
             void CreateWall(std::string object_name);
             void CreateSquare(std::string object_name);
 
-            static std::vector<std::vector<float>> ReadHeightMap(const std::string& filename);
+            std::vector<std::vector<float>> ReadHeightMap(const std::string& filename) const;
+            // Compute model-space bounds of interleaved vertex data, where
+            // the position is stored first in each vertex
+            static void ComputeBounds(Resource *res, const GLfloat *vertex, int vertex_num, int vertex_att);
 
             void ResourceManager::CreateFireworkParticles(std::string object_name, int num_particles=100);
             void ResourceManager::CreateParticleEffect2(std::string object_name, int num_particles=10000);
             void ResourceManager::CreateParticleEffect3(std::string object_name, int num_particles=10000);
 
         private:
-            // List storing all resources
-            std::vector<Resource*> resource_; 
+            // Resources are held in Resource::GetTable()
+            int lod_levels_; // Levels of detail generated per mesh
+            bool print_stats_; // Print mesh optimization results
+            std::string cache_directory_; // Built meshes on disk
+            std::map<std::string, Resource *> geometry_cache_; // Generated meshes by key
+            std::list<VertexFormat> file_format_; // Layouts of meshes uploaded as files store them
+            std::map<std::string, Model> model_; // Node hierarchies of scene files
+            ResourcePack pack_; // Assets packed into one file
+            std::string pack_root_; // Directory of the packed files, normalized
+            size_t memory_budget_; // Bytes of GPU memory, 0 for no budget
+            size_t unmanaged_memory_; // Bytes reported by SetUnmanagedMemory
+            std::set<Resource *> evicted_; // Textures to load again when asked for
+            // Size of the storage of a buffer, 0 for no buffer
+            static size_t GetBufferSize(GLuint buffer);
+
+            // Texture decoded by a worker, waiting for its upload
+            struct DecodedTexture {
+                Resource *resource;
+                std::string filename;
+                // RGBA mip levels, full size first; none if decoding failed
+                std::vector<TextureLevel> level;
+                // Owner of the pixels: the cache file they were mapped
+                // from, or the levels decoded by the worker
+                std::shared_ptr<TextureCache> cache;
+                std::shared_ptr<std::vector<std::vector<unsigned char> > > decoded;
+                std::string error;
+            };
+            std::mutex texture_mutex_; // Guards the two members below
+            std::vector<DecodedTexture> decoded_texture_; // Ready for upload
+            int decoding_texture_num_; // Submitted but not decoded yet
+            int uploading_texture_num_; // Queued but not uploaded yet
+            // Decode an image file in memory with its mip levels, or map
+            // them from the cache when the same contents were decoded
+            // before; run by the workers
+            void DecodeTexture(DecodedTexture &texture, const char *data, size_t size) const;
+            // Upload a KTX texture to a resource: the file itself for a
+            // .ktx filename, otherwise the one next to the image. False if
+            // there is none, it is older than the image or its format is
+            // not supported
+            bool LoadKtxTexture(Resource *res, const char *filename);
+            // Load a texture from a file into a resource, in the
+            // background unless it is a KTX file
+            void StartTextureLoad(Resource *res, const char *filename);
+            // Queue decoded textures for upload; throws for the first that
+            // failed
+            void UploadTextures(std::vector<DecodedTexture> &texture);
+            UploadQueue upload_;
+
+            // Workers decoding assets; last, so they stop before the
+            // members they use are destroyed
+            ThreadPool worker_;
  
             // Methods to load specific types of resources
             // Load shaders programs
             void LoadMaterial(const std::string name, const char *prefix);
+            // Program compiled and linked without waiting for the driver,
+            // until UpdateMaterialLoads checks it
+            struct PendingProgram {
+                std::string name;
+                GLuint program;
+                GLuint shader[3]; // Vertex, fragment, geometry or 0
+                std::string key; // Program cache key and file, empty if
+                std::string path; // the program is not cached
+            };
+            std::vector<PendingProgram> pending_program_;
+            bool parallel_compile_set_; // Compiler threads requested
+            // Submit one shader for compilation
+            GLuint CompileShader(GLenum type, const std::string &source);
+            // Program from the cache, or submitted for compiling and
+            // linking
+            GLuint BuildProgram(const std::string name, const std::string &vp, const std::string &fp, const std::string &gp);
+            // Check the link of a submitted program, and cache it if it
+            // succeeded; sets error if it is the first to fail
+            void CheckProgram(const PendingProgram &pending, std::string &error);
             // Load a text file into memory (could be source code)
-            std::string LoadTextFile(const char *filename);
-            // Load a texture from an image file: png, jpg, etc.
+            std::string LoadTextFile(const char *filename) const;
+            // Load a texture from an image file: png, jpg, etc., decoded in
+            // the background like LoadTextureAsync
             void LoadTexture(const std::string name, const char *filename);
             // Loads a mesh in obj format
             void LoadMesh(const std::string name, const char *filename);
+            // Load the meshes and nodes of a binary glTF file. Vertex data
+            // goes to the buffers as the file lays it out; each primitive
+            // becomes a mesh named name/<mesh>/<primitive>, and name alone
+            // refers to the first one
+            void LoadModel(const std::string name, const char *filename);
+            // Optimize an indexed mesh for the post-transform cache and the
+            // vertex fetch, then upload it in a vertex layout. Overwrites
+            // the vertex and index arrays
+            Resource *UploadIndexedMesh(const std::string name, std::vector<VertexData> &vertex, GLuint *index, int index_num, const VertexFormat &format);
+            // Index the corners of a mesh in memory, sharing identical
+            // ones, and upload it as an optimized indexed mesh
+            Resource *UploadTriMesh(const std::string name, const TriMesh &mesh, bool added_normal, const VertexFormat &format);
+
+            // Generators for one level of detail of each procedural mesh
+            Resource *BuildTorus(std::string object_name, float loop_radius, float circle_radius, int num_loop_samples, int num_circle_samples, const VertexFormat &format);
+            Resource *BuildSeamlessTorus(std::string object_name, float loop_radius, float circle_radius, int num_loop_samples, int num_circle_samples, const VertexFormat &format);
+            Resource *BuildSphere(std::string object_name, float radius, int num_samples_theta, int num_samples_phi, const VertexFormat &format);
+            Resource *BuildCylinder(std::string object_name, float height, float circle_radius, int num_height_samples, int num_circle_samples, const VertexFormat &format);
+            // Name of a coarser level of detail of a resource
+            static std::string LodName(const std::string name, int level);
+
+            // Geometry cache
+            // Key of a built mesh: generator, parameters, vertex layout and
+            // levels of detail
+            std::string GeometryKey(const std::string generator, std::initializer_list<float> params, const VertexFormat &format) const;
+            // File of the cache directory holding the data of a key
+            std::string CachePath(const std::string key, const char *extension) const;
+            // Resource generated before with the same key, also known by
+            // name from now on; NULL if there is none
+            Resource *FindGeometry(const std::string key, const std::string name);
+            // Load a mesh and its levels of detail, in a vertex layout, from
+            // the cache file of a key; NULL if there is none or it was made
+            // from another version of the source file
+            Resource *LoadCachedMesh(const std::string key, const std::string name, const VertexFormat &format, unsigned long long source_time = 0, unsigned long long source_size = 0);
+            // Save a mesh and its levels of detail under a key
+            void SaveCachedMesh(const std::string key, const Resource *res, unsigned long long source_time = 0, unsigned long long source_size = 0);
             
 
     }; // class ResourceManager
@@ -0,0 +1,214 @@
+#include <string.h>
+#include <fstream>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <sys/stat.h>
+
+#include "resource_pack.h"
+
+namespace game {
+
+static const unsigned int pack_version = 2;
+
+// Files start on multiples of this many bytes
+static const unsigned int pack_alignment = 64;
+
+
+ResourcePack::ResourcePack(void){
+
+    header_ = NULL;
+    entry_ = NULL;
+    names_ = NULL;
+}
+
+
+ResourcePack::~ResourcePack(){
+}
+
+
+bool ResourcePack::Open(const char *filename){
+
+    Close();
+    if (!file_.Open(filename)){
+        return false;
+    }
+    const char *data = file_.GetData();
+    size_t size = file_.GetSize();
+
+    const PackHeader *header = (const PackHeader *) data;
+    if (size < sizeof(PackHeader) || memcmp(header->magic, "RPAK", 4) != 0 || header->version != pack_version){
+        file_.Close();
+        return false;
+    }
+    size_t names_offset = sizeof(PackHeader) + (size_t) header->entry_count * sizeof(PackEntry);
+    if (names_offset + header->name_bytes > size){
+        file_.Close();
+        return false;
+    }
+
+    // Reject entries outside the file once, so lookups need no checks
+    const PackEntry *entry = (const PackEntry *) (data + sizeof(PackHeader));
+    for (unsigned int i = 0; i < header->entry_count; i++){
+        if (entry[i].offset > size || entry[i].size > size - entry[i].offset ||
+            (size_t) entry[i].name_offset + entry[i].name_length > header->name_bytes){
+            file_.Close();
+            return false;
+        }
+    }
+
+    header_ = header;
+    entry_ = entry;
+    names_ = data + names_offset;
+    return true;
+}
+
+
+void ResourcePack::Close(void){
+
+    file_.Close();
+    header_ = NULL;
+    entry_ = NULL;
+    names_ = NULL;
+}
+
+
+bool ResourcePack::IsOpen(void) const {
+
+    return header_ != NULL;
+}
+
+
+bool ResourcePack::Find(const std::string &name, const char *&data, size_t &size, unsigned long long &source_time) const {
+
+    if (!header_){
+        return false;
+    }
+
+    // Binary search of the sorted table of contents
+    std::string key = NormalizeName(name);
+    int low = 0, high = (int) header_->entry_count - 1;
+    while (low <= high){
+        int mid = (low + high) / 2;
+        const PackEntry &e = entry_[mid];
+        size_t length = (e.name_length < key.size()) ? e.name_length : key.size();
+        int order = memcmp(names_ + e.name_offset, key.c_str(), length);
+        if (order == 0){
+            order = (e.name_length < key.size()) ? -1 : (e.name_length > key.size()) ? 1 : 0;
+        }
+        if (order == 0){
+            data = file_.GetData() + e.offset;
+            size = e.size;
+            source_time = e.source_time;
+            return true;
+        }
+        if (order < 0){
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return false;
+}
+
+
+std::string ResourcePack::NormalizeName(const std::string &name){
+
+    std::string result;
+    for (int i = 0; i < name.size(); i++){
+        char c = name[i];
+        if (c == '\\'){
+            c = '/';
+        } else if (c >= 'A' && c <= 'Z'){
+            c = c - 'A' + 'a';
+        }
+        // Collapse repeated separators
+        if (c == '/' && (result.empty() || result[result.size() - 1] == '/')){
+            continue;
+        }
+        result += c;
+    }
+    return result;
+}
+
+
+static bool EntryNameLess(const std::pair<std::string, int> &a, const std::pair<std::string, int> &b){
+
+    return a.first < b.first;
+}
+
+
+void ResourcePack::Write(const char *filename, const std::string &root, const std::vector<std::string> &names){
+
+    // Read every file first; packs hold a few megabytes of assets
+    std::vector<std::string> content(names.size());
+    std::vector<unsigned long long> source_time(names.size());
+    std::vector<std::pair<std::string, int> > sorted;
+    for (int i = 0; i < names.size(); i++){
+        std::string path = root + "/" + names[i];
+        std::ifstream in(path.c_str(), std::ios::binary);
+        if (!in){
+            throw(std::ios_base::failure(std::string("Error opening file ")+path));
+        }
+        content[i].assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        struct stat info;
+        source_time[i] = (stat(path.c_str(), &info) == 0) ? info.st_mtime : 0;
+        sorted.push_back(std::make_pair(NormalizeName(names[i]), i));
+    }
+    std::sort(sorted.begin(), sorted.end(), EntryNameLess);
+    for (int i = 1; i < sorted.size(); i++){
+        if (sorted[i].first == sorted[i - 1].first){
+            throw(std::ios_base::failure(std::string("File packed twice: ")+sorted[i].first));
+        }
+    }
+
+    // Table of contents in name order, data in the order given
+    PackHeader header;
+    memcpy(header.magic, "RPAK", 4);
+    header.version = pack_version;
+    header.entry_count = sorted.size();
+    header.name_bytes = 0;
+    std::vector<PackEntry> entry(sorted.size());
+    std::string name_data;
+    for (int i = 0; i < sorted.size(); i++){
+        entry[i].name_offset = name_data.size();
+        entry[i].name_length = sorted[i].first.size();
+        name_data += sorted[i].first;
+    }
+    header.name_bytes = name_data.size();
+
+    std::vector<unsigned long long> offset(names.size());
+    unsigned long long end = sizeof(PackHeader) + entry.size() * sizeof(PackEntry) + name_data.size();
+    for (int i = 0; i < names.size(); i++){
+        end = (end + pack_alignment - 1) / pack_alignment * pack_alignment;
+        offset[i] = end;
+        end += content[i].size();
+    }
+    for (int i = 0; i < sorted.size(); i++){
+        entry[i].offset = offset[sorted[i].second];
+        entry[i].size = content[sorted[i].second].size();
+        entry[i].source_time = source_time[sorted[i].second];
+    }
+
+    std::ofstream out(filename, std::ios::binary);
+    if (!out){
+        throw(std::ios_base::failure(std::string("Error opening file ")+std::string(filename)));
+    }
+    out.write((const char *) &header, sizeof(header));
+    if (entry.size() > 0){
+        out.write((const char *) &entry[0], entry.size() * sizeof(PackEntry));
+    }
+    out.write(name_data.c_str(), name_data.size());
+    static const char padding[pack_alignment] = { 0 };
+    unsigned long long position = sizeof(PackHeader) + entry.size() * sizeof(PackEntry) + name_data.size();
+    for (int i = 0; i < names.size(); i++){
+        out.write(padding, offset[i] - position);
+        out.write(content[i].c_str(), content[i].size());
+        position = offset[i] + content[i].size();
+    }
+    if (!out){
+        throw(std::ios_base::failure(std::string("Error writing file ")+std::string(filename)));
+    }
+}
+
+} // namespace game
@@ -0,0 +1,71 @@
+#ifndef RESOURCE_PACK_H_
+#define RESOURCE_PACK_H_
+
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+namespace game {
+
+    // Start of a pack file. It is followed by the table of contents, sorted
+    // by name, then the names, then the data of the files
+    struct PackHeader {
+        char magic[4]; // "RPAK"
+        unsigned int version;
+        unsigned int entry_count;
+        unsigned int name_bytes;
+    };
+
+    // One file of a pack; offsets are in bytes from the start of the pack
+    struct PackEntry {
+        unsigned long long offset;
+        unsigned long long size;
+        unsigned long long source_time; // Modification time of the file when packed
+        unsigned int name_offset;
+        unsigned int name_length;
+    };
+
+    // Assets concatenated into one file, mapped into memory once and
+    // looked up by name, so startup reads one file sequentially instead
+    // of opening each asset
+    //
+    // Names are paths relative to the root directory of the pack, with
+    // forward slashes and in lower case, so they match whatever separators
+    // and case the game uses for the same file
+    class ResourcePack {
+
+        public:
+            ResourcePack(void);
+            ~ResourcePack();
+
+            // Map a pack, closing any previous one; returns false if it is
+            // missing or damaged
+            bool Open(const char *filename);
+            void Close(void);
+            bool IsOpen(void) const;
+
+            // Contents of a file of the pack, and the modification time
+            // the file had when packed; false if it is not in it
+            bool Find(const std::string &name, const char *&data, size_t &size, unsigned long long &source_time) const;
+
+            // Pack the files with the given names under root. Data is laid
+            // out in the order given, which should be the order of loading,
+            // with every file aligned to pack_alignment bytes. Throws
+            // std::ios_base::failure if a file cannot be read or written
+            static void Write(const char *filename, const std::string &root, const std::vector<std::string> &names);
+
+            // Name of a file in a pack: separators and case normalized
+            static std::string NormalizeName(const std::string &name);
+
+        private:
+            MappedFile file_;
+            const PackHeader *header_;
+            const PackEntry *entry_;
+            const char *names_;
+
+    }; // class ResourcePack
+
+} // namespace game
+
+#endif // RESOURCE_PACK_H_
@@ -0,0 +1,94 @@
+#include "resource_table.h"
+
+namespace game {
+
+ResourceTable::ResourceTable(void){
+}
+
+
+ResourceTable::~ResourceTable(){
+}
+
+
+ResourceHandle ResourceTable::Add(Resource *res){
+
+    ResourceHandle handle;
+    if (free_.empty()){
+        handle.slot = (int) slot_.size();
+        slot_.push_back(res);
+        // Generation 0 is left to NO_RESOURCE
+        generation_.push_back(1);
+    } else {
+        handle.slot = free_.back();
+        free_.pop_back();
+        slot_[handle.slot] = res;
+    }
+    handle.generation = generation_[handle.slot];
+
+    res->SetHandle(handle);
+    AddName(res->GetName(), handle);
+    return handle;
+}
+
+
+void ResourceTable::AddName(const std::string &name, ResourceHandle handle){
+
+    // Does nothing for a name already taken
+    name_.insert(std::make_pair(name, handle));
+}
+
+
+Resource *ResourceTable::Remove(ResourceHandle handle){
+
+    Resource *res = Get(handle);
+    if (!res){
+        return NULL;
+    }
+
+    // Removing is rare; the names are found by walking the map
+    for (std::unordered_map<std::string, ResourceHandle>::iterator it = name_.begin(); it != name_.end(); ){
+        if (it->second.slot == handle.slot){
+            it = name_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    slot_[handle.slot] = NULL;
+    generation_[handle.slot]++;
+    free_.push_back(handle.slot);
+    res->SetHandle(NO_RESOURCE);
+    return res;
+}
+
+
+ResourceHandle ResourceTable::Find(const std::string &name) const {
+
+    std::unordered_map<std::string, ResourceHandle>::const_iterator it = name_.find(name);
+    if (it == name_.end()){
+        return NO_RESOURCE;
+    }
+    return it->second;
+}
+
+
+Resource *ResourceTable::Get(ResourceHandle handle) const {
+
+    if (handle.slot < 0 || handle.slot >= (int) slot_.size() || generation_[handle.slot] != handle.generation){
+        return NULL;
+    }
+    return slot_[handle.slot];
+}
+
+
+int ResourceTable::GetSize(void) const {
+
+    return (int) slot_.size();
+}
+
+
+Resource *ResourceTable::GetSlot(int slot) const {
+
+    return slot_[slot];
+}
+
+} // namespace game
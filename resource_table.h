@@ -0,0 +1,53 @@
+#ifndef RESOURCE_TABLE_H_
+#define RESOURCE_TABLE_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "resource.h"
+
+namespace game {
+
+    // Slots holding resources, found by handle in constant time and by
+    // name through a hash map
+    //
+    // Each slot counts its generations: removing a resource bumps the
+    // generation, so handles to it stop resolving instead of reaching the
+    // resource that reuses the slot
+    class ResourceTable {
+
+        public:
+            ResourceTable(void);
+            ~ResourceTable();
+
+            // Put a resource in a free slot under its name and set its
+            // handle. A name already taken keeps the resource it names
+            ResourceHandle Add(Resource *res);
+            // Another name for a resource in the table
+            void AddName(const std::string &name, ResourceHandle handle);
+            // Take a resource out along with its names. Returns it, or
+            // NULL for a handle that no longer resolves
+            Resource *Remove(ResourceHandle handle);
+
+            // Handle of the resource with a name, NO_RESOURCE if none
+            ResourceHandle Find(const std::string &name) const;
+            // Resource of a handle, NULL once removed
+            Resource *Get(ResourceHandle handle) const;
+
+            // Number of slots, and the resource in each; NULL for free
+            // slots
+            int GetSize(void) const;
+            Resource *GetSlot(int slot) const;
+
+        private:
+            std::vector<Resource *> slot_;
+            std::vector<unsigned int> generation_; // Current generation of each slot
+            std::vector<int> free_; // Slots to reuse
+            std::unordered_map<std::string, ResourceHandle> name_;
+
+    }; // class ResourceTable
+
+} // namespace game
+
+#endif // RESOURCE_TABLE_H_
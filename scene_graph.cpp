@@ -1,6 +1,7 @@
 #include <stdexcept>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #define GLM_FORCE_RADIANS
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -13,6 +14,14 @@ namespace game {
     SceneGraph::SceneGraph(void) {
 
         background_color_ = glm::vec3(0.0, 0.0, 0.0);
+        culling_ = true;
+        multi_draw_ = NULL;
+        cull_stats_.total = 0;
+        cull_stats_.visible = 0;
+        cull_stats_.culled = 0;
+        cull_stats_.triangles = 0;
+        lod_threshold_ = 0.0f;
+        cull_stats_.time_ms = 0.0;
     }
 
 
@@ -32,27 +41,118 @@ namespace game {
     }
 
 
-    SceneNode* SceneGraph::CreateNode(std::string node_name, Resource* geometry, Resource* material, Resource* texture) {
+    SceneNode* SceneGraph::CreateNode(const std::string &node_name, const Resource* geometry, const Resource* material, const Resource* texture) {
 
         // Create scene node with the specified resources
         SceneNode* scn = new SceneNode(node_name, geometry, material, texture);
 
         // Add node to the scene
-        node_.push_back(scn);
+        AddNode(scn);
 
         return scn;
     }
 
 
+    SceneNode* SceneGraph::CreateModel(std::string node_name, const Model* model, const Resource* material, const Resource* texture) {
+
+        // The roots of the model hang from one node placed in the scene
+        SceneNode* root = CreateNode(node_name, model->group, material, texture);
+        for (int i = 0; i < model->root.size(); i++) {
+            root->AddChild(CreateModelNode(node_name, model, model->root[i], material, texture));
+        }
+
+        return root;
+    }
+
+
+    SceneNode* SceneGraph::CreateModelNode(std::string prefix, const Model* model, int index, const Resource* material, const Resource* texture) {
+
+        const ModelNode& m = model->node[index];
+        std::stringstream name;
+        name << prefix << "/";
+        if (m.name.empty()) {
+            name << index;
+        } else {
+            name << m.name;
+        }
+
+        // A node draws its first primitive and holds the others as children;
+        // instanced nodes hold one such node per copy instead
+        int copies = (int) m.instance_position.size();
+        const Resource* geometry = (copies == 0 && m.geometry.size() > 0) ? m.geometry[0] : model->group;
+        SceneNode* node = new SceneNode(name.str(), geometry, material, texture);
+        node->SetPosition(m.position);
+        node->SetOrientation(m.orientation);
+        node->SetScale(m.scale);
+
+        for (int c = 0; c < ((copies > 0) ? copies : 1); c++) {
+            SceneNode* parent = node;
+            if (copies > 0 && m.geometry.size() > 0) {
+                std::stringstream copy_name;
+                copy_name << name.str() << "/instance" << c;
+                parent = new SceneNode(copy_name.str(), m.geometry[0], material, texture);
+                parent->SetPosition(m.instance_position[c]);
+                parent->SetOrientation(m.instance_orientation[c]);
+                parent->SetScale(m.instance_scale[c]);
+                node->AddChild(parent);
+            }
+            for (int p = 1; p < m.geometry.size(); p++) {
+                std::stringstream primitive_name;
+                primitive_name << parent->GetName() << "/" << p;
+                parent->AddChild(new SceneNode(primitive_name.str(), m.geometry[p], material, texture));
+            }
+        }
+
+        for (int i = 0; i < m.child.size(); i++) {
+            node->AddChild(CreateModelNode(name.str(), model, m.child[i], material, texture));
+        }
+
+        return node;
+    }
+
+
     void SceneGraph::AddNode(SceneNode* node) {
 
         node_.push_back(node);
+
+        // Bounds are computed on the first cull, once the node is placed
+        proxy_.push_back(NO_PROXY);
+        proxy_version_.push_back(0);
     }
 
     void SceneGraph::DeleteNode(std::string nodename) {
         for (int i = 0; i < node_.size(); i++) {
             if (node_[i]->GetName() == nodename) {
-                node_.erase(node_.begin() + i);
+                EraseNode(i);
+            }
+        }
+    }
+
+
+    void SceneGraph::RemoveNode(SceneNode* node) {
+
+        for (int i = 0; i < node_.size(); i++) {
+            if (node_[i] == node) {
+                EraseNode(i);
+                return;
+            }
+        }
+    }
+
+
+    void SceneGraph::EraseNode(int index) {
+
+        if (proxy_[index] != NO_PROXY) {
+            bvh_.Remove(proxy_[index]);
+        }
+        node_.erase(node_.begin() + index);
+        proxy_.erase(proxy_.begin() + index);
+        proxy_version_.erase(proxy_version_.begin() + index);
+
+        // Proxies refer to nodes by index
+        for (int i = index; i < node_.size(); i++) {
+            if (proxy_[i] != NO_PROXY) {
+                bvh_.SetData(proxy_[i], i);
             }
         }
     }
@@ -91,13 +191,150 @@ namespace game {
             background_color_[2], 0.0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        std::string prefix1 = "Wheel";
-        std::string prefix2 = "Antenna";
-        // Draw all scene nodes
+        // Rebuild the matrices of every node that moved in one linear pass
+        SceneNode::GetTransformStore().UpdateWorldMatrices();
+
+        Cull(camera);
+        DrawVisible(camera);
+    }
+
+
+    void SceneGraph::SetCulling(bool culling) {
+
+        culling_ = culling;
+    }
+
+
+    const CullStats &SceneGraph::GetCullStats(void) const {
+
+        return cull_stats_;
+    }
+
+
+    void SceneGraph::SetLodThreshold(float threshold) {
+
+        lod_threshold_ = threshold;
+    }
+
+
+    // Triangles drawn for a node and its children
+    static int CountTriangles(const SceneNode* node) {
+
+        int triangles = (node->GetMode() == GL_TRIANGLES) ? node->GetSize() / 3 : 0;
+        for (SceneNode* child = node->GetFirstChild(); child; child = child->GetNextSibling()) {
+            triangles += CountTriangles(child);
+        }
+        return triangles;
+    }
+
+
+    void SceneGraph::Cull(Camera* camera) {
+
+        double start_time = glfwGetTime();
+        TransformStore &store = SceneNode::GetTransformStore();
+
+        // Refresh the bounds of nodes that moved since the last frame;
+        // nodes with children are always refreshed since a child may move
+        // on its own
+        for (int i = 0; i < node_.size(); i++) {
+            SceneNode* node = node_[i];
+            unsigned int version = store.GetVersion(node->GetTransform());
+            if (version == proxy_version_[i] && !node->GetFirstChild()) {
+                continue;
+            }
+            proxy_version_[i] = version;
+
+            glm::vec3 min, max;
+            if (!node->GetWorldBounds(min, max)) {
+                if (proxy_[i] != NO_PROXY) {
+                    bvh_.Remove(proxy_[i]);
+                    proxy_[i] = NO_PROXY;
+                }
+            } else if (proxy_[i] == NO_PROXY) {
+                proxy_[i] = bvh_.Insert(min, max, i);
+            } else {
+                bvh_.Move(proxy_[i], min, max);
+            }
+        }
+
+        // Nodes without bounds are always drawn
+        visible_.assign(node_.size(), 0);
         for (int i = 0; i < node_.size(); i++) {
-            if (node_[i]->GetName().compare(0, prefix1.length(), prefix1) == 0) { continue; }
-            if (node_[i]->GetName().compare(0, prefix2.length(), prefix2) == 0) { continue; }
-            node_[i]->Draw(camera);
+            if (!culling_ || proxy_[i] == NO_PROXY) {
+                visible_[i] = 1;
+            }
+        }
+
+        if (culling_) {
+            Frustum frustum;
+            frustum.SetFromMatrix(camera->GetProjectionMatrix() * camera->GetViewMatrix());
+            query_.clear();
+            bvh_.Query(frustum, query_);
+            for (int i = 0; i < query_.size(); i++) {
+                visible_[query_[i]] = 1;
+            }
+        }
+
+        // Levels of detail only matter for what is drawn
+        if (lod_threshold_ > 0.0f) {
+            glm::vec3 eye = camera->GetPosition();
+            float projection_scale = camera->GetProjectionMatrix()[1][1];
+            for (int i = 0; i < node_.size(); i++) {
+                if (visible_[i]) {
+                    node_[i]->SelectLod(eye, projection_scale, lod_threshold_);
+                }
+            }
+        }
+
+        int visible = 0;
+        int triangles = 0;
+        for (int i = 0; i < visible_.size(); i++) {
+            if (visible_[i]) {
+                visible++;
+                triangles += CountTriangles(node_[i]);
+            }
+        }
+        cull_stats_.total = (int) node_.size();
+        cull_stats_.visible = visible;
+        cull_stats_.culled = cull_stats_.total - visible;
+        cull_stats_.triangles = triangles;
+        cull_stats_.time_ms = (glfwGetTime() - start_time) * 1000.0;
+    }
+
+
+    void SceneGraph::SetMultiDrawRenderer(MultiDrawRenderer* renderer) {
+
+        multi_draw_ = renderer;
+    }
+
+
+    void SceneGraph::AddImpostorField(ImpostorField* field) {
+
+        impostor_field_.push_back(field);
+    }
+
+
+    void SceneGraph::DrawVisible(Camera* camera) {
+
+        if (multi_draw_) {
+            for (int i = 0; i < node_.size(); i++) {
+                if (visible_[i]) {
+                    node_[i]->Submit(multi_draw_);
+                }
+            }
+            multi_draw_->Flush(camera);
+        } else {
+            // Draw root scene nodes in order; children are drawn by their parents
+            for (int i = 0; i < node_.size(); i++) {
+                if (visible_[i]) {
+                    node_[i]->Draw(camera);
+                }
+            }
+        }
+
+        // Fields cull their own instances
+        for (int i = 0; i < impostor_field_.size(); i++) {
+            impostor_field_[i]->Draw(camera);
         }
     }
 
@@ -110,27 +347,48 @@ namespace game {
     }
     void SceneGraph::SetupDrawToTexture(void) {
 
+        CreateRenderTarget(FRAME_BUFFER_WIDTH, FRAME_BUFFER_HEIGHT, GL_RGB, frame_buffer_, texture_, depth_buffer_);
+
+        // Set up quad for drawing to the screen
+        static const GLfloat quad_vertex_data[] = {
+            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+             1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+            -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
+            -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
+             1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+             1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
+        };
+
+        // Create buffer for quad
+        glGenBuffers(1, &quad_array_buffer_);
+        glBindBuffer(GL_ARRAY_BUFFER, quad_array_buffer_);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vertex_data), quad_vertex_data, GL_STATIC_DRAW);
+    }
+
+
+    void SceneGraph::CreateRenderTarget(GLsizei width, GLsizei height, GLenum format, GLuint &frame_buffer, GLuint &texture, GLuint &depth_buffer) {
+
         // Set up frame buffer
-        glGenFramebuffers(1, &frame_buffer_);
-        glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer_);
+        glGenFramebuffers(1, &frame_buffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
 
         // Set up target texture for rendering
-        glGenTextures(1, &texture_);
-        glBindTexture(GL_TEXTURE_2D, texture_);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
 
         // Set up an image for the texture
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, FRAME_BUFFER_WIDTH, FRAME_BUFFER_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, 0);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 
         // Set up a depth buffer for rendering
-        glGenRenderbuffers(1, &depth_buffer_);
-        glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, FRAME_BUFFER_WIDTH, FRAME_BUFFER_HEIGHT);
+        glGenRenderbuffers(1, &depth_buffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width, height);
 
         // Configure frame buffer (attach rendering buffers)
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_, 0);
-        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer_);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer);
         GLenum DrawBuffers[1] = { GL_COLOR_ATTACHMENT0 };
         glDrawBuffers(1, DrawBuffers);
 
@@ -141,21 +399,6 @@ namespace game {
 
         // Reset frame buffer
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        // Set up quad for drawing to the screen
-        static const GLfloat quad_vertex_data[] = {
-            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-             1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-            -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-            -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-             1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-             1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
-        };
-
-        // Create buffer for quad
-        glGenBuffers(1, &quad_array_buffer_);
-        glBindBuffer(GL_ARRAY_BUFFER, quad_array_buffer_);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vertex_data), quad_vertex_data, GL_STATIC_DRAW);
     }
 
 
@@ -175,10 +418,11 @@ namespace game {
             background_color_[2], 0.0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Draw all scene nodes
-        for (int i = 0; i < node_.size(); i++) {
-            node_[i]->Draw(camera);
-        }
+        // Rebuild the matrices of every node that moved in one linear pass
+        SceneNode::GetTransformStore().UpdateWorldMatrices();
+
+        Cull(camera);
+        DrawVisible(camera);
 
         // Reset frame buffer
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -10,6 +10,10 @@
 #include "scene_node.h"
 #include "resource.h"
 #include "camera.h"
+#include "bvh.h"
+#include "multi_draw.h"
+#include "impostor_field.h"
+#include "model.h"
 
 // Size of the texture that we will draw
 #define FRAME_BUFFER_WIDTH 1024
@@ -17,6 +21,15 @@
 
 namespace game {
 
+    // Statistics of the last culling pass
+    struct CullStats {
+        int total; // Root nodes in the scene
+        int visible; // Root nodes drawn
+        int culled; // Root nodes skipped
+        int triangles; // Triangles in the visible nodes, at their level of detail
+        double time_ms; // Time spent updating bounds and culling
+    };
+
     // Class that manages all the objects in a scene
     class SceneGraph {
 
@@ -27,6 +40,37 @@ namespace game {
         // Scene nodes to render
         std::vector<SceneNode*> node_;
 
+        // Frustum culling of root nodes
+        bool culling_;
+        BoundingVolumeHierarchy bvh_;
+        // Per node in node_: proxy in bvh_, NO_PROXY for nodes without
+        // bounds, and transform version its bounds were computed from
+        std::vector<int> proxy_;
+        std::vector<unsigned int> proxy_version_;
+        std::vector<unsigned char> visible_; // Per node: passed culling
+        std::vector<int> query_; // Scratch list of visible nodes
+        CullStats cull_stats_;
+
+        // Screen height fraction below which nodes use coarser levels of
+        // detail, 0 to always draw the full geometry
+        float lod_threshold_;
+
+        // Batched submission, NULL to draw node by node
+        MultiDrawRenderer* multi_draw_;
+
+        // Instanced fields drawn after the nodes
+        std::vector<ImpostorField*> impostor_field_;
+
+        // Remove the node at an index of node_
+        void EraseNode(int index);
+        // Refresh the bounds of moved nodes, mark visible ones and select
+        // their level of detail
+        void Cull(Camera* camera);
+        // Draw the root nodes that passed culling
+        void DrawVisible(Camera* camera);
+        // Node of a model and its descendants, not added to the scene
+        SceneNode* CreateModelNode(std::string prefix, const Model* model, int index, const Resource* material, const Resource* texture);
+
         // Frame buffer for drawing to texture
         GLuint frame_buffer_;
         // Quad vertex array for drawing from texture
@@ -45,10 +89,16 @@ namespace game {
         glm::vec3 GetBackgroundColor(void) const;
 
         // Create a scene node from the specified resources
-        SceneNode* CreateNode(std::string node_name, Resource* geometry, Resource* material, Resource* texture = NULL);
+        SceneNode* CreateNode(const std::string &node_name, const Resource* geometry, const Resource* material, const Resource* texture = NULL);
+        // Create the node hierarchy of a model under one root node named
+        // node_name; every mesh of the model uses the given material and
+        // texture
+        SceneNode* CreateModel(std::string node_name, const Model* model, const Resource* material, const Resource* texture = NULL);
         // Add an already-created node
         void AddNode(SceneNode* node);
         void DeleteNode(std::string nodename);
+        // Remove a node from the scene without deleting it
+        void RemoveNode(SceneNode* node);
         // Find a scene node with a specific name
         SceneNode* GetNode(std::string node_name) const;
         // Get node const iterator
@@ -58,12 +108,30 @@ namespace game {
         // Draw the entire scene
         void Draw(Camera* camera);
 
+        // Skip nodes outside the view of the camera when drawing
+        void SetCulling(bool culling);
+        // Statistics of the last drawn frame
+        const CullStats &GetCullStats(void) const;
+        // Switch visible nodes to coarser levels of detail once they cover
+        // less than this fraction of the screen height, 0 to disable
+        void SetLodThreshold(float threshold);
+
+        // Submit visible nodes through a multi-draw renderer, or draw
+        // them one by one if NULL
+        void SetMultiDrawRenderer(MultiDrawRenderer* renderer);
+
+        // Draw an instanced field with the scene; the field is not owned
+        void AddImpostorField(ImpostorField* field);
+
         // Update entire scene
         void Update(void);
 
         // Drawing from/to a texture
         // Setup the texture
         void SetupDrawToTexture(void);
+        // Create a frame buffer rendering into a new texture of the given
+        // size and format, with its own depth buffer
+        static void CreateRenderTarget(GLsizei width, GLsizei height, GLenum format, GLuint &frame_buffer, GLuint &texture, GLuint &depth_buffer);
         // Draw the scene into a texture
         void DrawToTexture(Camera* camera);
         // Process and draw the texture on the screen
@@ -4,8 +4,11 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
 #include <time.h>
+#include <math.h>
 
 #include "scene_node.h"
+#include "resource_table.h"
+#include "multi_draw.h"
 
 namespace game {
 
@@ -23,30 +26,75 @@ SceneNode::SceneNode(const std::string name, const Resource *geometry, const Res
         throw(std::invalid_argument(std::string("Invalid type of geometry")));
     }
 
-    array_buffer_ = geometry->GetArrayBuffer();
-    element_array_buffer_ = geometry->GetElementArrayBuffer();
-    size_ = geometry->GetSize();
+    has_bounds_ = geometry->HasBounds();
+    if (has_bounds_){
+        bounds_min_ = geometry->GetBoundsMin();
+        bounds_max_ = geometry->GetBoundsMax();
+    }
 
     // Set material (shader program)
     if (material->GetType() != Material){
         throw(std::invalid_argument(std::string("Invalid type of material")));
     }
 
-    material_ = material->GetResource();
-
-    // Set texture
+    // Handles rather than OpenGL names: a texture still loading, or
+    // evicted and loaded again, is read through its resource
+    geometry_ = geometry->GetHandle();
+    material_ = material->GetHandle();
+    texture_ = texture ? texture->GetHandle() : NO_RESOURCE;
+    // Kept from eviction while the node uses them
+    geometry->AddReference();
+    material->AddReference();
     if (texture){
-        texture_ = texture->GetResource();
-    } else {
-        texture_ = 0;
+        texture->AddReference();
     }
+    static_ = false;
+    lod_level_ = 0;
+    lod_size_ = has_bounds_ ? 2.0f * geometry->GetBoundsRadius() : 0.0f;
 
-    // Other attributes
-    scale_ = glm::vec3(1.0, 1.0, 1.0);
+    // Transform, starting at the identity
+    transform_ = GetTransformStore().Create();
+    GetTransformStore().SetOwner(transform_, this);
 }
 
 
 SceneNode::~SceneNode(){
+
+    // Detach from the hierarchy; children become roots
+    GetTransformStore().Release(transform_);
+    // Resources already removed hold no references
+    if (GetGeometryResource()){
+        GetGeometryResource()->RemoveReference();
+    }
+    if (GetMaterialResource()){
+        GetMaterialResource()->RemoveReference();
+    }
+    if (GetTextureResource()){
+        GetTextureResource()->RemoveReference();
+    }
+}
+
+
+TransformStore &SceneNode::GetTransformStore(void){
+
+    static TransformStore store;
+    return store;
+}
+
+
+// Node owning a transform, NULL for NO_TRANSFORM
+static SceneNode *GetNode(TransformHandle handle){
+
+    if (handle == NO_TRANSFORM){
+        return NULL;
+    }
+    return (SceneNode *) SceneNode::GetTransformStore().GetOwner(handle);
+}
+
+
+TransformHandle SceneNode::GetTransform(void) const {
+
+    return transform_;
 }
 
 
@@ -58,56 +106,150 @@ const std::string SceneNode::GetName(void) const {
 
 glm::vec3 SceneNode::GetPosition(void) const {
 
-    return position_;
+    return GetTransformStore().GetPosition(transform_);
 }
 
 
 glm::quat SceneNode::GetOrientation(void) const {
 
-    return orientation_;
+    return GetTransformStore().GetOrientation(transform_);
 }
 
 
 glm::vec3 SceneNode::GetScale(void) const {
 
-    return scale_;
+    return GetTransformStore().GetScale(transform_);
 }
 
 
 void SceneNode::SetPosition(glm::vec3 position){
 
-    position_ = position;
+    GetTransformStore().SetPosition(transform_, position);
 }
 
 
 void SceneNode::SetOrientation(glm::quat orientation){
 
-    orientation_ = orientation;
+    GetTransformStore().SetOrientation(transform_, orientation);
 }
 
 
 void SceneNode::SetScale(glm::vec3 scale){
 
-    scale_ = scale;
+    GetTransformStore().SetScale(transform_, scale);
 }
 
 
 void SceneNode::Translate(glm::vec3 trans){
 
-    position_ += trans;
+    TransformStore &store = GetTransformStore();
+    store.SetPosition(transform_, store.GetPosition(transform_) + trans);
 }
 
 
 void SceneNode::Rotate(glm::quat rot){
 
-    orientation_ *= rot;
-    orientation_ = glm::normalize(orientation_);
+    TransformStore &store = GetTransformStore();
+    store.SetOrientation(transform_, glm::normalize(store.GetOrientation(transform_) * rot));
 }
 
 
 void SceneNode::Scale(glm::vec3 scale){
 
-    scale_ *= scale;
+    TransformStore &store = GetTransformStore();
+    store.SetScale(transform_, store.GetScale(transform_) * scale);
+}
+
+
+void SceneNode::AddChild(SceneNode *child){
+
+    // The store unlinks the child from any previous parent
+    GetTransformStore().SetParent(child->transform_, transform_);
+}
+
+
+void SceneNode::RemoveChild(SceneNode *child){
+
+    TransformStore &store = GetTransformStore();
+    if (store.GetParent(child->transform_) == transform_){
+        store.SetParent(child->transform_, NO_TRANSFORM);
+    }
+}
+
+
+SceneNode *SceneNode::GetParent(void) const {
+
+    return GetNode(GetTransformStore().GetParent(transform_));
+}
+
+
+SceneNode *SceneNode::GetFirstChild(void) const {
+
+    return GetNode(GetTransformStore().GetFirstChild(transform_));
+}
+
+
+SceneNode *SceneNode::GetNextSibling(void) const {
+
+    return GetNode(GetTransformStore().GetNextSibling(transform_));
+}
+
+
+const glm::mat4 &SceneNode::GetWorldTransform(void){
+
+    return GetTransformStore().GetWorldMatrix(transform_);
+}
+
+
+const glm::mat4 &SceneNode::GetNormalMatrix(void){
+
+    return GetTransformStore().GetNormalMatrix(transform_);
+}
+
+
+bool SceneNode::GetWorldBounds(glm::vec3 &min, glm::vec3 &max){
+
+    // Nodes without geometry are bounded by their children alone
+    if (GetSize() == 0){
+        bool found = false;
+        for (SceneNode *child = GetFirstChild(); child; child = child->GetNextSibling()){
+            glm::vec3 child_min, child_max;
+            if (!child->GetWorldBounds(child_min, child_max)){
+                return false;
+            }
+            min = found ? glm::min(min, child_min) : child_min;
+            max = found ? glm::max(max, child_max) : child_max;
+            found = true;
+        }
+        return found;
+    }
+    if (!has_bounds_){
+        return false;
+    }
+
+    // Transform the center of the box, and bound the rotated extent with
+    // the absolute values of the matrix
+    const glm::mat4 &world = GetWorldTransform();
+    glm::vec3 center = glm::vec3(world * glm::vec4((bounds_min_ + bounds_max_) * 0.5f, 1.0f));
+    glm::vec3 extent = (bounds_max_ - bounds_min_) * 0.5f;
+    glm::vec3 world_extent;
+    for (int i = 0; i < 3; i++){
+        world_extent[i] = fabs(world[0][i]) * extent.x + fabs(world[1][i]) * extent.y + fabs(world[2][i]) * extent.z;
+    }
+    min = center - world_extent;
+    max = center + world_extent;
+
+    // Children are drawn with their parent, so they are culled with it too
+    for (SceneNode *child = GetFirstChild(); child; child = child->GetNextSibling()){
+        glm::vec3 child_min, child_max;
+        if (!child->GetWorldBounds(child_min, child_max)){
+            return false;
+        }
+        min = glm::min(min, child_min);
+        max = glm::max(max, child_max);
+    }
+
+    return true;
 }
 
 
@@ -119,49 +261,212 @@ GLenum SceneNode::GetMode(void) const {
 
 GLuint SceneNode::GetArrayBuffer(void) const {
 
-    return array_buffer_;
+    const Resource *geometry = GetLodGeometry();
+    return geometry ? geometry->GetArrayBuffer() : 0;
 }
 
 
 GLuint SceneNode::GetElementArrayBuffer(void) const {
 
-    return element_array_buffer_;
+    const Resource *geometry = GetLodGeometry();
+    return geometry ? geometry->GetElementArrayBuffer() : 0;
 }
 
 
 GLsizei SceneNode::GetSize(void) const {
 
-    return size_;
+    const Resource *geometry = GetLodGeometry();
+    return geometry ? geometry->GetSize() : 0;
+}
+
+
+GLenum SceneNode::GetIndexType(void) const {
+
+    const Resource *geometry = GetLodGeometry();
+    return geometry ? geometry->GetIndexType() : GL_UNSIGNED_INT;
 }
 
 
 GLuint SceneNode::GetMaterial(void) const {
 
-    return material_;
+    const Resource *material = GetMaterialResource();
+    return material ? material->GetResource() : 0;
+}
+
+
+GLuint SceneNode::GetTexture(void) const {
+
+    // Read through the resource: its texture may still be loading when
+    // the node is created
+    const Resource *texture = GetTextureResource();
+    return texture ? texture->GetResource() : 0;
+}
+
+
+const Resource *SceneNode::GetGeometryResource(void) const {
+
+    return Resource::GetTable().Get(geometry_);
+}
+
+
+const Resource *SceneNode::GetMaterialResource(void) const {
+
+    return Resource::GetTable().Get(material_);
+}
+
+
+const Resource *SceneNode::GetTextureResource(void) const {
+
+    return Resource::GetTable().Get(texture_);
+}
+
+
+void SceneNode::SetStatic(bool is_static){
+
+    static_ = is_static;
+}
+
+
+bool SceneNode::IsStatic(void) const {
+
+    return static_;
+}
+
+
+void SceneNode::SetLodSize(float size){
+
+    lod_size_ = size;
+}
+
+
+int SceneNode::GetLodLevel(void) const {
+
+    return lod_level_;
+}
+
+
+const Resource *SceneNode::GetLodGeometry(void) const {
+
+    const Resource *geometry = GetGeometryResource();
+    return geometry ? geometry->GetLod(lod_level_) : NULL;
+}
+
+
+int SceneNode::LodLevelFor(float fraction, float threshold, int level_count){
+
+    if (fraction >= threshold){
+        return 0;
+    }
+    if (fraction <= 0.0f){
+        return level_count - 1;
+    }
+    int level = 1 + (int) floor(log2(threshold / fraction));
+    return (level < level_count) ? level : level_count - 1;
+}
+
+
+void SceneNode::SelectLod(const glm::vec3 &eye, float projection_scale, float threshold){
+
+    // Fraction of a level's range around a switch point that keeps the
+    // current level, so nodes near the boundary do not flicker
+    const float hysteresis = 0.15f;
+
+    const Resource *geometry = GetGeometryResource();
+    int level_count = geometry ? geometry->GetLodCount() : 0;
+    glm::vec3 min, max;
+    if (level_count > 1 && lod_size_ > 0.0f && GetWorldBounds(min, max)){
+        // Distance to the box, zero when the eye is inside it
+        glm::vec3 outside = glm::max(glm::max(min - eye, eye - max), glm::vec3(0.0f));
+        float distance = glm::length(outside);
+
+        int level = 0;
+        if (distance > 0.0f){
+            const glm::mat4 &world = GetWorldTransform();
+            float scale = glm::length(glm::vec3(world[0]));
+            float scale_y = glm::length(glm::vec3(world[1]));
+            float scale_z = glm::length(glm::vec3(world[2]));
+            if (scale_y > scale){
+                scale = scale_y;
+            }
+            if (scale_z > scale){
+                scale = scale_z;
+            }
+            float fraction = lod_size_ * scale * projection_scale / (2.0f * distance);
+
+            level = lod_level_;
+            // A larger screen fraction selects a finer, lower level; keep
+            // the current level unless it leaves the band between them
+            int fine = LodLevelFor(fraction * (1.0f + hysteresis), threshold, level_count);
+            int coarse = LodLevelFor(fraction * (1.0f - hysteresis), threshold, level_count);
+            if (level < fine){
+                level = fine;
+            } else if (level > coarse){
+                level = coarse;
+            }
+        }
+
+        lod_level_ = level;
+    }
+
+    for (SceneNode *child = GetFirstChild(); child; child = child->GetNextSibling()){
+        child->SelectLod(eye, projection_scale, threshold);
+    }
 }
 
 
 void SceneNode::Draw(Camera *camera){
 
+    DrawGeometry(camera);
+
+    // Draw attached nodes
+    for (SceneNode *child = GetFirstChild(); child; child = child->GetNextSibling()){
+        child->Draw(camera);
+    }
+}
+
+
+void SceneNode::Submit(MultiDrawRenderer *renderer){
+
+    // Nodes the renderer cannot batch are drawn on their own after it
+    if (!renderer->Add(this)){
+        renderer->AddSingle(this);
+    }
+
+    for (SceneNode *child = GetFirstChild(); child; child = child->GetNextSibling()){
+        child->Submit(renderer);
+    }
+}
+
+
+void SceneNode::DrawGeometry(Camera *camera){
+
+    // Nodes without geometry only place their children
+    const Resource *geometry = GetLodGeometry();
+    const Resource *material = GetMaterialResource();
+    if (!geometry || !material || geometry->GetSize() == 0){
+        return;
+    }
+    GLuint program = material->GetResource();
+
     // Select proper material (shader program)
-    glUseProgram(material_);
+    glUseProgram(program);
 
     // Set geometry to draw
-    glBindBuffer(GL_ARRAY_BUFFER, array_buffer_);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_array_buffer_);
+    glBindBuffer(GL_ARRAY_BUFFER, geometry->GetArrayBuffer());
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry->GetElementArrayBuffer());
 
     // Set globals for camera
-    camera->SetupShader(material_);
+    camera->SetupShader(program);
 
     // Set world matrix and other shader input variables
-    SetupShader(material_);
+    SetupShader(program);
 
     // Draw geometry
     if (mode_ == GL_POINTS){
-        glDrawArrays(mode_, 0, size_);
+        glDrawArrays(mode_, 0, geometry->GetSize());
     } else {
        // glDrawElementsInstanced(mode_, size_, GL_UNSIGNED_INT, 0, 200);
-		glDrawElements(mode_, size_, GL_UNSIGNED_INT, 0);
+		glDrawElements(mode_, geometry->GetSize(), geometry->GetIndexType(), 0);
     }
 }
 
@@ -174,49 +479,30 @@ void SceneNode::Update(void){
 
 void SceneNode::SetupShader(GLuint program){
 
-	
-    // Set attributes for shaders
-    GLint vertex_att = glGetAttribLocation(program, "vertex");
-    glVertexAttribPointer(vertex_att, 3, GL_FLOAT, GL_FALSE, 11*sizeof(GLfloat), 0);
-    glEnableVertexAttribArray(vertex_att);
-
-    GLint normal_att = glGetAttribLocation(program, "normal");
-    glVertexAttribPointer(normal_att, 3, GL_FLOAT, GL_FALSE, 11*sizeof(GLfloat), (void *) (3*sizeof(GLfloat)));
-    glEnableVertexAttribArray(normal_att);
-
-    GLint color_att = glGetAttribLocation(program, "color");
-    glVertexAttribPointer(color_att, 3, GL_FLOAT, GL_FALSE, 11*sizeof(GLfloat), (void *) (6*sizeof(GLfloat)));
-    glEnableVertexAttribArray(color_att);
-
-    GLint tex_att = glGetAttribLocation(program, "uv");
-    glVertexAttribPointer(tex_att, 2, GL_FLOAT, GL_FALSE, 11*sizeof(GLfloat), (void *) (9*sizeof(GLfloat)));
-    glEnableVertexAttribArray(tex_att);
-      
-    // World transformation
-    glm::mat4 scaling = glm::scale(glm::mat4(1.0), scale_);
-    
-    glm::mat4 rotation = glm::mat4_cast(orientation_);
-    glm::mat4 translation = glm::translate(glm::mat4(1.0), position_);
-	
-    glm::mat4 orbit = glm::mat4(1.0); // identity -- left out for now
-    glm::mat4 transf = translation * orbit * rotation * scaling;
+    // Attributes follow the vertex layout of the mesh being drawn
+    GetLodGeometry()->GetVertexFormat().SetupAttributes(program);
 
+    // World transformation, cached until the node or an ancestor moves
     GLint world_mat = glGetUniformLocation(program, "world_mat");
-    glUniformMatrix4fv(world_mat, 1, GL_FALSE, glm::value_ptr(transf));
+    glUniformMatrix4fv(world_mat, 1, GL_FALSE, glm::value_ptr(GetWorldTransform()));
 
     // Normal matrix
-    glm::mat4 normal_matrix = glm::transpose(glm::inverse(transf));
     GLint normal_mat = glGetUniformLocation(program, "normal_mat");
-    glUniformMatrix4fv(normal_mat, 1, GL_FALSE, glm::value_ptr(normal_matrix));
+    glUniformMatrix4fv(normal_mat, 1, GL_FALSE, glm::value_ptr(GetNormalMatrix()));
+
+    SetupMaterial(program, GetTexture());
+}
+
+
+void SceneNode::SetupMaterial(GLuint program, GLuint texture){
 
     // Texture
-    if (texture_){
+    if (texture){
         GLint tex = glGetUniformLocation(program, "texture_map");
         glUniform1i(tex, 0); // Assign the first texture to the map
         glActiveTexture(GL_TEXTURE0); 
-        glBindTexture(GL_TEXTURE_2D, texture_); // First texture we bind
-        // Define texture interpolation
-        glGenerateMipmap(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, texture); // First texture we bind
+        // Define texture interpolation; mip levels come with the texture
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
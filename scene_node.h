@@ -2,6 +2,7 @@
 #define SCENE_NODE_H_
 
 #include <string>
+#include <vector>
 #define GLEW_STATIC
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -12,9 +13,12 @@
 
 #include "resource.h"
 #include "camera.h"
+#include "transform_store.h"
 
 namespace game {
 
+    class MultiDrawRenderer;
+
     // Class that manages one object in a scene 
     class SceneNode {
 
@@ -22,8 +26,9 @@ namespace game {
             // Create scene node from given resources
             SceneNode(const std::string name, const Resource *geometry, const Resource *material, const Resource *texture = NULL);
 
-            // Destructor
-            ~SceneNode();
+            // Destructor; virtual as subclasses are deleted through
+            // SceneNode pointers
+            virtual ~SceneNode();
             
             // Get name of node
             const std::string GetName(void) const;
@@ -45,9 +50,42 @@ namespace game {
             virtual void Rotate(glm::quat rot);
             void Scale(glm::vec3 scale);
 
+            // Hierarchy: children are transformed relative to their parent
+            // and drawn together with it. The links live in the transform
+            // store; children are walked from GetFirstChild through
+            // GetNextSibling until NULL
+            void AddChild(SceneNode *child);
+            void RemoveChild(SceneNode *child);
+            SceneNode *GetParent(void) const;
+            SceneNode *GetFirstChild(void) const;
+            SceneNode *GetNextSibling(void) const;
+
+            // Get cached transformation matrices, rebuilding them only if
+            // the node or one of its ancestors moved
+            const glm::mat4 &GetWorldTransform(void);
+            const glm::mat4 &GetNormalMatrix(void);
+
+            // World-space axis-aligned bounds of the node and its children;
+            // returns false if they are unknown and the node cannot be culled
+            virtual bool GetWorldBounds(glm::vec3 &min, glm::vec3 &max);
+
+            // Slot of this node in the shared transform store
+            TransformHandle GetTransform(void) const;
+            // Store holding the transforms of all scene nodes
+            static TransformStore &GetTransformStore(void);
+
             // Draw the node according to scene parameters in 'camera'
             // variable
             virtual void Draw(Camera *camera);
+            // Draw only this node, without its children
+            void DrawGeometry(Camera *camera);
+            // Queue the node and its children in a multi-draw renderer
+            // instead of drawing them right away
+            virtual void Submit(MultiDrawRenderer *renderer);
+
+            // Shader setup shared with renderers that draw nodes in bulk
+            // Set texture, lighting and timer uniforms of a program
+            static void SetupMaterial(GLuint program, GLuint texture);
 
             // Update the node
             virtual void Update(void);
@@ -57,19 +95,50 @@ namespace game {
             GLuint GetArrayBuffer(void) const;
             GLuint GetElementArrayBuffer(void) const;
             GLsizei GetSize(void) const;
+            GLenum GetIndexType(void) const;
             GLuint GetMaterial(void) const;
+            GLuint GetTexture(void) const;
+
+            // Resources the node was created from
+            const Resource *GetGeometryResource(void) const;
+            const Resource *GetMaterialResource(void) const;
+            const Resource *GetTextureResource(void) const;
+
+            // Static nodes never move once placed and may be merged into
+            // static batches
+            void SetStatic(bool is_static);
+            bool IsStatic(void) const;
+
+            // Level of detail: nodes switch to the coarser levels of their
+            // geometry as their projected size shrinks
+            // Size of the node in model space used to estimate its size on
+            // screen; defaults to the diameter of the geometry bounds
+            void SetLodSize(float size);
+            // Select the level of the node and its children seen from eye;
+            // projection_scale is element [1][1] of the projection matrix and
+            // threshold the fraction of the screen height below which the
+            // first coarser level is used
+            void SelectLod(const glm::vec3 &eye, float projection_scale, float threshold);
+            int GetLodLevel(void) const;
+            // Level for a node covering a fraction of the screen height:
+            // each level halves the size at which it takes over
+            static int LodLevelFor(float fraction, float threshold, int level_count);
+            // Geometry of the current level
+            const Resource *GetLodGeometry(void) const;
 
         private:
             std::string name_; // Name of the scene node
-            GLuint array_buffer_; // References to geometry: vertex and array buffers
-            GLuint element_array_buffer_;
             GLenum mode_; // Type of geometry
-            GLsizei size_; // Number of primitives in geometry
-            GLuint material_; // Reference to shader program
-            GLuint texture_; // Reference to texture resource
-            glm::vec3 position_; // Position of node
-            glm::quat orientation_; // Orientation of node
-            glm::vec3 scale_; // Scale of node
+            ResourceHandle geometry_; // Resources the node was created from
+            ResourceHandle material_;
+            ResourceHandle texture_; // NO_RESOURCE without a texture
+            bool static_; // Whether the node never moves
+            int lod_level_; // Current level of detail, 0 is the full geometry
+            float lod_size_; // Model-space size used to select the level
+            TransformHandle transform_; // Position, orientation and scale in the transform store
+            bool has_bounds_; // Whether the geometry has bounds
+            glm::vec3 bounds_min_; // Bounding box of the geometry in model space
+            glm::vec3 bounds_max_;
 
             // Set matrices that transform the node in a shader program
             void SetupShader(GLuint program);
@@ -0,0 +1,271 @@
+#include <map>
+#include <sstream>
+#include <math.h>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/quaternion.hpp>
+
+#include "static_batch.h"
+
+namespace game {
+
+// Geometry of a mesh, read back from its buffers and unpacked
+struct SourceMesh {
+    std::vector<VertexData> vertex;
+    std::vector<GLuint> index;
+};
+
+// Nodes merged together: same material, texture, vertex layout and grid
+// cell
+struct BatchKey {
+    GLuint material;
+    GLuint texture;
+    const VertexFormat *format;
+    int cell_x;
+    int cell_z;
+
+    bool operator<(const BatchKey &other) const {
+        if (material != other.material) return material < other.material;
+        if (texture != other.texture) return texture < other.texture;
+        if (format != other.format) return format < other.format;
+        if (cell_x != other.cell_x) return cell_x < other.cell_x;
+        return cell_z < other.cell_z;
+    }
+};
+
+
+// Copy the vertices and indices of a mesh back from the GPU
+static void ReadMesh(const Resource *geometry, SourceMesh &mesh){
+
+    const VertexFormat &format = geometry->GetVertexFormat();
+    GLint size;
+    glBindBuffer(GL_ARRAY_BUFFER, geometry->GetArrayBuffer());
+    glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
+    std::vector<GLubyte> packed(size);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, size, &packed[0]);
+    mesh.vertex.resize(size / format.stride);
+    for (int v = 0; v < mesh.vertex.size(); v++){
+        format.unpack(&packed[v * format.stride], mesh.vertex[v]);
+    }
+
+    // Merged chunks may exceed 16-bit indices, so they are widened
+    mesh.index.resize(geometry->GetSize());
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry->GetElementArrayBuffer());
+    if (geometry->GetIndexType() == GL_UNSIGNED_SHORT){
+        std::vector<GLushort> short_index(mesh.index.size());
+        glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, short_index.size() * sizeof(GLushort), &short_index[0]);
+        mesh.index.assign(short_index.begin(), short_index.end());
+    } else {
+        glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, mesh.index.size() * sizeof(GLuint), &mesh.index[0]);
+    }
+}
+
+
+// Append a mesh transformed to world space
+static void AppendMesh(const SourceMesh &mesh, const glm::mat4 &world, const glm::mat4 &normal_mat, std::vector<VertexData> &vertex, std::vector<GLuint> &index){
+
+    GLuint base = vertex.size();
+    for (unsigned int v = 0; v < mesh.vertex.size(); v++){
+        VertexData dst = mesh.vertex[v];
+        dst.position = glm::vec3(world * glm::vec4(dst.position, 1.0f));
+        dst.normal = glm::vec3(normal_mat * glm::vec4(dst.normal, 0.0f));
+        if (glm::dot(dst.normal, dst.normal) > 0.0f){
+            dst.normal = glm::normalize(dst.normal);
+        }
+        vertex.push_back(dst);
+    }
+    for (int f = 0; f < mesh.index.size(); f++){
+        index.push_back(base + mesh.index[f]);
+    }
+}
+
+
+StaticBatcher::StaticBatcher(float cell_size, size_t memory_budget, unsigned int max_chunk_vertices){
+
+    cell_size_ = cell_size;
+    memory_budget_ = memory_budget;
+    max_chunk_vertices_ = max_chunk_vertices;
+    merged_count_ = 0;
+    chunk_count_ = 0;
+    memory_used_ = 0;
+    lod_size_ = 0.0f;
+    format_ = NULL;
+}
+
+
+StaticBatcher::~StaticBatcher(){
+}
+
+
+void StaticBatcher::Build(SceneGraph *scene, ResourceManager *resman){
+
+    merged_count_ = 0;
+    chunk_count_ = 0;
+    memory_used_ = 0;
+
+    // Group static root nodes; nodes with children or point sets are
+    // drawn on their own
+    std::map<BatchKey, std::vector<SceneNode *> > group;
+    for (std::vector<SceneNode *>::const_iterator it = scene->begin(); it != scene->end(); it++){
+        SceneNode *node = *it;
+        if (!node->IsStatic() || node->GetFirstChild() || node->GetMode() != GL_TRIANGLES){
+            continue;
+        }
+        // Meshes in the layout of a file cannot be unpacked and merged
+        if (!node->GetGeometryResource()->GetVertexFormat().unpack || node->GetSize() == 0){
+            continue;
+        }
+        glm::vec3 position = node->GetPosition();
+        BatchKey key;
+        key.material = node->GetMaterial();
+        key.texture = node->GetTexture();
+        key.format = &node->GetGeometryResource()->GetVertexFormat();
+        key.cell_x = (int) floor(position.x / cell_size_);
+        key.cell_z = (int) floor(position.z / cell_size_);
+        group[key].push_back(node);
+    }
+
+    // Source geometry is read back once per mesh
+    std::map<const Resource *, SourceMesh> source;
+    std::vector<SceneNode *> merged;
+
+    for (std::map<BatchKey, std::vector<SceneNode *> >::iterator g = group.begin(); g != group.end(); g++){
+        std::vector<SceneNode *> &nodes = g->second;
+        // A single node gains nothing from batching
+        if (nodes.size() < 2){
+            continue;
+        }
+
+        // The chunk has as many levels as its most detailed member
+        int level_count = 1;
+        for (int i = 0; i < nodes.size(); i++){
+            int count = nodes[i]->GetGeometryResource()->GetLodCount();
+            if (count > level_count){
+                level_count = count;
+            }
+        }
+        vertex_.assign(level_count, std::vector<VertexData>());
+        index_.assign(level_count, std::vector<GLuint>());
+        lod_size_ = 0.0f;
+        format_ = g->first.format;
+
+        for (int i = 0; i < nodes.size(); i++){
+            SceneNode *node = nodes[i];
+            const Resource *geometry = node->GetGeometryResource();
+
+            // Members with fewer levels repeat their coarsest one
+            std::vector<const SourceMesh *> mesh(level_count);
+            size_t bytes = 0;
+            for (int level = 0; level < level_count; level++){
+                const Resource *lod = geometry->GetLod(level);
+                if (source.find(lod) == source.end()){
+                    ReadMesh(lod, source[lod]);
+                }
+                mesh[level] = &source[lod];
+                bytes += mesh[level]->vertex.size() * format_->stride + mesh[level]->index.size() * sizeof(GLuint);
+            }
+
+            if (memory_used_ + bytes > memory_budget_){
+                continue;
+            }
+            // The finest level is the largest
+            unsigned int vertex_num = mesh[0]->vertex.size();
+            if (vertex_[0].size() + vertex_num > max_chunk_vertices_ && vertex_[0].size() > 0){
+                Flush(scene, resman, nodes[0]);
+            }
+
+            const glm::mat4 &world = node->GetWorldTransform();
+            const glm::mat4 &normal_mat = node->GetNormalMatrix();
+            for (int level = 0; level < level_count; level++){
+                AppendMesh(*mesh[level], world, normal_mat, vertex_[level], index_[level]);
+            }
+
+            // Levels are chosen for the largest member of the chunk
+            if (geometry->HasBounds()){
+                glm::vec3 scale = node->GetScale();
+                float max_scale = fabs(scale.x);
+                if (fabs(scale.y) > max_scale){
+                    max_scale = fabs(scale.y);
+                }
+                if (fabs(scale.z) > max_scale){
+                    max_scale = fabs(scale.z);
+                }
+                float size = 2.0f * geometry->GetBoundsRadius() * max_scale;
+                if (size > lod_size_){
+                    lod_size_ = size;
+                }
+            }
+
+            memory_used_ += bytes;
+            merged.push_back(node);
+        }
+
+        if (vertex_[0].size() > 0){
+            Flush(scene, resman, nodes[0]);
+        }
+    }
+
+    // The chunks replace the merged nodes
+    for (int i = 0; i < merged.size(); i++){
+        scene->RemoveNode(merged[i]);
+        delete merged[i];
+    }
+    merged_count_ = (int) merged.size();
+}
+
+
+void StaticBatcher::Flush(SceneGraph *scene, ResourceManager *resman, const SceneNode *source){
+
+    std::stringstream ss;
+    ss << "StaticBatch" << chunk_count_;
+
+    Resource *geom = NULL;
+    for (int level = 0; level < vertex_.size(); level++){
+        std::stringstream name;
+        name << ss.str();
+        if (level > 0){
+            name << "_LOD" << level;
+        }
+
+        // Chunks keep the vertex layout of their members
+        Resource *res = resman->UploadVertices(name.str(), &vertex_[level][0], vertex_[level].size(), &index_[level][0], index_[level].size(), *format_);
+        if (level == 0){
+            geom = res;
+        } else {
+            geom->AddLod(res);
+        }
+
+        vertex_[level].clear();
+        index_[level].clear();
+    }
+
+    // Vertices are already in world space, so the node keeps the identity
+    SceneNode *chunk = scene->CreateNode(ss.str(), geom, source->GetMaterialResource(), source->GetTextureResource());
+    chunk->SetStatic(true);
+    if (lod_size_ > 0.0f){
+        chunk->SetLodSize(lod_size_);
+    }
+    // The next chunk of a split group starts from its own members
+    lod_size_ = 0.0f;
+
+    chunk_count_++;
+}
+
+
+int StaticBatcher::GetMergedCount(void) const {
+
+    return merged_count_;
+}
+
+
+int StaticBatcher::GetChunkCount(void) const {
+
+    return chunk_count_;
+}
+
+
+size_t StaticBatcher::GetMemoryUsed(void) const {
+
+    return memory_used_;
+}
+
+} // namespace game
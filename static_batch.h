@@ -0,0 +1,66 @@
+#ifndef STATIC_BATCH_H_
+#define STATIC_BATCH_H_
+
+#include <string>
+#include <vector>
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "scene_graph.h"
+#include "resource_manager.h"
+
+namespace game {
+
+    // Merges static scene nodes into pre-transformed meshes
+    //
+    // Nodes that share a material and texture and lie in the same cell of
+    // a square grid on the xz plane end up in one chunk: a single mesh in
+    // world space drawn with one call and culled as a unit. Larger cells
+    // mean fewer draws but coarser culling, and every merged node costs a
+    // full copy of its geometry, so the total is capped by a memory budget.
+    // Chunks get one mesh per level of detail of their nodes, so distant
+    // chunks draw the merged coarse levels
+    class StaticBatcher {
+
+        public:
+            // cell_size: side of the grid cells, in world units
+            // memory_budget: bytes of merged geometry; nodes past it keep
+            // their own draw call
+            // max_chunk_vertices: a cell is split into several chunks
+            // above this size
+            StaticBatcher(float cell_size, size_t memory_budget, unsigned int max_chunk_vertices = 1 << 20);
+            ~StaticBatcher();
+
+            // Replace the static root nodes of the scene by chunk nodes;
+            // the merged nodes are removed from the scene and deleted
+            void Build(SceneGraph *scene, ResourceManager *resman);
+
+            // Results of the last build
+            int GetMergedCount(void) const;
+            int GetChunkCount(void) const;
+            size_t GetMemoryUsed(void) const;
+
+        private:
+            float cell_size_;
+            size_t memory_budget_;
+            unsigned int max_chunk_vertices_;
+
+            int merged_count_; // Nodes replaced by chunks
+            int chunk_count_; // Chunk nodes created
+            size_t memory_used_; // Bytes of chunk geometry
+
+            // Geometry being accumulated for one chunk, per level of detail
+            std::vector<std::vector<VertexData> > vertex_;
+            std::vector<std::vector<GLuint> > index_;
+            float lod_size_; // Largest node in the chunk, in world units
+            const VertexFormat *format_; // Layout shared by the chunk
+
+            // Upload the accumulated geometry as new mesh resources, one
+            // per level, and add a node drawing them to the scene
+            void Flush(SceneGraph *scene, ResourceManager *resman, const SceneNode *source);
+
+    }; // class StaticBatcher
+
+} // namespace game
+
+#endif // STATIC_BATCH_H_
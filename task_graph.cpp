@@ -0,0 +1,218 @@
+#include <chrono>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "task_graph.h"
+
+namespace game {
+
+TaskGraph::TaskGraph(ThreadPool &pool) : pool_(pool){
+
+    done_ = 0;
+    running_ = 0;
+    started_ = false;
+    run_start_ = 0.0;
+}
+
+
+TaskGraph::~TaskGraph(){
+
+    // Submitted tasks refer to the graph
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_ > 0){
+        wake_.wait(lock);
+    }
+}
+
+
+int TaskGraph::Add(const std::string name, std::function<void(void)> work, std::vector<int> depends){
+
+    return AddTask(name, [work](){ work(); return true; }, depends, false);
+}
+
+
+int TaskGraph::AddMain(const std::string name, std::function<void(void)> work, std::vector<int> depends){
+
+    return AddTask(name, [work](){ work(); return true; }, depends, true);
+}
+
+
+int TaskGraph::AddPoll(const std::string name, std::function<bool(void)> poll, std::vector<int> depends){
+
+    return AddTask(name, poll, depends, true);
+}
+
+
+int TaskGraph::AddTask(const std::string name, std::function<bool(void)> work, std::vector<int> depends, bool main){
+
+    int index = (int) task_.size();
+    Task task;
+    task.name = name;
+    task.work = work;
+    task.main = main;
+    task.waiting = 0;
+    task.start = -1.0;
+    task.end = 0.0;
+    for (int i = 0; i < depends.size(); i++){
+        if (depends[i] < 0 || depends[i] >= index){
+            throw(std::invalid_argument(std::string("Task ")+name+std::string(" depends on a task not added before it")));
+        }
+        // Listed twice, released once
+        if (std::find(task.depends.begin(), task.depends.end(), depends[i]) != task.depends.end()){
+            continue;
+        }
+        task.depends.push_back(depends[i]);
+        task_[depends[i]].dependent.push_back(index);
+        task.waiting++;
+    }
+    task_.push_back(task);
+    return index;
+}
+
+
+bool TaskGraph::RunFor(double seconds){
+
+    double deadline = Now() + seconds;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!started_){
+        started_ = true;
+        run_start_ = Now();
+        for (int i = 0; i < task_.size(); i++){
+            if (task_[i].waiting == 0){
+                Start(i);
+            }
+        }
+    }
+
+    // Polls not done are called again next slice, not in this one
+    std::deque<int> polled;
+    bool first = true;
+    while (!error_ && !ready_main_.empty() && (first || Now() < deadline)){
+        int index = ready_main_.front();
+        ready_main_.pop_front();
+        lock.unlock();
+        bool done = Execute(index);
+        lock.lock();
+        if (!done){
+            polled.push_back(index);
+        }
+        first = false;
+    }
+    ready_main_.insert(ready_main_.end(), polled.begin(), polled.end());
+
+    if (error_){
+        // Workers still refer to the graph
+        if (running_ > 0){
+            return false;
+        }
+        std::rethrow_exception(error_);
+    }
+    return done_ == task_.size();
+}
+
+
+float TaskGraph::GetProgress(void) const {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    return task_.empty() ? 1.0f : (float) done_ / task_.size();
+}
+
+
+std::string TaskGraph::GetCriticalPath(void) const {
+
+    if (task_.empty()){
+        return std::string("");
+    }
+
+    // Walk back from the last task to end through the dependency that
+    // ended last, which is the one it waited for
+    std::vector<int> path;
+    int index = 0;
+    for (int i = 1; i < task_.size(); i++){
+        if (task_[i].end > task_[index].end){
+            index = i;
+        }
+    }
+    while (index >= 0){
+        path.push_back(index);
+        const Task &task = task_[index];
+        index = -1;
+        for (int i = 0; i < task.depends.size(); i++){
+            if (index < 0 || task_[task.depends[i]].end > task_[index].end){
+                index = task.depends[i];
+            }
+        }
+    }
+
+    std::stringstream ss;
+    for (int i = (int) path.size() - 1; i >= 0; i--){
+        const Task &task = task_[path[i]];
+        ss << task.name << " " << (int) ((task.end - task.start) * 1000.0) << " ms";
+        if (i > 0){
+            ss << " > ";
+        }
+    }
+    return ss.str();
+}
+
+
+void TaskGraph::Start(int index){
+
+    if (task_[index].main){
+        ready_main_.push_back(index);
+    } else {
+        running_++;
+        pool_.Submit([this, index](){ Execute(index); });
+    }
+}
+
+
+bool TaskGraph::Execute(int index){
+
+    Task &task = task_[index];
+    double start = Now();
+    bool done = true;
+    std::exception_ptr error;
+    try {
+        done = task.work();
+    }
+    catch (...){
+        error = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // A poll counts from its first call
+    if (task.start < 0.0){
+        task.start = start - run_start_;
+    }
+    if (!done && !error){
+        return false;
+    }
+    task.end = Now() - run_start_;
+    if (!task.main){
+        running_--;
+    }
+    done_++;
+    if (error){
+        if (!error_){
+            error_ = error;
+        }
+    } else if (!error_){
+        for (int i = 0; i < task.dependent.size(); i++){
+            if (--task_[task.dependent[i]].waiting == 0){
+                Start(task.dependent[i]);
+            }
+        }
+    }
+    wake_.notify_all();
+    return true;
+}
+
+
+double TaskGraph::Now(void){
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace game
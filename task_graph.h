@@ -0,0 +1,91 @@
+#ifndef TASK_GRAPH_H_
+#define TASK_GRAPH_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#include "thread_pool.h"
+
+namespace game {
+
+    // Set of tasks with explicit dependencies, each started as soon as the
+    // tasks it depends on are done. Worker tasks run on a thread pool;
+    // main tasks run on the thread calling RunFor, which owns the OpenGL
+    // context, so the whole graph takes as long as its longest chain
+    class TaskGraph {
+
+        public:
+            TaskGraph(ThreadPool &pool);
+            // Waits for the worker tasks already running
+            ~TaskGraph();
+
+            // Add a task for the workers, or for the thread calling RunFor.
+            // Dependencies are indices returned by earlier calls, so the
+            // graph never has cycles. Returns the index of the task
+            int Add(const std::string name, std::function<void(void)> work, std::vector<int> depends = std::vector<int>());
+            int AddMain(const std::string name, std::function<void(void)> work, std::vector<int> depends = std::vector<int>());
+            // Main task called again, once per slice, until it returns
+            // true; for work finishing in the background, like uploads
+            int AddPoll(const std::string name, std::function<bool(void)> poll, std::vector<int> depends = std::vector<int>());
+
+            // Run main tasks for about the given number of seconds, and
+            // never wait for workers: a frame can draw between two slices.
+            // Ready main tasks run in the order they were added, at least
+            // one per slice, so a task longer than the slice makes it
+            // late. Returns true once every task is done. The first
+            // exception thrown by a task is thrown again here, once the
+            // tasks already running have finished; tasks depending on it
+            // never start. A graph runs once
+            bool RunFor(double seconds);
+
+            // Fraction of the tasks done, from 0 to 1
+            float GetProgress(void) const;
+            // Chain of tasks that ended last, with the time each took,
+            // e.g. "HeightMap 12 ms > TerrainMesh 40 ms"
+            std::string GetCriticalPath(void) const;
+
+        private:
+            struct Task {
+                std::string name;
+                std::function<bool(void)> work; // True when done
+                bool main; // Runs on the thread calling RunFor
+                int waiting; // Dependencies not done yet
+                std::vector<int> depends;
+                std::vector<int> dependent;
+                double start; // Seconds since the first slice, -1 before
+                double end;
+            };
+
+            ThreadPool &pool_;
+            std::vector<Task> task_;
+            std::deque<int> ready_main_; // Main tasks able to start
+            int done_;
+            int running_; // Worker tasks submitted and not finished
+            std::exception_ptr error_;
+            bool started_;
+            double run_start_;
+            mutable std::mutex mutex_; // Guards everything above once started
+            std::condition_variable wake_; // Signalled as tasks end, for the destructor
+
+            int AddTask(const std::string name, std::function<bool(void)> work, std::vector<int> depends, bool main);
+            // Queue a main task or submit a worker task; needs the lock
+            void Start(int index);
+            // Run a task and release its dependents once it is done;
+            // returns false for a poll to call again
+            bool Execute(int index);
+            static double Now(void);
+
+            // Not copyable: submitted tasks refer to the graph
+            TaskGraph(const TaskGraph &);
+            TaskGraph &operator=(const TaskGraph &);
+
+    }; // class TaskGraph
+
+} // namespace game
+
+#endif // TASK_GRAPH_H_
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "texture_cache.h"
+
+namespace game {
+
+// Bump when the format or the mip filter changes
+static const GLuint texture_cache_version = 1;
+
+// Levels start on multiples of this many bytes
+static const GLuint level_alignment = 16;
+
+
+static GLuint Align(GLuint offset){
+
+    return (offset + level_alignment - 1) / level_alignment * level_alignment;
+}
+
+
+TextureCache::TextureCache(void){
+
+    header_ = NULL;
+    level_ = NULL;
+}
+
+
+TextureCache::~TextureCache(){
+}
+
+
+unsigned long long TextureCache::Hash(const char *data, size_t size){
+
+    unsigned long long hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++){
+        hash = (hash ^ (unsigned char) data[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+void TextureCache::Downsample(GLsizei width, GLsizei height, const unsigned char *pixels, std::vector<unsigned char> &half){
+
+    GLsizei half_width = (width > 1) ? width / 2 : 1;
+    GLsizei half_height = (height > 1) ? height / 2 : 1;
+    half.resize(half_width * half_height * 4);
+    for (GLsizei y = 0; y < half_height; y++){
+        GLsizei y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+        for (GLsizei x = 0; x < half_width; x++){
+            GLsizei x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            for (int c = 0; c < 4; c++){
+                int sum = pixels[(y0 * width + x0) * 4 + c] + pixels[(y0 * width + x1) * 4 + c]
+                        + pixels[(y1 * width + x0) * 4 + c] + pixels[(y1 * width + x1) * 4 + c];
+                half[(y * half_width + x) * 4 + c] = (unsigned char) ((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+
+bool TextureCache::Write(const std::string &path, unsigned long long source_hash, unsigned long long source_size, const std::vector<TextureLevel> &level){
+
+    if (level.size() == 0){
+        return false;
+    }
+
+    TextureCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "TEXC", 4);
+    header.version = texture_cache_version;
+    header.source_hash = source_hash;
+    header.source_size = source_size;
+    header.level_count = level.size();
+
+    std::vector<TextureCacheLevel> info(level.size());
+    GLuint offset = sizeof(header) + level.size() * sizeof(TextureCacheLevel);
+    for (int l = 0; l < level.size(); l++){
+        offset = Align(offset);
+        info[l].offset = offset;
+        info[l].width = level[l].width;
+        info[l].height = level[l].height;
+        info[l].reserved = 0;
+        offset += level[l].width * level[l].height * 4;
+    }
+
+    // Written under a name of its own, then renamed over the cache file
+    std::stringstream temporary;
+    temporary << path << "." << std::this_thread::get_id() << ".tmp";
+    {
+        std::ofstream file(temporary.str().c_str(), std::ios::binary);
+        if (!file){
+            return false;
+        }
+        file.write((const char *) &header, sizeof(header));
+        file.write((const char *) &info[0], info.size() * sizeof(TextureCacheLevel));
+        static const char padding[level_alignment] = { 0 };
+        GLuint position = sizeof(header) + info.size() * sizeof(TextureCacheLevel);
+        for (int l = 0; l < level.size(); l++){
+            GLuint bytes = level[l].width * level[l].height * 4;
+            file.write(padding, info[l].offset - position);
+            file.write((const char *) level[l].pixels, bytes);
+            position = info[l].offset + bytes;
+        }
+        if (!file.good()){
+            file.close();
+            remove(temporary.str().c_str());
+            return false;
+        }
+    }
+    if (rename(temporary.str().c_str(), path.c_str()) != 0){
+        // Another loader of the same image got there first
+        remove(temporary.str().c_str());
+    }
+    return true;
+}
+
+
+bool TextureCache::Open(const std::string &path, unsigned long long source_hash, unsigned long long source_size){
+
+    header_ = NULL;
+    level_ = NULL;
+    if (!file_.Open(path.c_str())){
+        return false;
+    }
+    const char *data = file_.GetData();
+    size_t size = file_.GetSize();
+
+    // Header and source contents
+    if (size < sizeof(TextureCacheHeader)){
+        return false;
+    }
+    const TextureCacheHeader *header = (const TextureCacheHeader *) data;
+    if (memcmp(header->magic, "TEXC", 4) != 0 || header->version != texture_cache_version || header->level_count == 0){
+        return false;
+    }
+    if (header->source_hash != source_hash || header->source_size != source_size){
+        return false;
+    }
+
+    // Levels inside the file
+    if (sizeof(TextureCacheHeader) + (size_t) header->level_count * sizeof(TextureCacheLevel) > size){
+        return false;
+    }
+    const TextureCacheLevel *level = (const TextureCacheLevel *) (data + sizeof(TextureCacheHeader));
+    for (GLuint l = 0; l < header->level_count; l++){
+        if (level[l].width == 0 || level[l].height == 0 || (size_t) level[l].offset + (size_t) level[l].width * level[l].height * 4 > size){
+            return false;
+        }
+    }
+
+    header_ = header;
+    level_ = level;
+    return true;
+}
+
+
+std::vector<TextureLevel> TextureCache::GetLevels(void) const {
+
+    std::vector<TextureLevel> level;
+    for (GLuint l = 0; header_ && l < header_->level_count; l++){
+        TextureLevel info = { (GLsizei) level_[l].width, (GLsizei) level_[l].height, (const unsigned char *) file_.GetData() + level_[l].offset };
+        level.push_back(info);
+    }
+    return level;
+}
+
+} // namespace game
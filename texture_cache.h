@@ -0,0 +1,77 @@
+#ifndef TEXTURE_CACHE_H_
+#define TEXTURE_CACHE_H_
+
+#include <string>
+#include <vector>
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "mapped_file.h"
+
+namespace game {
+
+    // Start of a texture cache file. It is followed by one
+    // TextureCacheLevel per mip level, then the RGBA8 pixels of every
+    // level, each starting on a 16-byte boundary
+    struct TextureCacheHeader {
+        char magic[4]; // "TEXC"
+        GLuint version;
+        unsigned long long source_hash; // Hash and size of the contents
+        unsigned long long source_size; // of the image file
+        GLuint level_count;
+        GLuint reserved;
+    };
+
+    // One mip level; the offset is in bytes from the start of the file
+    struct TextureCacheLevel {
+        GLuint offset;
+        GLuint width;
+        GLuint height;
+        GLuint reserved;
+    };
+
+    // Mip level of an RGBA8 image, rows from the top like SOIL decodes
+    // them
+    struct TextureLevel {
+        GLsizei width;
+        GLsizei height;
+        const unsigned char *pixels;
+    };
+
+    // Binary file holding a decoded image with its mip levels, so loading
+    // it is a memory mapping and one upload per level, with no decoding
+    class TextureCache {
+
+        public:
+            TextureCache(void);
+            ~TextureCache();
+
+            // 64-bit FNV-1a hash of the contents of an image file
+            static unsigned long long Hash(const char *data, size_t size);
+            // Half an RGBA8 image, averaging each 2x2 square; odd sizes
+            // repeat the last row and column
+            static void Downsample(GLsizei width, GLsizei height, const unsigned char *pixels, std::vector<unsigned char> &half);
+
+            // Write the levels of an image decoded from a file with the
+            // given hash and size. The file appears whole or not at all,
+            // so a launch running at the same time never maps half of it.
+            // Returns false if it cannot be written
+            static bool Write(const std::string &path, unsigned long long source_hash, unsigned long long source_size, const std::vector<TextureLevel> &level);
+
+            // Map a cache file; false if it is missing, damaged or made
+            // from other contents
+            bool Open(const std::string &path, unsigned long long source_hash, unsigned long long source_size);
+
+            // Levels of the open file, pointing into the mapping
+            std::vector<TextureLevel> GetLevels(void) const;
+
+        private:
+            MappedFile file_;
+            const TextureCacheHeader *header_;
+            const TextureCacheLevel *level_;
+
+    }; // class TextureCache
+
+} // namespace game
+
+#endif // TEXTURE_CACHE_H_
@@ -0,0 +1,268 @@
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <SOIL/SOIL.h>
+
+#include "ktx_texture.h"
+#include "texture_cache.h"
+
+// Compress images into block-compressed KTX textures with every mip level
+//
+// Usage: texture_compressor <image>...
+// Each image is written next to itself with the extension .ktx, which
+// the game loads instead of the image. Opaque images become BC1, 4 bits
+// per pixel; images with transparency become BC3, 8 bits per pixel
+
+// RGBA image, rows from the top like SOIL decodes them
+struct Image {
+    int width;
+    int height;
+    std::vector<unsigned char> pixel;
+};
+
+
+// Half the size of an image, averaging each 2x2 square
+static Image Downsample(const Image &image){
+
+    Image half;
+    half.width = (image.width > 1) ? image.width / 2 : 1;
+    half.height = (image.height > 1) ? image.height / 2 : 1;
+    game::TextureCache::Downsample(image.width, image.height, &image.pixel[0], half.pixel);
+    return half;
+}
+
+
+// Color in 5:6:5 bits, and back to 8 bits per channel
+static unsigned short PackColor(const float *color){
+
+    int r = (int) (color[0] * 31.0f / 255.0f + 0.5f);
+    int g = (int) (color[1] * 63.0f / 255.0f + 0.5f);
+    int b = (int) (color[2] * 31.0f / 255.0f + 0.5f);
+    r = std::max(0, std::min(31, r));
+    g = std::max(0, std::min(63, g));
+    b = std::max(0, std::min(31, b));
+    return (unsigned short) ((r << 11) | (g << 5) | b);
+}
+
+
+static void UnpackColor(unsigned short color, int *rgb){
+
+    rgb[0] = ((color >> 11) & 31) * 255 / 31;
+    rgb[1] = ((color >> 5) & 63) * 255 / 63;
+    rgb[2] = (color & 31) * 255 / 31;
+}
+
+
+// Color part of a BC1 or BC3 block: two end points on the principal axis
+// of the colors and a 2-bit index per pixel, always in four-color mode
+static void CompressColorBlock(const unsigned char block[16][4], unsigned char *dst){
+
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++){
+        for (int c = 0; c < 3; c++){
+            mean[c] += block[i][c] / 16.0f;
+        }
+    }
+    float covariance[6] = { 0.0f };
+    for (int i = 0; i < 16; i++){
+        float d[3] = { block[i][0] - mean[0], block[i][1] - mean[1], block[i][2] - mean[2] };
+        covariance[0] += d[0] * d[0]; covariance[1] += d[0] * d[1]; covariance[2] += d[0] * d[2];
+        covariance[3] += d[1] * d[1]; covariance[4] += d[1] * d[2]; covariance[5] += d[2] * d[2];
+    }
+    // Principal axis by a few power iterations
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int k = 0; k < 8; k++){
+        float next[3] = {
+            covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+            covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+            covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]
+        };
+        float length = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (length < 1e-6f){
+            break;
+        }
+        for (int c = 0; c < 3; c++){
+            axis[c] = next[c] / length;
+        }
+    }
+
+    // End points at the extremes of the projections
+    float low = 1e9f, high = -1e9f;
+    for (int i = 0; i < 16; i++){
+        float t = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+        low = std::min(low, t);
+        high = std::max(high, t);
+    }
+    float end0[3], end1[3];
+    for (int c = 0; c < 3; c++){
+        end0[c] = mean[c] + axis[c] * high;
+        end1[c] = mean[c] + axis[c] * low;
+    }
+    unsigned short color0 = PackColor(end0);
+    unsigned short color1 = PackColor(end1);
+    if (color0 < color1){
+        std::swap(color0, color1);
+    }
+
+    unsigned int index = 0;
+    if (color0 != color1){
+        int palette[4][3];
+        UnpackColor(color0, palette[0]);
+        UnpackColor(color1, palette[1]);
+        for (int c = 0; c < 3; c++){
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++){
+            int best = 0, best_error = 1 << 30;
+            for (int p = 0; p < 4; p++){
+                int error = 0;
+                for (int c = 0; c < 3; c++){
+                    int d = block[i][c] - palette[p][c];
+                    error += d * d;
+                }
+                if (error < best_error){
+                    best = p;
+                    best_error = error;
+                }
+            }
+            index |= best << (2 * i);
+        }
+    }
+
+    dst[0] = color0 & 0xFF; dst[1] = color0 >> 8;
+    dst[2] = color1 & 0xFF; dst[3] = color1 >> 8;
+    for (int i = 0; i < 4; i++){
+        dst[4 + i] = (index >> (8 * i)) & 0xFF;
+    }
+}
+
+
+// Alpha part of a BC3 block: the extreme alphas and six steps between
+// them, with a 3-bit index per pixel
+static void CompressAlphaBlock(const unsigned char block[16][4], unsigned char *dst){
+
+    int alpha0 = 0, alpha1 = 255;
+    for (int i = 0; i < 16; i++){
+        alpha0 = std::max(alpha0, (int) block[i][3]);
+        alpha1 = std::min(alpha1, (int) block[i][3]);
+    }
+
+    unsigned long long index = 0;
+    if (alpha0 != alpha1){
+        int palette[8] = { alpha0, alpha1 };
+        for (int p = 1; p < 7; p++){
+            palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+        }
+        for (int i = 0; i < 16; i++){
+            int best = 0, best_error = 1 << 30;
+            for (int p = 0; p < 8; p++){
+                int error = abs(block[i][3] - palette[p]);
+                if (error < best_error){
+                    best = p;
+                    best_error = error;
+                }
+            }
+            index |= (unsigned long long) best << (3 * i);
+        }
+    }
+
+    dst[0] = alpha0;
+    dst[1] = alpha1;
+    for (int i = 0; i < 6; i++){
+        dst[2 + i] = (index >> (8 * i)) & 0xFF;
+    }
+}
+
+
+// One mip level in BC1 or BC3; blocks past the edges repeat the last
+// row and column
+static std::vector<unsigned char> CompressImage(const Image &image, bool alpha){
+
+    int blocks_x = (image.width + 3) / 4;
+    int blocks_y = (image.height + 3) / 4;
+    int block_size = alpha ? 16 : 8;
+    std::vector<unsigned char> data(blocks_x * blocks_y * block_size);
+    unsigned char block[16][4];
+    for (int by = 0; by < blocks_y; by++){
+        for (int bx = 0; bx < blocks_x; bx++){
+            for (int i = 0; i < 16; i++){
+                int x = std::min(bx * 4 + i % 4, image.width - 1);
+                int y = std::min(by * 4 + i / 4, image.height - 1);
+                memcpy(block[i], &image.pixel[(y * image.width + x) * 4], 4);
+            }
+            unsigned char *dst = &data[(by * blocks_x + bx) * block_size];
+            if (alpha){
+                CompressAlphaBlock(block, dst);
+                dst += 8;
+            }
+            CompressColorBlock(block, dst);
+        }
+    }
+    return data;
+}
+
+
+static void CompressFile(const std::string filename){
+
+    Image image;
+    unsigned char *pixel = SOIL_load_image(filename.c_str(), &image.width, &image.height, 0, SOIL_LOAD_RGBA);
+    if (!pixel){
+        throw(std::ios_base::failure(std::string("Error loading texture ")+filename+std::string(": ")+std::string(SOIL_last_result())));
+    }
+    image.pixel.assign(pixel, pixel + image.width * image.height * 4);
+    SOIL_free_image_data(pixel);
+
+    bool alpha = false;
+    for (int i = 3; i < image.pixel.size(); i += 4){
+        if (image.pixel[i] != 255){
+            alpha = true;
+            break;
+        }
+    }
+
+    // Every level down to 1x1
+    std::vector<std::vector<unsigned char> > level;
+    int width = image.width, height = image.height;
+    while (true){
+        level.push_back(CompressImage(image, alpha));
+        if (image.width == 1 && image.height == 1){
+            break;
+        }
+        image = Downsample(image);
+    }
+
+    std::string output = filename.substr(0, filename.find_last_of('.')) + ".ktx";
+    if (alpha){
+        game::WriteKtx(output, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_RGBA, width, height, level);
+    } else {
+        game::WriteKtx(output, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_RGB, width, height, level);
+    }
+    std::cout << output << ": " << width << "x" << height << ", " << level.size() << " levels, " << (alpha ? "BC3" : "BC1") << std::endl;
+}
+
+
+int main(int argc, char *argv[]){
+
+    if (argc < 2){
+        std::cerr << "Usage: " << argv[0] << " <image>..." << std::endl;
+        return 1;
+    }
+
+    try {
+        for (int i = 1; i < argc; i++){
+            CompressFile(argv[i]);
+        }
+    }
+    catch (std::exception &e){
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include "thread_pool.h"
+
+namespace game {
+
+ThreadPool::ThreadPool(int threads){
+
+    stop_ = false;
+    if (threads <= 0){
+        // hardware_concurrency may not know, and returns 0
+        int cores = (int) std::thread::hardware_concurrency();
+        threads = (cores > 1) ? cores - 1 : 1;
+    }
+    for (int i = 0; i < threads; i++){
+        thread_.push_back(std::thread(&ThreadPool::Run, this));
+    }
+}
+
+
+ThreadPool::~ThreadPool(){
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (int i = 0; i < thread_.size(); i++){
+        thread_[i].join();
+    }
+}
+
+
+void ThreadPool::Submit(std::function<void(void)> task){
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_.push_back(task);
+    }
+    wake_.notify_one();
+}
+
+
+int ThreadPool::GetThreadCount(void) const {
+
+    return (int) thread_.size();
+}
+
+
+void ThreadPool::Run(void){
+
+    while (true){
+        std::function<void(void)> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (task_.empty() && !stop_){
+                wake_.wait(lock);
+            }
+            // Queued tasks still run when stopping
+            if (task_.empty()){
+                return;
+            }
+            task = task_.front();
+            task_.pop_front();
+        }
+        task();
+    }
+}
+
+} // namespace game
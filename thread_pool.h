@@ -0,0 +1,46 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace game {
+
+    // Fixed set of worker threads running queued tasks in order of
+    // submission. Tasks must not touch OpenGL: the context belongs to the
+    // main thread
+    class ThreadPool {
+
+        public:
+            // Start the workers; 0 for one per core besides the main thread
+            ThreadPool(int threads = 0);
+            // Finish the queued tasks and stop the workers
+            ~ThreadPool();
+
+            // Queue a task for the next free worker
+            void Submit(std::function<void(void)> task);
+            int GetThreadCount(void) const;
+
+        private:
+            std::vector<std::thread> thread_;
+            std::deque<std::function<void(void)> > task_;
+            std::mutex mutex_; // Guards task_ and stop_
+            std::condition_variable wake_;
+            bool stop_;
+
+            // Loop of each worker
+            void Run(void);
+
+            // Not copyable: the workers refer to the pool
+            ThreadPool(const ThreadPool &);
+            ThreadPool &operator=(const ThreadPool &);
+
+    }; // class ThreadPool
+
+} // namespace game
+
+#endif // THREAD_POOL_H_
@@ -0,0 +1,406 @@
+#include <string.h>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "transform_store.h"
+
+// Use SSE for the batch matrix kernel where the target guarantees it
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_STORE_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace game {
+
+// Build the world and normal matrices of a translate * rotate * scale
+// transform. The normal matrix is the inverse transpose of the upper 3x3,
+// which for R * S is simply R * S^-1, so no general inverse is needed
+static void ComposeTRS(const glm::vec3 &position, const glm::quat &orientation, const glm::vec3 &scale, glm::mat4 &world, glm::mat4 &normal){
+
+    glm::mat3 rotation = glm::mat3_cast(orientation);
+
+    world[0] = glm::vec4(rotation[0] * scale.x, 0.0);
+    world[1] = glm::vec4(rotation[1] * scale.y, 0.0);
+    world[2] = glm::vec4(rotation[2] * scale.z, 0.0);
+    world[3] = glm::vec4(position, 1.0);
+
+    normal[0] = glm::vec4(rotation[0] / scale.x, 0.0);
+    normal[1] = glm::vec4(rotation[1] / scale.y, 0.0);
+    normal[2] = glm::vec4(rotation[2] / scale.z, 0.0);
+    normal[3] = glm::vec4(0.0, 0.0, 0.0, 1.0);
+}
+
+TransformStore::TransformStore(void){
+}
+
+
+TransformStore::~TransformStore(){
+}
+
+
+TransformHandle TransformStore::Create(void){
+
+    TransformHandle handle;
+
+    // Reuse a released slot if there is one
+    if (free_.size() > 0){
+        handle = free_.back();
+        free_.pop_back();
+    } else {
+        handle = (TransformHandle) position_.size();
+        position_.push_back(glm::vec3(0.0, 0.0, 0.0));
+        orientation_.push_back(glm::quat());
+        scale_.push_back(glm::vec3(1.0, 1.0, 1.0));
+        world_.push_back(glm::mat4(1.0));
+        normal_.push_back(glm::mat4(1.0));
+        parent_.push_back(NO_TRANSFORM);
+        first_child_.push_back(NO_TRANSFORM);
+        next_sibling_.push_back(NO_TRANSFORM);
+        owner_.push_back(NULL);
+        flags_.push_back(0);
+        version_.push_back(0);
+    }
+
+    position_[handle] = glm::vec3(0.0, 0.0, 0.0);
+    orientation_[handle] = glm::quat();
+    scale_[handle] = glm::vec3(1.0, 1.0, 1.0);
+    parent_[handle] = NO_TRANSFORM;
+    first_child_[handle] = NO_TRANSFORM;
+    next_sibling_[handle] = NO_TRANSFORM;
+    owner_[handle] = NULL;
+    flags_[handle] = ALIVE | DIRTY;
+    version_[handle]++;
+
+    return handle;
+}
+
+
+void TransformStore::Release(TransformHandle handle){
+
+    Detach(handle);
+
+    // Children become roots
+    TransformHandle child = first_child_[handle];
+    while (child != NO_TRANSFORM){
+        TransformHandle next = next_sibling_[child];
+        parent_[child] = NO_TRANSFORM;
+        next_sibling_[child] = NO_TRANSFORM;
+        SetDirty(child);
+        child = next;
+    }
+    first_child_[handle] = NO_TRANSFORM;
+
+    owner_[handle] = NULL;
+    flags_[handle] = 0;
+    free_.push_back(handle);
+}
+
+
+const glm::vec3 &TransformStore::GetPosition(TransformHandle handle) const {
+
+    return position_[handle];
+}
+
+
+const glm::quat &TransformStore::GetOrientation(TransformHandle handle) const {
+
+    return orientation_[handle];
+}
+
+
+const glm::vec3 &TransformStore::GetScale(TransformHandle handle) const {
+
+    return scale_[handle];
+}
+
+
+void TransformStore::SetPosition(TransformHandle handle, const glm::vec3 &position){
+
+    position_[handle] = position;
+    SetDirty(handle);
+}
+
+
+void TransformStore::SetOrientation(TransformHandle handle, const glm::quat &orientation){
+
+    orientation_[handle] = orientation;
+    SetDirty(handle);
+}
+
+
+void TransformStore::SetScale(TransformHandle handle, const glm::vec3 &scale){
+
+    scale_[handle] = scale;
+    SetDirty(handle);
+}
+
+
+void TransformStore::SetParent(TransformHandle handle, TransformHandle parent){
+
+    Detach(handle);
+
+    if (parent != NO_TRANSFORM){
+        parent_[handle] = parent;
+        next_sibling_[handle] = first_child_[parent];
+        first_child_[parent] = handle;
+    }
+    SetDirty(handle);
+}
+
+
+TransformHandle TransformStore::GetParent(TransformHandle handle) const {
+
+    return parent_[handle];
+}
+
+
+TransformHandle TransformStore::GetFirstChild(TransformHandle handle) const {
+
+    return first_child_[handle];
+}
+
+
+TransformHandle TransformStore::GetNextSibling(TransformHandle handle) const {
+
+    return next_sibling_[handle];
+}
+
+
+void TransformStore::SetOwner(TransformHandle handle, void *owner){
+
+    owner_[handle] = owner;
+}
+
+
+void *TransformStore::GetOwner(TransformHandle handle) const {
+
+    return owner_[handle];
+}
+
+
+const glm::mat4 &TransformStore::GetWorldMatrix(TransformHandle handle){
+
+    if (flags_[handle] & DIRTY){
+        Resolve(handle);
+    }
+    return world_[handle];
+}
+
+
+const glm::mat4 &TransformStore::GetNormalMatrix(TransformHandle handle){
+
+    if (flags_[handle] & DIRTY){
+        Resolve(handle);
+    }
+    return normal_[handle];
+}
+
+
+void TransformStore::UpdateWorldMatrices(void){
+
+    // Collect dirty transforms; clean ones cost a single flag test, so
+    // static nodes are free
+    dirty_list_.clear();
+    int size = (int) flags_.size();
+    for (int i = 0; i < size; i++){
+        if (flags_[i] & DIRTY){
+            dirty_list_.push_back(i);
+        }
+    }
+    if (dirty_list_.size() == 0){
+        return;
+    }
+
+    // Local matrices for all of them in one vectorized pass
+    ComputeLocalMatrices(&dirty_list_[0], (int) dirty_list_.size());
+
+    // Then compose with parents; roots are already final
+    for (int i = 0; i < dirty_list_.size(); i++){
+        ApplyParent(dirty_list_[i]);
+    }
+}
+
+
+void TransformStore::GatherMatrices(const TransformHandle *handles, int count, NodeMatrices *out){
+
+    for (int i = 0; i < count; i++){
+        TransformHandle handle = handles[i];
+        if (flags_[handle] & DIRTY){
+            Resolve(handle);
+        }
+        memcpy(glm::value_ptr(out[i].world), glm::value_ptr(world_[handle]), sizeof(glm::mat4));
+        memcpy(glm::value_ptr(out[i].normal), glm::value_ptr(normal_[handle]), sizeof(glm::mat4));
+    }
+}
+
+
+unsigned int TransformStore::GetVersion(TransformHandle handle) const {
+
+    return version_[handle];
+}
+
+
+int TransformStore::GetSize(void) const {
+
+    return (int) flags_.size();
+}
+
+
+void TransformStore::SetDirty(TransformHandle handle){
+
+    // A dirty transform already has all of its descendants flagged
+    if (flags_[handle] & DIRTY){
+        return;
+    }
+    flags_[handle] |= DIRTY;
+    version_[handle]++;
+
+    TransformHandle child = first_child_[handle];
+    while (child != NO_TRANSFORM){
+        SetDirty(child);
+        child = next_sibling_[child];
+    }
+}
+
+
+void TransformStore::Detach(TransformHandle handle){
+
+    TransformHandle parent = parent_[handle];
+    if (parent == NO_TRANSFORM){
+        return;
+    }
+
+    // Remove handle from the singly-linked list of children
+    if (first_child_[parent] == handle){
+        first_child_[parent] = next_sibling_[handle];
+    } else {
+        TransformHandle prev = first_child_[parent];
+        while (next_sibling_[prev] != handle){
+            prev = next_sibling_[prev];
+        }
+        next_sibling_[prev] = next_sibling_[handle];
+    }
+    parent_[handle] = NO_TRANSFORM;
+    next_sibling_[handle] = NO_TRANSFORM;
+}
+
+
+void TransformStore::Resolve(TransformHandle handle){
+
+    ComposeTRS(position_[handle], orientation_[handle], scale_[handle], world_[handle], normal_[handle]);
+
+    TransformHandle parent = parent_[handle];
+    if (parent != NO_TRANSFORM){
+        // The inverse transpose of a product is the product of the
+        // inverse transposes, so normals compose like positions
+        world_[handle] = GetWorldMatrix(parent) * world_[handle];
+        normal_[handle] = normal_[parent] * normal_[handle];
+    }
+
+    flags_[handle] &= ~DIRTY;
+}
+
+
+void TransformStore::ApplyParent(TransformHandle handle){
+
+    if (!(flags_[handle] & PENDING)){
+        return;
+    }
+
+    // A dirty parent is in the same batch; finish it first
+    TransformHandle parent = parent_[handle];
+    if (parent != NO_TRANSFORM){
+        ApplyParent(parent);
+        world_[handle] = world_[parent] * world_[handle];
+        normal_[handle] = normal_[parent] * normal_[handle];
+    }
+
+    flags_[handle] &= ~(PENDING | DIRTY);
+}
+
+
+void TransformStore::ComputeLocalMatrices(const TransformHandle *handles, int count){
+
+    int i = 0;
+
+#ifdef TRANSFORM_STORE_SSE
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (; i + 4 <= count; i += 4){
+        const TransformHandle *h = handles + i;
+
+        // Gather four transforms and transpose them so that each register
+        // holds one component of all four
+        __m128 qx = _mm_setr_ps(orientation_[h[0]].x, orientation_[h[1]].x, orientation_[h[2]].x, orientation_[h[3]].x);
+        __m128 qy = _mm_setr_ps(orientation_[h[0]].y, orientation_[h[1]].y, orientation_[h[2]].y, orientation_[h[3]].y);
+        __m128 qz = _mm_setr_ps(orientation_[h[0]].z, orientation_[h[1]].z, orientation_[h[2]].z, orientation_[h[3]].z);
+        __m128 qw = _mm_setr_ps(orientation_[h[0]].w, orientation_[h[1]].w, orientation_[h[2]].w, orientation_[h[3]].w);
+        __m128 sx = _mm_setr_ps(scale_[h[0]].x, scale_[h[1]].x, scale_[h[2]].x, scale_[h[3]].x);
+        __m128 sy = _mm_setr_ps(scale_[h[0]].y, scale_[h[1]].y, scale_[h[2]].y, scale_[h[3]].y);
+        __m128 sz = _mm_setr_ps(scale_[h[0]].z, scale_[h[1]].z, scale_[h[2]].z, scale_[h[3]].z);
+        __m128 px = _mm_setr_ps(position_[h[0]].x, position_[h[1]].x, position_[h[2]].x, position_[h[3]].x);
+        __m128 py = _mm_setr_ps(position_[h[0]].y, position_[h[1]].y, position_[h[2]].y, position_[h[3]].y);
+        __m128 pz = _mm_setr_ps(position_[h[0]].z, position_[h[1]].z, position_[h[2]].z, position_[h[3]].z);
+
+        // Rotation matrix from the quaternions (same terms as mat3_cast)
+        __m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+        __m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+        __m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+
+        __m128 r[3][3];
+        r[0][0] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)));
+        r[0][1] = _mm_mul_ps(two, _mm_add_ps(xy, wz));
+        r[0][2] = _mm_mul_ps(two, _mm_sub_ps(xz, wy));
+        r[1][0] = _mm_mul_ps(two, _mm_sub_ps(xy, wz));
+        r[1][1] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)));
+        r[1][2] = _mm_mul_ps(two, _mm_add_ps(yz, wx));
+        r[2][0] = _mm_mul_ps(two, _mm_add_ps(xz, wy));
+        r[2][1] = _mm_mul_ps(two, _mm_sub_ps(yz, wx));
+        r[2][2] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)));
+
+        // World columns are scaled by s, normal columns by 1/s
+        __m128 s[3] = { sx, sy, sz };
+        for (int c = 0; c < 3; c++){
+            __m128 inv = _mm_div_ps(one, s[c]);
+            __m128 wc0 = _mm_mul_ps(r[c][0], s[c]), wc1 = _mm_mul_ps(r[c][1], s[c]), wc2 = _mm_mul_ps(r[c][2], s[c]), wc3 = zero;
+            __m128 nc0 = _mm_mul_ps(r[c][0], inv), nc1 = _mm_mul_ps(r[c][1], inv), nc2 = _mm_mul_ps(r[c][2], inv), nc3 = zero;
+            // Transpose back to one column per transform
+            _MM_TRANSPOSE4_PS(wc0, wc1, wc2, wc3);
+            _MM_TRANSPOSE4_PS(nc0, nc1, nc2, nc3);
+            _mm_storeu_ps(glm::value_ptr(world_[h[0]]) + 4*c, wc0);
+            _mm_storeu_ps(glm::value_ptr(world_[h[1]]) + 4*c, wc1);
+            _mm_storeu_ps(glm::value_ptr(world_[h[2]]) + 4*c, wc2);
+            _mm_storeu_ps(glm::value_ptr(world_[h[3]]) + 4*c, wc3);
+            _mm_storeu_ps(glm::value_ptr(normal_[h[0]]) + 4*c, nc0);
+            _mm_storeu_ps(glm::value_ptr(normal_[h[1]]) + 4*c, nc1);
+            _mm_storeu_ps(glm::value_ptr(normal_[h[2]]) + 4*c, nc2);
+            _mm_storeu_ps(glm::value_ptr(normal_[h[3]]) + 4*c, nc3);
+        }
+
+        // Translation column
+        __m128 pw = one;
+        _MM_TRANSPOSE4_PS(px, py, pz, pw);
+        _mm_storeu_ps(glm::value_ptr(world_[h[0]]) + 12, px);
+        _mm_storeu_ps(glm::value_ptr(world_[h[1]]) + 12, py);
+        _mm_storeu_ps(glm::value_ptr(world_[h[2]]) + 12, pz);
+        _mm_storeu_ps(glm::value_ptr(world_[h[3]]) + 12, pw);
+        for (int k = 0; k < 4; k++){
+            normal_[h[k]][3] = glm::vec4(0.0, 0.0, 0.0, 1.0);
+            flags_[h[k]] |= PENDING;
+        }
+    }
+#endif
+
+    // Remainder, or everything without SIMD
+    for (; i < count; i++){
+        TransformHandle handle = handles[i];
+        ComposeTRS(position_[handle], orientation_[handle], scale_[handle], world_[handle], normal_[handle]);
+        flags_[handle] |= PENDING;
+    }
+}
+
+} // namespace game
@@ -0,0 +1,112 @@
+#ifndef TRANSFORM_STORE_H_
+#define TRANSFORM_STORE_H_
+
+#include <vector>
+#include <glm/glm.hpp>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/quaternion.hpp>
+
+namespace game {
+
+    // Index of a transform inside a TransformStore
+    typedef int TransformHandle;
+
+    // Handle value that refers to no transform
+    const TransformHandle NO_TRANSFORM = -1;
+
+    // Matrices of one node laid out for upload to a uniform or storage
+    // buffer (std140/std430 compatible)
+    struct NodeMatrices {
+        glm::mat4 world; // World transformation
+        glm::mat4 normal; // Transformation for normals
+    };
+
+    // Structure-of-arrays storage for node transforms
+    //
+    // Every attribute lives in its own contiguous array indexed by handle,
+    // so batch passes over all transforms walk memory linearly instead of
+    // chasing one heap allocation per scene node
+    class TransformStore {
+
+        public:
+            TransformStore(void);
+            ~TransformStore();
+
+            // Allocate a transform set to the identity, reusing released slots
+            TransformHandle Create(void);
+            // Return a transform to the store; its children become roots
+            void Release(TransformHandle handle);
+
+            // Local attributes, relative to the parent transform
+            const glm::vec3 &GetPosition(TransformHandle handle) const;
+            const glm::quat &GetOrientation(TransformHandle handle) const;
+            const glm::vec3 &GetScale(TransformHandle handle) const;
+            void SetPosition(TransformHandle handle, const glm::vec3 &position);
+            void SetOrientation(TransformHandle handle, const glm::quat &orientation);
+            void SetScale(TransformHandle handle, const glm::vec3 &scale);
+
+            // Hierarchy; pass NO_TRANSFORM as parent to make a root
+            void SetParent(TransformHandle handle, TransformHandle parent);
+            TransformHandle GetParent(TransformHandle handle) const;
+            // Children of a transform, walked as a linked list ending in
+            // NO_TRANSFORM
+            TransformHandle GetFirstChild(TransformHandle handle) const;
+            TransformHandle GetNextSibling(TransformHandle handle) const;
+
+            // Object a transform belongs to, so the hierarchy can be
+            // walked back to it; NULL until set
+            void SetOwner(TransformHandle handle, void *owner);
+            void *GetOwner(TransformHandle handle) const;
+
+            // Cached matrices, rebuilt on demand if the transform is dirty
+            const glm::mat4 &GetWorldMatrix(TransformHandle handle);
+            const glm::mat4 &GetNormalMatrix(TransformHandle handle);
+
+            // Rebuild the matrices of every dirty transform in one pass
+            void UpdateWorldMatrices(void);
+            // Copy the cached matrices of the given transforms into a
+            // contiguous buffer, in order, ready for upload
+            void GatherMatrices(const TransformHandle *handles, int count, NodeMatrices *out);
+
+            // Counter bumped whenever the world matrix of a transform is
+            // invalidated, so callers can cache data derived from it
+            unsigned int GetVersion(TransformHandle handle) const;
+
+            // Number of slots, including released ones
+            int GetSize(void) const;
+
+        private:
+            // Per-transform flags
+            enum { ALIVE = 1, DIRTY = 2, PENDING = 4 };
+
+            std::vector<glm::vec3> position_; // Local positions
+            std::vector<glm::quat> orientation_; // Local orientations
+            std::vector<glm::vec3> scale_; // Local scales
+            std::vector<glm::mat4> world_; // Cached world matrices
+            std::vector<glm::mat4> normal_; // Cached normal matrices
+            std::vector<TransformHandle> parent_; // Parent of each transform
+            std::vector<TransformHandle> first_child_; // Head of child list
+            std::vector<TransformHandle> next_sibling_; // Next child of parent
+            std::vector<void *> owner_; // Object each transform belongs to
+            std::vector<unsigned char> flags_; // ALIVE and DIRTY bits
+            std::vector<unsigned int> version_; // Invalidation counters
+            std::vector<TransformHandle> free_; // Released slots
+            std::vector<TransformHandle> dirty_list_; // Scratch list for UpdateWorldMatrices
+
+            // Flag a transform and all of its descendants as dirty
+            void SetDirty(TransformHandle handle);
+            // Unlink a transform from its parent's child list
+            void Detach(TransformHandle handle);
+            // Rebuild the matrices of a dirty transform after its ancestors
+            void Resolve(TransformHandle handle);
+            // Compute local world and normal matrices of count transforms
+            // into world_ and normal_, four at a time with SIMD
+            void ComputeLocalMatrices(const TransformHandle *handles, int count);
+            // Compose a transform holding local matrices with its parent
+            void ApplyParent(TransformHandle handle);
+
+    }; // class TransformStore
+
+} // namespace game
+
+#endif // TRANSFORM_STORE_H_
@@ -0,0 +1,314 @@
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+#include "upload_queue.h"
+
+namespace game {
+
+// Default bytes per frame
+static const size_t default_budget = 4 * 1024 * 1024;
+// Copies start at multiples of this in a segment
+static const size_t staging_alignment = 16;
+
+
+// Bytes per pixel of the formats textures are uploaded in
+static size_t PixelSize(GLenum format, GLenum type){
+
+    size_t components;
+    switch (format){
+        case GL_RED: components = 1; break;
+        case GL_RG: components = 2; break;
+        case GL_RGB: case GL_BGR: components = 3; break;
+        default: components = 4; break;
+    }
+    switch (type){
+        case GL_UNSIGNED_SHORT: case GL_HALF_FLOAT: return components * 2;
+        case GL_FLOAT: return components * 4;
+        default: return components;
+    }
+}
+
+
+UploadQueue::UploadQueue(void){
+
+    budget_ = default_budget;
+    pending_bytes_ = 0;
+    staging_ = 0;
+    mapped_ = NULL;
+    segment_size_ = 0;
+    segment_ = 0;
+    for (int i = 0; i < segment_count; i++){
+        fence_[i] = 0;
+    }
+}
+
+
+UploadQueue::~UploadQueue(){
+}
+
+
+void UploadQueue::SetBudget(size_t bytes){
+
+    budget_ = std::max(bytes, (size_t) 64 * 1024);
+}
+
+
+size_t UploadQueue::GetBudget(void) const {
+
+    return budget_;
+}
+
+
+void UploadQueue::UploadBuffer(GLuint buffer, GLintptr offset, GLsizeiptr size, const void *data, std::function<void(void)> done){
+
+    Upload upload;
+    upload.object = buffer;
+    upload.offset = offset;
+    upload.level = 0;
+    upload.width = 0;
+    upload.height = 0;
+    upload.format = 0;
+    upload.type = 0;
+    upload.row_bytes = 1;
+    upload.data = (const GLubyte *) data;
+    upload.size = size;
+    upload.copied = 0;
+    upload.done = done;
+    upload_.push_back(upload);
+    pending_bytes_ += size;
+}
+
+
+void UploadQueue::UploadBuffer(GLuint buffer, GLintptr offset, std::vector<GLubyte> &data, std::function<void(void)> done){
+
+    UploadBuffer(buffer, offset, data.size(), NULL, done);
+    upload_.back().owned.swap(data);
+}
+
+
+void UploadQueue::UploadTexture(GLuint texture, GLint level, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *data, std::function<void(void)> done){
+
+    Upload upload;
+    upload.object = texture;
+    upload.offset = 0;
+    upload.level = level;
+    upload.width = width;
+    upload.height = height;
+    upload.format = format;
+    upload.type = type;
+    upload.row_bytes = width * PixelSize(format, type);
+    if (upload.row_bytes > budget_){
+        throw(std::ios_base::failure(std::string("Texture rows larger than the upload budget")));
+    }
+    upload.data = (const GLubyte *) data;
+    upload.size = upload.row_bytes * height;
+    upload.copied = 0;
+    upload.done = done;
+    upload_.push_back(upload);
+    pending_bytes_ += upload.size;
+}
+
+
+size_t UploadQueue::Process(void){
+
+    return Transfer(budget_);
+}
+
+
+void UploadQueue::Flush(void){
+
+    while (!upload_.empty()){
+        Transfer(segment_size_ ? segment_size_ : budget_);
+    }
+}
+
+
+size_t UploadQueue::GetPendingBytes(void) const {
+
+    return pending_bytes_;
+}
+
+
+bool UploadQueue::IsEmpty(void) const {
+
+    return upload_.empty();
+}
+
+
+size_t UploadQueue::GetMemoryUsed(void) const {
+
+    return staging_ ? segment_size_ * segment_count : 0;
+}
+
+
+void UploadQueue::DeleteObjects(void){
+
+    // Frees the data held for them, and the callbacks
+    upload_.clear();
+    pending_bytes_ = 0;
+
+    for (int i = 0; i < segment_count; i++){
+        if (fence_[i]){
+            glDeleteSync(fence_[i]);
+            fence_[i] = 0;
+        }
+    }
+    if (staging_){
+        if (mapped_){
+            glBindBuffer(GL_COPY_READ_BUFFER, staging_);
+            glUnmapBuffer(GL_COPY_READ_BUFFER);
+            mapped_ = NULL;
+        }
+        glDeleteBuffers(1, &staging_);
+        staging_ = 0;
+    }
+    // Created again by the next transfer
+    segment_size_ = 0;
+    segment_ = 0;
+}
+
+
+void UploadQueue::InitStaging(void){
+
+    // Segments of another size: wait for the copies out of the old ones
+    if (staging_){
+        for (int i = 0; i < segment_count; i++){
+            if (fence_[i]){
+                glClientWaitSync(fence_[i], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+                glDeleteSync(fence_[i]);
+                fence_[i] = 0;
+            }
+        }
+        if (mapped_){
+            glBindBuffer(GL_COPY_READ_BUFFER, staging_);
+            glUnmapBuffer(GL_COPY_READ_BUFFER);
+            mapped_ = NULL;
+        }
+        glDeleteBuffers(1, &staging_);
+        staging_ = 0;
+    }
+
+    segment_size_ = budget_;
+    segment_ = 0;
+    GLsizeiptr size = segment_size_ * segment_count;
+    glGenBuffers(1, &staging_);
+    glBindBuffer(GL_COPY_READ_BUFFER, staging_);
+    if (GLEW_ARB_buffer_storage){
+        // Mapped once for good; coherent, so writes need no flush
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_READ_BUFFER, size, NULL, flags);
+        mapped_ = (GLubyte *) glMapBufferRange(GL_COPY_READ_BUFFER, 0, size, flags);
+    } else {
+        glBufferData(GL_COPY_READ_BUFFER, size, NULL, GL_STREAM_DRAW);
+    }
+}
+
+
+size_t UploadQueue::Transfer(size_t limit){
+
+    if (upload_.empty()){
+        return 0;
+    }
+    if (segment_size_ != budget_){
+        InitStaging();
+    }
+    limit = std::min(limit, segment_size_);
+
+    // Wait until the GPU is done with the previous copies out of the
+    // segment; with three in turn, that was two frames ago
+    if (fence_[segment_]){
+        glClientWaitSync(fence_[segment_], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(fence_[segment_]);
+        fence_[segment_] = 0;
+    }
+
+    size_t base = segment_ * segment_size_;
+    glBindBuffer(GL_COPY_READ_BUFFER, staging_);
+    GLubyte *segment;
+    if (mapped_){
+        segment = mapped_ + base;
+    } else {
+        // The fence already synchronizes, the driver need not
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        segment = (GLubyte *) glMapBufferRange(GL_COPY_READ_BUFFER, base, segment_size_, flags);
+    }
+
+    // Copy what fits into the segment, remembering where each part goes
+    struct Part {
+        size_t upload; // Index in upload_
+        size_t source; // Bytes into the segment
+        size_t copied; // Bytes of the upload sent before this part
+        size_t size;
+    };
+    std::vector<Part> part;
+    size_t used = 0;
+    size_t copied = 0;
+    for (size_t i = 0; i < upload_.size() && used < limit; i++){
+        Upload &upload = upload_[i];
+        if (upload.copied == upload.size){
+            continue;
+        }
+        size_t available = limit - used;
+        size_t size = std::min(upload.size - upload.copied, available);
+        // Textures go in whole rows
+        size -= size % upload.row_bytes;
+        if (size == 0){
+            break;
+        }
+        const GLubyte *data = upload.owned.empty() ? upload.data : &upload.owned[0];
+        memcpy(segment + used, data + upload.copied, size);
+        Part p = { i, base + used, upload.copied, size };
+        part.push_back(p);
+        upload.copied += size;
+        copied += size;
+        used += size;
+        used = (used + staging_alignment - 1) & ~(staging_alignment - 1);
+    }
+
+    if (!mapped_){
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+    }
+
+    // Copies out of the segment
+    bool texture = false;
+    for (int i = 0; i < part.size(); i++){
+        const Part &p = part[i];
+        const Upload &upload = upload_[p.upload];
+        if (upload.width){
+            if (!texture){
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging_);
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+                texture = true;
+            }
+            GLint first_row = (GLint) (p.copied / upload.row_bytes);
+            GLsizei rows = (GLsizei) (p.size / upload.row_bytes);
+            glBindTexture(GL_TEXTURE_2D, upload.object);
+            glTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, first_row, upload.width, rows, upload.format, upload.type, (const void *) p.source);
+        } else {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, upload.object);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, p.source, upload.offset + p.copied, p.size);
+        }
+        pending_bytes_ -= p.size;
+    }
+    if (texture){
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    fence_[segment_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    segment_ = (segment_ + 1) % segment_count;
+
+    // Commands using the destinations now come after the copies
+    while (!upload_.empty() && upload_.front().copied == upload_.front().size){
+        std::function<void(void)> done = upload_.front().done;
+        upload_.pop_front();
+        if (done){
+            done();
+        }
+    }
+
+    return copied;
+}
+
+} // namespace game
@@ -0,0 +1,108 @@
+#ifndef UPLOAD_QUEUE_H_
+#define UPLOAD_QUEUE_H_
+
+#include <vector>
+#include <deque>
+#include <functional>
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+namespace game {
+
+    // Transfers of buffer and texture data spread over frames
+    //
+    // Data is copied into a staging buffer that stays mapped, split in
+    // segments used in turn, and the GPU copies it from there into the
+    // destination: glCopyBufferSubData for buffers, glTexSubImage2D with
+    // the staging buffer as pixel unpack buffer for textures. A fence
+    // after the copies of a segment keeps it from being overwritten while
+    // the GPU still reads it. Each frame moves at most the budget, so an
+    // asset arriving mid-game never stalls the frame on one large upload
+    class UploadQueue {
+
+        public:
+            UploadQueue(void);
+            ~UploadQueue();
+
+            // Bytes copied per call to Process, and the size of each
+            // staging segment; at least 64 KB, and more than a row of
+            // any texture queued
+            void SetBudget(size_t bytes);
+            size_t GetBudget(void) const;
+
+            // Queue data for a range of a buffer, which must already have
+            // its storage. The data must stay valid until done is called
+            void UploadBuffer(GLuint buffer, GLintptr offset, GLsizeiptr size, const void *data, std::function<void(void)> done = nullptr);
+            // Same, taking over the contents of data
+            void UploadBuffer(GLuint buffer, GLintptr offset, std::vector<GLubyte> &data, std::function<void(void)> done = nullptr);
+            // Queue the pixels of a level of a 2D texture, which must
+            // already have its storage; sent in whole rows, so throws if
+            // a row exceeds the budget. The data must stay valid until
+            // done is called
+            void UploadTexture(GLuint texture, GLint level, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *data, std::function<void(void)> done = nullptr);
+
+            // Copy up to the budget of queued data, at least one row or
+            // range; call once per frame. Uploads are complete, and done
+            // called, once their last part is copied. Returns the bytes
+            // copied
+            size_t Process(void);
+            // Copy everything queued, ignoring the budget
+            void Flush(void);
+
+            // Queued bytes not copied yet
+            size_t GetPendingBytes(void) const;
+            bool IsEmpty(void) const;
+            // Bytes of the staging buffer, every segment included
+            size_t GetMemoryUsed(void) const;
+
+            // Drop the queued uploads without calling done, and delete the
+            // staging buffer and fences; call before the context goes. The
+            // queue can be used again afterwards
+            void DeleteObjects(void);
+
+        private:
+            // Staging segments in flight at once
+            enum { segment_count = 3 };
+
+            // Queued transfer, texture if width is not 0
+            struct Upload {
+                GLuint object;
+                GLintptr offset; // Bytes into the buffer
+                GLint level;
+                GLsizei width;
+                GLsizei height;
+                GLenum format;
+                GLenum type;
+                size_t row_bytes;
+                const GLubyte *data;
+                size_t size;
+                size_t copied; // Bytes sent so far
+                std::vector<GLubyte> owned; // Data held by the queue, if any
+                std::function<void(void)> done;
+            };
+            std::deque<Upload> upload_;
+            size_t budget_;
+            size_t pending_bytes_;
+
+            GLuint staging_; // Buffer holding every segment
+            GLubyte *mapped_; // Whole buffer, NULL when it is mapped per segment
+            size_t segment_size_;
+            int segment_; // Next segment to fill
+            GLsync fence_[segment_count]; // Last copies out of each segment
+
+            // Create the staging buffer, persistently mapped if the driver
+            // supports it
+            void InitStaging(void);
+            // Fill the next segment with up to limit bytes and issue the
+            // copies out of it
+            size_t Transfer(size_t limit);
+
+            // Not copyable: owns GL objects
+            UploadQueue(const UploadQueue &);
+            UploadQueue &operator=(const UploadQueue &);
+
+    }; // class UploadQueue
+
+} // namespace game
+
+#endif // UPLOAD_QUEUE_H_
@@ -0,0 +1,151 @@
+#include <glm/gtc/type_ptr.hpp>
+
+#include "vertex_layout.h"
+
+namespace game {
+
+// Names of the vertex shader inputs, by semantic
+static const char *attribute_name[VertexSemanticCount] = { "vertex", "normal", "color", "uv" };
+
+// Value of the inputs a layout does not store
+static const glm::vec4 missing_value[VertexSemanticCount] = {
+    glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+    glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
+    glm::vec4(1.0f, 1.0f, 1.0f, 1.0f),
+    glm::vec4(0.0f, 0.0f, 0.0f, 0.0f)
+};
+
+
+GLushort FloatToHalf(float value){
+
+    GLuint bits;
+    memcpy(&bits, &value, sizeof(bits));
+    GLuint sign = (bits >> 16) & 0x8000;
+    int exponent = (int) ((bits >> 23) & 0xff) - 127 + 15;
+    GLuint mantissa = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff){
+        // Infinity or NaN
+        return (GLushort) (sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+    if (exponent >= 31){
+        // Too large, becomes infinity
+        return (GLushort) (sign | 0x7c00);
+    }
+    if (exponent <= 0){
+        // Denormal, or zero when too small
+        if (exponent < -10){
+            return (GLushort) sign;
+        }
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        GLuint half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1){
+            half++;
+        }
+        return (GLushort) (sign | half);
+    }
+
+    // Round to nearest; a carry into the exponent is still correct
+    GLuint half = sign | (exponent << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000){
+        half++;
+    }
+    return (GLushort) half;
+}
+
+
+float HalfToFloat(GLushort value){
+
+    GLuint sign = (GLuint) (value & 0x8000) << 16;
+    int exponent = (value >> 10) & 0x1f;
+    GLuint mantissa = value & 0x3ff;
+
+    GLuint bits;
+    if (exponent == 0 && mantissa == 0){
+        bits = sign;
+    } else if (exponent == 0){
+        // Denormal: shift the mantissa up to an implicit leading one
+        exponent = 1;
+        while (!(mantissa & 0x400)){
+            mantissa <<= 1;
+            exponent--;
+        }
+        mantissa &= 0x3ff;
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    } else if (exponent == 31){
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+
+GLuint PackSnorm10(const glm::vec3 &value){
+
+    GLuint result = 0;
+    for (int i = 0; i < 3; i++){
+        float c = glm::clamp(value[i], -1.0f, 1.0f) * 511.0f;
+        int q = (int) ((c < 0.0f) ? c - 0.5f : c + 0.5f);
+        result |= ((GLuint) q & 0x3ff) << (10 * i);
+    }
+    return result;
+}
+
+
+glm::vec3 UnpackSnorm10(GLuint value){
+
+    glm::vec3 result;
+    for (int i = 0; i < 3; i++){
+        // Sign-extend the 10-bit field
+        int q = (int) (((value >> (10 * i)) & 0x3ff) ^ 0x200) - 0x200;
+        result[i] = (q < -511) ? -1.0f : q / 511.0f;
+    }
+    return result;
+}
+
+
+void VertexFormat::SetupAttributes(GLuint program) const {
+
+    bool present[VertexSemanticCount] = { false, false, false, false };
+    for (int i = 0; i < attribute_count; i++){
+        const VertexAttribute &a = attribute[i];
+        present[a.semantic] = true;
+        GLint location = glGetAttribLocation(program, attribute_name[a.semantic]);
+        if (location < 0){
+            continue; // Unused by the program
+        }
+        glVertexAttribPointer(location, a.components, a.type, a.normalized, a.stride ? a.stride : stride, (void *) (GLintptr) a.offset);
+        glEnableVertexAttribArray(location);
+    }
+
+    // A disabled array reads the current constant value instead
+    for (int s = 0; s < VertexSemanticCount; s++){
+        if (present[s]){
+            continue;
+        }
+        GLint location = glGetAttribLocation(program, attribute_name[s]);
+        if (location < 0){
+            continue;
+        }
+        glDisableVertexAttribArray(location);
+        glVertexAttrib4fv(location, glm::value_ptr(missing_value[s]));
+    }
+}
+
+
+bool VertexFormat::Has(VertexSemantic semantic) const {
+
+    for (int i = 0; i < attribute_count; i++){
+        if (attribute[i].semantic == semantic){
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace game
@@ -0,0 +1,196 @@
+#ifndef VERTEX_LAYOUT_H_
+#define VERTEX_LAYOUT_H_
+
+#include <string.h>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+namespace game {
+
+    // Vertex as the mesh generators build it, before it is packed into
+    // the layout of its mesh
+    struct VertexData {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec3 color;
+        glm::vec2 uv;
+    };
+
+    // Shader inputs a layout can feed; the names of the matching vertex
+    // shader attributes are "vertex", "normal", "color" and "uv"
+    enum VertexSemantic { VertexPosition, VertexNormal, VertexColor, VertexTexCoord, VertexSemanticCount };
+
+    // Half-float and signed 10-bit conversions used by compact layouts
+    GLushort FloatToHalf(float value);
+    float HalfToFloat(GLushort value);
+    GLuint PackSnorm10(const glm::vec3 &value);
+    glm::vec3 UnpackSnorm10(GLuint value);
+
+    // One attribute of a packed vertex
+    struct VertexAttribute {
+        VertexSemantic semantic;
+        GLint components;
+        GLenum type;
+        GLboolean normalized;
+        GLsizei offset; // Bytes from the start of the vertex
+        GLsizei stride; // Bytes between vertices, 0 for the stride of the format
+    };
+
+    // Run-time description of a VertexLayout, kept by mesh resources so
+    // that draw code sets up any layout without knowing it at compile time.
+    // Formats of buffers uploaded as a file lays them out have their own
+    // strides per attribute and no pack or unpack; such meshes are drawn
+    // as they are, never repacked or merged
+    struct VertexFormat {
+        GLsizei stride; // Bytes per vertex
+        int attribute_count;
+        VertexAttribute attribute[VertexSemanticCount];
+        void (*pack)(const VertexData &vertex, void *dst);
+        void (*unpack)(const void *src, VertexData &vertex);
+
+        // Point the attributes of a program at the bound array buffer.
+        // Inputs of the program that the layout lacks get a constant value
+        // instead: white color, no texture coordinates
+        void SetupAttributes(GLuint program) const;
+        bool Has(VertexSemantic semantic) const;
+    };
+
+    // Attribute types a layout is built from. Each one knows its size and
+    // GL type, and how to pack its part of a VertexData
+
+    struct PositionF32 {
+        enum { semantic = VertexPosition, components = 3, type = GL_FLOAT, normalized = GL_FALSE, size = 3 * sizeof(GLfloat) };
+        static void Pack(const VertexData &v, GLubyte *dst){ memcpy(dst, &v.position, size); }
+        static void Unpack(const GLubyte *src, VertexData &v){ memcpy(&v.position, src, size); }
+    };
+
+    struct NormalF32 {
+        enum { semantic = VertexNormal, components = 3, type = GL_FLOAT, normalized = GL_FALSE, size = 3 * sizeof(GLfloat) };
+        static void Pack(const VertexData &v, GLubyte *dst){ memcpy(dst, &v.normal, size); }
+        static void Unpack(const GLubyte *src, VertexData &v){ memcpy(&v.normal, src, size); }
+    };
+
+    // Unit normal in 10 bits per axis, expanded back to floats by the
+    // vertex fetch so shaders are unchanged
+    struct NormalS10 {
+        enum { semantic = VertexNormal, components = 4, type = GL_INT_2_10_10_10_REV, normalized = GL_TRUE, size = sizeof(GLuint) };
+        static void Pack(const VertexData &v, GLubyte *dst){ GLuint p = PackSnorm10(v.normal); memcpy(dst, &p, size); }
+        static void Unpack(const GLubyte *src, VertexData &v){ GLuint p; memcpy(&p, src, size); v.normal = UnpackSnorm10(p); }
+    };
+
+    struct ColorF32 {
+        enum { semantic = VertexColor, components = 3, type = GL_FLOAT, normalized = GL_FALSE, size = 3 * sizeof(GLfloat) };
+        static void Pack(const VertexData &v, GLubyte *dst){ memcpy(dst, &v.color, size); }
+        static void Unpack(const GLubyte *src, VertexData &v){ memcpy(&v.color, src, size); }
+    };
+
+    struct TexCoordF32 {
+        enum { semantic = VertexTexCoord, components = 2, type = GL_FLOAT, normalized = GL_FALSE, size = 2 * sizeof(GLfloat) };
+        static void Pack(const VertexData &v, GLubyte *dst){ memcpy(dst, &v.uv, size); }
+        static void Unpack(const GLubyte *src, VertexData &v){ memcpy(&v.uv, src, size); }
+    };
+
+    // Half-float texture coordinates; precise to about 1/2048 in [0, 1],
+    // so only for coordinates that do not repeat the texture many times
+    struct TexCoordF16 {
+        enum { semantic = VertexTexCoord, components = 2, type = GL_HALF_FLOAT, normalized = GL_FALSE, size = 2 * sizeof(GLushort) };
+        static void Pack(const VertexData &v, GLubyte *dst){ GLushort h[2] = { FloatToHalf(v.uv.x), FloatToHalf(v.uv.y) }; memcpy(dst, h, size); }
+        static void Unpack(const GLubyte *src, VertexData &v){ GLushort h[2]; memcpy(h, src, size); v.uv = glm::vec2(HalfToFloat(h[0]), HalfToFloat(h[1])); }
+    };
+
+    // Compile-time walk over the attribute list of a layout
+    template <typename... Attrs>
+    struct LayoutWalk {
+        static constexpr GLsizei Size(void){ return 0; }
+        static void Pack(const VertexData &, GLubyte *){}
+        static void Unpack(const GLubyte *, VertexData &){}
+        static void Describe(VertexAttribute *, GLsizei){}
+    };
+
+    template <typename A, typename... Rest>
+    struct LayoutWalk<A, Rest...> {
+        static constexpr GLsizei Size(void){ return A::size + LayoutWalk<Rest...>::Size(); }
+        static void Pack(const VertexData &v, GLubyte *dst){
+            A::Pack(v, dst);
+            LayoutWalk<Rest...>::Pack(v, dst + A::size);
+        }
+        static void Unpack(const GLubyte *src, VertexData &v){
+            A::Unpack(src, v);
+            LayoutWalk<Rest...>::Unpack(src + A::size, v);
+        }
+        static void Describe(VertexAttribute *attribute, GLsizei offset){
+            attribute->semantic = (VertexSemantic) A::semantic;
+            attribute->components = A::components;
+            attribute->type = A::type;
+            attribute->normalized = A::normalized;
+            attribute->offset = offset;
+            attribute->stride = 0;
+            LayoutWalk<Rest...>::Describe(attribute + 1, offset + A::size);
+        }
+    };
+
+    // Byte offset of attribute T in a list of attributes
+    template <typename T, typename... Attrs>
+    struct LayoutOffset;
+
+    template <typename T, typename... Rest>
+    struct LayoutOffset<T, T, Rest...> {
+        static constexpr GLsizei Value(void){ return 0; }
+    };
+
+    template <typename T, typename A, typename... Rest>
+    struct LayoutOffset<T, A, Rest...> {
+        static constexpr GLsizei Value(void){ return A::size + LayoutOffset<T, Rest...>::Value(); }
+    };
+
+    // Interleaved vertex layout made of the given attributes, in order,
+    // with no padding. Offsets and stride are known at compile time, and
+    // the layout generates both the CPU packing of VertexData and the
+    // run-time format used to set up the shader attributes
+    template <typename... Attrs>
+    class VertexLayout {
+
+        public:
+            static constexpr GLsizei Stride(void){ return LayoutWalk<Attrs...>::Size(); }
+            template <typename A>
+            static constexpr GLsizei Offset(void){ return LayoutOffset<A, Attrs...>::Value(); }
+
+            static void Pack(const VertexData &vertex, void *dst){
+                LayoutWalk<Attrs...>::Pack(vertex, (GLubyte *) dst);
+            }
+            static void Unpack(const void *src, VertexData &vertex){
+                LayoutWalk<Attrs...>::Unpack((const GLubyte *) src, vertex);
+            }
+
+            // Shared description of the layout; the same object for every
+            // use of the same layout, so formats compare by address
+            static const VertexFormat &Format(void){
+                static const VertexFormat format = MakeFormat();
+                return format;
+            }
+
+        private:
+            static VertexFormat MakeFormat(void){
+                VertexFormat format;
+                format.stride = Stride();
+                format.attribute_count = sizeof...(Attrs);
+                LayoutWalk<Attrs...>::Describe(format.attribute, 0);
+                format.pack = Pack;
+                format.unpack = Unpack;
+                return format;
+            }
+
+    }; // class VertexLayout
+
+    // Layout of the original meshes: 44 bytes per vertex
+    typedef VertexLayout<PositionF32, NormalF32, ColorF32, TexCoordF32> StandardVertex;
+    // Lit or textured meshes that ignore the vertex color: 20 bytes
+    typedef VertexLayout<PositionF32, NormalS10, TexCoordF16> CompactVertex;
+
+    static_assert(StandardVertex::Stride() == 11 * sizeof(GLfloat), "standard layout changed size");
+    static_assert(sizeof(VertexData) == 11 * sizeof(GLfloat), "VertexData must be tightly packed");
+
+} // namespace game
+
+#endif // VERTEX_LAYOUT_H_